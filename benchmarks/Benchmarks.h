@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include "udan/utils/Benchmark.h"
+#include "udan/utils/ThreadPool.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		/**
+		 * \brief Pool shared by every benchmark, stopped by main before exiting
+		 */
+		utils::ThreadPool& GetBenchmarkPool();
+
+		void RegisterThreadPoolBenchmarks(utils::BenchmarkRunner& runner);
+		void RegisterLockBenchmarks(utils::BenchmarkRunner& runner);
+		void RegisterEventBenchmarks(utils::BenchmarkRunner& runner);
+		void RegisterQueueBenchmarks(utils::BenchmarkRunner& runner);
+		void RegisterDataSetBenchmarks(utils::BenchmarkRunner& runner);
+	}
+}
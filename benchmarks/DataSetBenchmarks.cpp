@@ -0,0 +1,946 @@
+﻿#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "udan/utils/ArchetypeStorage.h"
+#include "udan/utils/ChangedDataSetView.h"
+#include "udan/utils/CommandBuffer.h"
+#include "udan/utils/ComponentSignatures.h"
+#include "udan/utils/ConcurrentDataSet.h"
+#include "udan/utils/DoubleBufferedDataSet.h"
+#include "udan/utils/HugePages.h"
+#include "udan/utils/LazyDataSetView.h"
+#include "udan/utils/LinearArena.h"
+#include "udan/utils/MembershipFilter.h"
+#include "udan/utils/OwningGroup.h"
+#include "udan/utils/ParallelFor.h"
+#include "udan/utils/ScopeLock.h"
+#include "udan/utils/Snapshot.h"
+#include "udan/utils/SoaDataSet.h"
+#include "udan/utils/SparseSet.h"
+#include "udan/utils/SpinLock.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		namespace
+		{
+			typedef uint32_t Entity;
+
+			struct Position
+			{
+				float x;
+				float y;
+				float z;
+			};
+
+			struct Velocity
+			{
+				float x;
+				float y;
+				float z;
+			};
+
+			// Large component of which systems usually touch a single field
+			struct Transform
+			{
+				float px, py, pz;
+				float rx, ry, rz, rw;
+				float sx, sy, sz;
+				float speed;
+				std::array<float, 5> pad;
+
+				using SoaFields = utils::SoaLayout<&Transform::px, &Transform::py, &Transform::pz,
+					&Transform::rx, &Transform::ry, &Transform::rz, &Transform::rw,
+					&Transform::sx, &Transform::sy, &Transform::sz, &Transform::speed, &Transform::pad>;
+			};
+
+			typedef utils::DataSet<Entity, Position> PositionSet;
+			typedef utils::DataSet<Entity, Velocity> VelocitySet;
+			typedef utils::DataSet<Entity, Position, utils::ChangeTracking<Entity>> TrackedPositionSet;
+			typedef utils::DataSet<Entity, Position, utils::NoChangeTracking<Entity>, utils::HugePageAllocator<Position>> HugePagePositionSet;
+			typedef utils::DataSet<Entity, Position, utils::NoChangeTracking<Entity>, utils::ArenaAllocator<Position>> ArenaPositionSet;
+			typedef utils::DataSet<Entity, Position, utils::NoChangeTracking<Entity>, utils::ReservedAllocator<Position>> ReservedPositionSet;
+			typedef utils::ConcurrentDataSet<Entity, Position> ConcurrentPositionSet;
+			typedef utils::DoubleBufferedDataSet<Entity, Position> DoubleBufferedPositionSet;
+
+			// Identity transform at (e, 0, 0), every field initialized
+			Transform MakeTransform(Entity e)
+			{
+				return Transform{ static_cast<float>(e), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, {} };
+			}
+
+			std::unique_ptr<PositionSet> MakePositions(size_t count)
+			{
+				auto positions = std::make_unique<PositionSet>(count + 1);
+				for (Entity e = 0; e < count; ++e)
+					positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+				return positions;
+			}
+
+			template<size_t Tag>
+			struct Tagged
+			{
+				float value;
+			};
+
+			// Four sets, a quarter of the entities hold all four components
+			struct FourSets
+			{
+				explicit FourSets(size_t count) : a(count + 1), b(count + 1), c(count + 1), d(count + 1)
+				{
+					for (Entity e = 0; e < count; ++e)
+					{
+						a.EmplaceBack(e, 1.0f);
+						if (e % 2 == 0)
+							b.EmplaceBack(e, 1.0f);
+						if (e % 4 < 2)
+							c.EmplaceBack(e, 1.0f);
+						if (e % 8 != 7)
+							d.EmplaceBack(e, 1.0f);
+					}
+				}
+
+				utils::DataSet<Entity, Tagged<0>> a;
+				utils::DataSet<Entity, Tagged<1>> b;
+				utils::DataSet<Entity, Tagged<2>> c;
+				utils::DataSet<Entity, Tagged<3>> d;
+			};
+
+			// Workload shared by the sparse set and archetype backends, both views expose Each
+			template<typename View>
+			void AddVelocities(View& view)
+			{
+				view.Each([](Position& position, Velocity& velocity) { position.x += velocity.x; });
+			}
+
+			// Same entities and components as MakePositions and MakeVelocities, in one archetype storage
+			std::unique_ptr<utils::ArchetypeStorage<Entity>> MakeMovingArchetypes(size_t count)
+			{
+				auto storage = std::make_unique<utils::ArchetypeStorage<Entity>>();
+				for (Entity e = 0; e < count; ++e)
+				{
+					if (e % 2 == 0)
+						storage->Add(e, Position{ static_cast<float>(e), 0.0f, 0.0f }, Velocity{ 1.0f, 1.0f, 1.0f });
+					else
+						storage->Add(e, Position{ static_cast<float>(e), 0.0f, 0.0f });
+				}
+				return storage;
+			}
+
+			// Same distribution as FourSets
+			std::unique_ptr<utils::ArchetypeStorage<Entity>> MakeFourArchetypes(size_t count)
+			{
+				auto storage = std::make_unique<utils::ArchetypeStorage<Entity>>();
+				for (Entity e = 0; e < count; ++e)
+				{
+					storage->Add(e, Tagged<0>{ 1.0f });
+					if (e % 2 == 0)
+						storage->Add(e, Tagged<1>{ 1.0f });
+					if (e % 4 < 2)
+						storage->Add(e, Tagged<2>{ 1.0f });
+					if (e % 8 != 7)
+						storage->Add(e, Tagged<3>{ 1.0f });
+				}
+				return storage;
+			}
+
+			// Half of the entities match, in reverse order to defeat the prefetcher
+			std::unique_ptr<VelocitySet> MakeVelocities(size_t count)
+			{
+				auto velocities = std::make_unique<VelocitySet>(count + 1);
+				for (Entity e = static_cast<Entity>(count); e-- > 0;)
+				{
+					if (e % 2 == 0)
+						velocities->EmplaceBack(e, 1.0f, 1.0f, 1.0f);
+				}
+				return velocities;
+			}
+
+			// Same entities as MakeVelocities in random order
+			std::unique_ptr<VelocitySet> MakeShuffledVelocities(size_t count)
+			{
+				std::vector<Entity> entities;
+				for (Entity e = 0; e < count; e += 2)
+					entities.push_back(e);
+				std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+				auto velocities = std::make_unique<VelocitySet>(count + 1);
+				for (const Entity e : entities)
+					velocities->EmplaceBack(e, 1.0f, 1.0f, 1.0f);
+				return velocities;
+			}
+		}
+
+		void RegisterDataSetBenchmarks(utils::BenchmarkRunner& runner)
+		{
+			for (const size_t count : { 1000, 10000, 100000, 1000000, 10000000 })
+			{
+				runner.Add(fmt::format("DataSet/Insert/{}", count), [count](utils::BenchmarkState& state)
+					{
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<PositionSet>(count + 1);
+							state.ResumeTiming();
+							for (Entity e = 0; e < count; ++e)
+								positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Same as DataSet/Insert with the components on huge pages
+				runner.Add(fmt::format("DataSet/InsertHugePages/{}", count), [count](utils::BenchmarkState& state)
+					{
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<HugePagePositionSet>(count + 1);
+							state.ResumeTiming();
+							for (Entity e = 0; e < count; ++e)
+								positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Same as DataSet/Insert growing from a small capacity, every growth copies the arrays
+				runner.Add(fmt::format("DataSet/InsertGrowing/{}", count), [count](utils::BenchmarkState& state)
+					{
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<PositionSet>(512);
+							state.ResumeTiming();
+							for (Entity e = 0; e < count; ++e)
+								positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Same as DataSet/InsertGrowing in a reservation, growing commits pages in place and never copies
+				runner.Add(fmt::format("DataSet/InsertReserved/{}", count), [count](utils::BenchmarkState& state)
+					{
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<ReservedPositionSet>(512, utils::ReservedAllocator<Position>(count));
+							state.ResumeTiming();
+							for (Entity e = 0; e < count; ++e)
+								positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Frame scoped set growing from a small capacity, its storage recycled by the arena every iteration
+				runner.Add(fmt::format("DataSet/InsertArena/{}", count), [count](utils::BenchmarkState& state)
+					{
+						utils::LinearArena arena(1024 * 1024);
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							{
+								ArenaPositionSet positions(512, utils::ArenaAllocator<Position>(arena));
+								for (Entity e = 0; e < count; ++e)
+									positions.EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+								utils::DoNotOptimize(positions.GetSize());
+							}
+							arena.Reset();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Population from pool tasks, a DataSet needs a lock around EmplaceBack
+				runner.Add(fmt::format("DataSet/ParallelInsertLocked/{}", count), [count](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						utils::SpinLock lock;
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<PositionSet>(count + 1);
+							state.ResumeTiming();
+							utils::ParallelFor(pool, count, 4096, [&positions, &lock](size_t begin, size_t end)
+								{
+									for (size_t e = begin; e < end; ++e)
+									{
+										utils::ScopeLock<utils::SpinLock> guard(lock);
+										positions->EmplaceBack(static_cast<Entity>(e), static_cast<float>(e), 0.0f, 0.0f);
+									}
+								});
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("ConcurrentDataSet/ParallelEmplace/{}", count), [count](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<ConcurrentPositionSet>(count + 1);
+							state.ResumeTiming();
+							utils::ParallelFor(pool, count, 4096, [&positions](size_t begin, size_t end)
+								{
+									for (size_t e = begin; e < end; ++e)
+										positions->EmplaceBack(static_cast<Entity>(e), static_cast<float>(e), 0.0f, 0.0f);
+								});
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// One fetch add per chunk instead of one per component
+				runner.Add(fmt::format("ConcurrentDataSet/ParallelInsertRange/{}", count), [count](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						std::vector<Entity> entities(count);
+						std::vector<Position> components(count);
+						for (Entity e = 0; e < count; ++e)
+						{
+							entities[e] = e;
+							components[e] = { static_cast<float>(e), 0.0f, 0.0f };
+						}
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<ConcurrentPositionSet>(count + 1);
+							state.ResumeTiming();
+							utils::ParallelFor(pool, count, 4096, [&](size_t begin, size_t end)
+								{
+									positions->InsertRange(std::span<const Entity>(entities).subspan(begin, end - begin),
+										std::span<const Position>(components).subspan(begin, end - begin));
+								});
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Every frame readers walk all positions while writers move half of them, then the buffers swap
+				runner.Add(fmt::format("DoubleBufferedDataSet/ReadWhileWrite/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = std::make_unique<DoubleBufferedPositionSet>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+						auto& pool = GetBenchmarkPool();
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::ParallelFor(pool, 2 * count, 4096, [&positions, count](size_t begin, size_t end)
+								{
+									float total = 0.0f;
+									for (size_t i = begin; i < end; ++i)
+									{
+										if (i >= count)
+											total += positions->ReadAtIndex(i - count).x;
+										else if (i % 2 == 0)
+											positions->WriteAtIndex(i).x += 1.0f;
+									}
+									utils::DoNotOptimize(total);
+								});
+							positions->SwapBuffers();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("DataSet/Remove/{}", count), [count](utils::BenchmarkState& state)
+					{
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = MakePositions(count);
+							state.ResumeTiming();
+							// Every other entity first so that removals swap with the back
+							for (Entity e = 0; e < count; e += 2)
+								positions->RemoveComponent(e);
+							for (Entity e = 1; e < count; e += 2)
+								positions->RemoveComponent(e);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("DataSet/InsertRange/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						std::vector<Entity> entities(count);
+						std::vector<Position> components(count);
+						for (Entity e = 0; e < count; ++e)
+						{
+							entities[e] = e;
+							components[e] = Position{ static_cast<float>(e), 0.0f, 0.0f };
+						}
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<PositionSet>(count + 1);
+							state.ResumeTiming();
+							positions->InsertRange(entities, components);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("DataSet/RemoveRange/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						// Same order as DataSet/Remove
+						std::vector<Entity> entities;
+						entities.reserve(count);
+						for (Entity e = 0; e < count; e += 2)
+							entities.push_back(e);
+						for (Entity e = 1; e < count; e += 2)
+							entities.push_back(e);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = MakePositions(count);
+							state.ResumeTiming();
+							positions->RemoveRange(std::span<const Entity>(entities).first(count / 2));
+							positions->RemoveRange(std::span<const Entity>(entities).subspan(count / 2));
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("SnapshotWriter/Capture/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						utils::SnapshotWriter<Entity, Position> writer;
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							writer.Capture(*positions);
+						state.SetItemsPerIteration(count);
+					});
+
+				// Periodic snapshot of a set where 1% of the components change between two captures
+				runner.Add(fmt::format("SnapshotWriter/CaptureChanges/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = std::make_unique<TrackedPositionSet>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+						utils::SnapshotWriter<Entity, Position> writer;
+						writer.Capture(*positions);
+						std::mt19937 random(42);
+						uint32_t tick = 1;
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							positions->GetChanges().Trim(tick);
+							positions->GetChanges().SetTick(++tick);
+							for (size_t i = 0; i < count / 100; ++i)
+								positions->GetComponent(static_cast<Entity>(random() % count)).x += 1.0f;
+							state.ResumeTiming();
+							writer.CaptureChanges(*positions, tick - 1);
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Restart paths: map the snapshot and read it in place, or rebuild a mutable set from it
+				runner.Add(fmt::format("DataSetSnapshot/OpenEach/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						const std::string path = (std::filesystem::temp_directory_path() / "udan_positions.snap").string();
+						{
+							utils::SnapshotWriter<Entity, Position> writer;
+							writer.Capture(*MakePositions(count));
+							writer.Write(path);
+						}
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::DataSetSnapshot<Entity, Position> snapshot;
+							snapshot.Open(path);
+							float sum = 0.0f;
+							snapshot.Each([&sum](const Position& position) { sum += position.x; });
+							utils::DoNotOptimize(sum);
+						}
+						std::filesystem::remove(path);
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("DataSetSnapshot/CopyTo/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						const std::string path = (std::filesystem::temp_directory_path() / "udan_positions.snap").string();
+						{
+							utils::SnapshotWriter<Entity, Position> writer;
+							writer.Capture(*MakePositions(count));
+							writer.Write(path);
+						}
+						utils::DataSetSnapshot<Entity, Position> snapshot;
+						snapshot.Open(path);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<PositionSet>(count + 1);
+							state.ResumeTiming();
+							snapshot.CopyTo(*positions);
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						snapshot.Close();
+						std::filesystem::remove(path);
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("DataSet/Iterate/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (auto& position : positions->GetData())
+								position.y += position.x;
+							utils::DoNotOptimize(positions->GetData().data());
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Same loop as DataSet/Iterate, GetData stamps every component
+				runner.Add(fmt::format("DataSet/IterateTracked/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = std::make_unique<TrackedPositionSet>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+						uint32_t tick = 1;
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							positions->GetChanges().SetTick(++tick);
+							for (auto& position : positions->GetData())
+								position.y += position.x;
+							utils::DoNotOptimize(positions->GetData().data());
+							positions->GetChanges().Trim(tick);
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// One percent of the positions change every tick, only those are visited
+				runner.Add(fmt::format("ChangedDataSetView/Each2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = std::make_unique<TrackedPositionSet>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							positions->EmplaceBack(e, static_cast<float>(e), 0.0f, 0.0f);
+						auto velocities = MakeVelocities(count);
+						std::mt19937 random(42);
+						uint32_t tick = 1;
+						float total = 0.0f;
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							positions->GetChanges().Trim(tick);
+							positions->GetChanges().SetTick(++tick);
+							for (size_t i = 0; i < count / 100; ++i)
+								positions->GetComponent(static_cast<Entity>(random() % count)).x += 1.0f;
+							state.ResumeTiming();
+							utils::ChangedDataSetView<Entity, TrackedPositionSet, VelocitySet> view(tick - 1, *positions, *velocities);
+							view.Each([&total](const Position& position, Velocity& velocity) { total += position.x * velocity.x; });
+						}
+						utils::DoNotOptimize(total);
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("DataSetView/Iterate2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::DataSetView<Entity, PositionSet, VelocitySet> view({}, *positions, *velocities);
+							for (size_t i = 0; i < view.GetMatchCount(); ++i)
+							{
+								auto [position, velocity] = view.Get(i);
+								position.x += velocity.x;
+							}
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				// Matching on the pool, the temporaries come from the scratch arenas
+				runner.Add(fmt::format("DataSetView/ParallelBuild2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						auto& pool = GetBenchmarkPool();
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::DataSetView<Entity, PositionSet, VelocitySet> view({}, pool, *positions, *velocities);
+							utils::DoNotOptimize(view.GetMatchCount());
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("LazyDataSetView/Iterate2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, PositionSet, VelocitySet> view(*positions, *velocities);
+							for (auto [position, velocity] : view)
+								position.x += velocity.x;
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("LazyDataSetView/Iterate2Shuffled/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeShuffledVelocities(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, PositionSet, VelocitySet> view(*positions, *velocities);
+							for (auto [position, velocity] : view)
+								position.x += velocity.x;
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				// Positions in the order of the velocities, the component reads become sequential
+				runner.Add(fmt::format("LazyDataSetView/Iterate2SortedAs/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeShuffledVelocities(count);
+						positions->SortAs(*velocities);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, PositionSet, VelocitySet> view(*positions, *velocities);
+							for (auto [position, velocity] : view)
+								position.x += velocity.x;
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("LazyDataSetView/Each2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, PositionSet, VelocitySet> view(*positions, *velocities);
+							AddVelocities(view);
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("ArchetypeQuery/Each2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto storage = MakeMovingArchetypes(count);
+						utils::ArchetypeQuery<Entity, Position, Velocity> query(*storage);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							AddVelocities(query);
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("ArchetypeQuery/EachChunk2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto storage = MakeMovingArchetypes(count);
+						utils::ArchetypeQuery<Entity, Position, Velocity> query(*storage);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							query.EachChunk([](size_t size, const Entity*, Position* positions, Velocity* velocities)
+								{
+									for (size_t i = 0; i < size; ++i)
+										positions[i].x += velocities[i].x;
+								});
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				for (const auto kernel : { utils::MembershipKernel::SCALAR, utils::MembershipKernel::AVX2, utils::MembershipKernel::AVX512 })
+				{
+					if (kernel > utils::GetMembershipKernel())
+						continue;
+					static const char* const names[] = { "Scalar", "Avx2", "Avx512" };
+					runner.Add(fmt::format("MembershipFilter/{}/{}", names[static_cast<size_t>(kernel)], count), [count, kernel](utils::BenchmarkState& state)
+						{
+							state.PauseTiming();
+							auto positions = MakePositions(count);
+							auto velocities = MakeVelocities(count);
+							const utils::MembershipProbe probe = utils::MakeMembershipProbe(*velocities);
+							std::vector<uint32_t> matches(count);
+							state.ResumeTiming();
+							for (uint64_t it = 0; it < state.Iterations(); ++it)
+							{
+								const size_t found = utils::FilterMembers(kernel, positions->Entities().data(), count, &probe, 1, matches.data());
+								utils::DoNotOptimize(found);
+							}
+							state.SetItemsPerIteration(count);
+						});
+				}
+
+				runner.Add(fmt::format("LazyDataSetView/ParallelEach2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						auto& pool = GetBenchmarkPool();
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, PositionSet, VelocitySet> view(*positions, *velocities);
+							view.ParallelEach(pool, [](Position& position, Velocity& velocity) { position.x += velocity.x; }, 4096);
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				// Workers add a velocity to half the positions while iterating them, applied at the end
+				runner.Add(fmt::format("CommandQueue/ParallelAdd/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto& pool = GetBenchmarkPool();
+						utils::CommandQueue<Entity> commands(pool);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto velocities = std::make_unique<VelocitySet>(count + 1);
+							state.ResumeTiming();
+							utils::LazyDataSetView<Entity, PositionSet> view(*positions);
+							view.ParallelEach(pool, [&commands, &velocities](Entity entity, const Position&)
+								{
+									if (entity % 2 == 0)
+										commands.GetLocal().Add(*velocities, entity, Velocity{ 1.0f, 1.0f, 1.0f });
+								}, 4096);
+							commands.Apply();
+							state.PauseTiming();
+							velocities.reset();
+							state.ResumeTiming();
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("OwningGroup/Iterate2/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = MakeVelocities(count);
+						utils::OwningGroup<Entity, PositionSet, VelocitySet> group(*positions, *velocities);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (auto [position, velocity] : group)
+								position.x += velocity.x;
+						}
+						state.SetItemsPerIteration(count / 2);
+					});
+
+				runner.Add(fmt::format("DataSet/UpdateOneField/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto transforms = std::make_unique<utils::DataSet<Entity, Transform>>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							transforms->PushBack(e, MakeTransform(e));
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (auto& transform : transforms->GetData())
+								transform.px += transform.speed;
+							utils::DoNotOptimize(transforms->GetData().data());
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("SoaDataSet/UpdateOneField/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto transforms = std::make_unique<utils::SoaDataSet<Entity, Transform>>(count + 1);
+						for (Entity e = 0; e < count; ++e)
+							transforms->PushBack(e, MakeTransform(e));
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							const auto positions = transforms->GetColumn<0>();
+							const auto speeds = transforms->GetColumn<10>();
+							for (size_t i = 0; i < positions.size(); ++i)
+								positions[i] += speeds[i];
+							utils::DoNotOptimize(positions.data());
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("LazyDataSetView/Iterate4/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto sets = std::make_unique<FourSets>(count);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							// Driven by d, the largest set, to measure rejections
+							utils::LazyDataSetView<Entity, decltype(sets->d), decltype(sets->a), decltype(sets->b), decltype(sets->c)> view(sets->d, sets->a, sets->b, sets->c);
+							for (auto [d, a, b, c] : view)
+								d.value += a.value + b.value + c.value;
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("LazyDataSetView/Iterate4Signatures/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto sets = std::make_unique<FourSets>(count);
+						auto signatures = std::make_unique<utils::ComponentSignatures<Entity>>();
+						signatures->Bind(sets->a);
+						signatures->Bind(sets->b);
+						signatures->Bind(sets->c);
+						signatures->Bind(sets->d);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							utils::LazyDataSetView<Entity, decltype(sets->d), decltype(sets->a), decltype(sets->b), decltype(sets->c)> view(*signatures, sets->d, sets->a, sets->b, sets->c);
+							for (auto [d, a, b, c] : view)
+								d.value += a.value + b.value + c.value;
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("ArchetypeQuery/Iterate4/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto storage = MakeFourArchetypes(count);
+						utils::ArchetypeQuery<Entity, Tagged<3>, Tagged<0>, Tagged<1>, Tagged<2>> query(*storage);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (auto [d, a, b, c] : query)
+								d.value += a.value + b.value + c.value;
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				runner.Add(fmt::format("ComponentSignatures/Scan4/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto sets = std::make_unique<FourSets>(count);
+						auto signatures = std::make_unique<utils::ComponentSignatures<Entity>>();
+						const utils::ComponentMask query = signatures->Bind(sets->a) | signatures->Bind(sets->b) | signatures->Bind(sets->c) | signatures->Bind(sets->d);
+						std::vector<Entity> matches(signatures->GetSlotCount());
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							utils::DoNotOptimize(signatures->Scan(query, matches.data()));
+						state.SetItemsPerIteration(count);
+					});
+
+				// Cost of keeping the group packed while components come and go
+				runner.Add(fmt::format("OwningGroup/InsertRemove/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto positions = MakePositions(count);
+						auto velocities = std::make_unique<VelocitySet>(count + 1);
+						utils::OwningGroup<Entity, PositionSet, VelocitySet> group(*positions, *velocities);
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (Entity e = 0; e < count; e += 2)
+								velocities->EmplaceBack(e, 1.0f, 1.0f, 1.0f);
+							for (Entity e = 0; e < count; e += 2)
+								velocities->RemoveComponent(e);
+						}
+						state.SetItemsPerIteration(count);
+					});
+
+				// Same churn as OwningGroup/InsertRemove, every add and remove moves the entity between archetypes
+				runner.Add(fmt::format("ArchetypeStorage/AddRemove/{}", count), [count](utils::BenchmarkState& state)
+					{
+						state.PauseTiming();
+						auto storage = std::make_unique<utils::ArchetypeStorage<Entity>>();
+						for (Entity e = 0; e < count; ++e)
+							storage->Add(e, Position{ static_cast<float>(e), 0.0f, 0.0f });
+						state.ResumeTiming();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (Entity e = 0; e < count; e += 2)
+								storage->Add(e, Velocity{ 1.0f, 1.0f, 1.0f });
+							for (Entity e = 0; e < count; e += 2)
+								storage->Remove<Velocity>(e);
+						}
+						state.SetItemsPerIteration(count);
+					});
+			}
+
+			// ParallelEmplace of a fixed population on pools of growing size, the calling thread runs chunks as well
+			for (const size_t workers : { 1, 2, 4, 8 })
+			{
+				runner.Add(fmt::format("ConcurrentDataSet/ParallelForScaling/{}", workers), [workers](utils::BenchmarkState& state)
+					{
+						constexpr size_t count = 1000000;
+						utils::ThreadPool pool(workers);
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							auto positions = std::make_unique<ConcurrentPositionSet>(count + 1);
+							state.ResumeTiming();
+							utils::ParallelFor(pool, count, 4096, [&positions](size_t begin, size_t end)
+								{
+									for (size_t e = begin; e < end; ++e)
+										positions->EmplaceBack(static_cast<Entity>(e), static_cast<float>(e), 0.0f, 0.0f);
+								});
+							state.PauseTiming();
+							positions.reset();
+							state.ResumeTiming();
+						}
+						pool.Stop();
+						state.SetItemsPerIteration(count);
+					});
+			}
+		}
+	}
+}
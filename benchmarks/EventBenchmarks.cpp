@@ -0,0 +1,38 @@
+﻿#include "Benchmarks.h"
+#include "udan/utils/Event.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		void RegisterEventBenchmarks(utils::BenchmarkRunner& runner)
+		{
+			for (const size_t observerCount : { 1, 8, 64 })
+			{
+				runner.Add(fmt::format("Event/Invoke/{}observers", observerCount), [observerCount](utils::BenchmarkState& state)
+					{
+						utils::Event<int> event;
+						uint64_t sum = 0;
+						for (size_t i = 0; i < observerCount; ++i)
+							event += [&sum](int value) { sum += value; };
+						int value = 1;
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							event.Invoke(value);
+						utils::DoNotOptimize(sum);
+						state.SetItemsPerIteration(observerCount);
+					});
+			}
+
+			runner.Add("Event/Register/8observers", [](utils::BenchmarkState& state)
+				{
+					for (uint64_t it = 0; it < state.Iterations(); ++it)
+					{
+						utils::Event<> event;
+						for (size_t i = 0; i < 8; ++i)
+							event += []() {};
+					}
+					state.SetItemsPerIteration(8);
+				});
+		}
+	}
+}
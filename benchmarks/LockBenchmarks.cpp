@@ -0,0 +1,60 @@
+﻿#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "udan/utils/CriticalSectionLock.h"
+#include "udan/utils/ScopeLock.h"
+#include "udan/utils/SpinLock.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		namespace
+		{
+			constexpr uint64_t IncrementsPerThread = 10000;
+
+			template<typename Lock>
+			void Contend(utils::BenchmarkState& state, size_t threadCount)
+			{
+				Lock lock;
+				uint64_t counter = 0;
+				for (uint64_t it = 0; it < state.Iterations(); ++it)
+				{
+					std::vector<std::thread> threads;
+					threads.reserve(threadCount);
+					for (size_t t = 0; t < threadCount; ++t)
+					{
+						threads.emplace_back([&lock, &counter]()
+							{
+								for (uint64_t i = 0; i < IncrementsPerThread; ++i)
+								{
+									utils::ScopeLock<Lock> lck(lock);
+									++counter;
+								}
+							});
+					}
+					for (auto& thread : threads)
+						thread.join();
+				}
+				utils::DoNotOptimize(counter);
+				state.SetItemsPerIteration(IncrementsPerThread * threadCount);
+			}
+		}
+
+		void RegisterLockBenchmarks(utils::BenchmarkRunner& runner)
+		{
+			for (const size_t threadCount : { 1, 2, 4, 8 })
+			{
+				runner.Add(fmt::format("Lock/SpinLock/{}threads", threadCount), [threadCount](utils::BenchmarkState& state)
+					{
+						Contend<utils::SpinLock>(state, threadCount);
+					});
+				runner.Add(fmt::format("Lock/CriticalSectionLock/{}threads", threadCount), [threadCount](utils::BenchmarkState& state)
+					{
+						Contend<utils::CriticalSectionLock>(state, threadCount);
+					});
+			}
+		}
+	}
+}
@@ -0,0 +1,173 @@
+﻿#include <queue>
+#include <thread>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "udan/utils/CriticalSectionLock.h"
+#include "udan/utils/MpmcQueue.h"
+#include "udan/utils/ScopeLock.h"
+#include "udan/utils/SpscRingBuffer.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		namespace
+		{
+			constexpr uint64_t ItemCount = 1 << 16;
+
+			/**
+			 * \brief The std::queue + CriticalSectionLock pattern the lock free queues replace
+			 */
+			class LockedQueue
+			{
+			public:
+				bool TryPush(uint64_t value)
+				{
+					utils::ScopeLock<decltype(m_lock)> lck(m_lock);
+					m_queue.push(value);
+					return true;
+				}
+
+				bool TryPop(uint64_t& value)
+				{
+					utils::ScopeLock<decltype(m_lock)> lck(m_lock);
+					if (m_queue.empty())
+						return false;
+					value = m_queue.front();
+					m_queue.pop();
+					return true;
+				}
+
+			private:
+				utils::CriticalSectionLock m_lock;
+				std::queue<uint64_t> m_queue;
+			};
+
+			template<typename Queue>
+			void Throughput(utils::BenchmarkState& state, Queue& queue, size_t producers, size_t consumers)
+			{
+				for (uint64_t it = 0; it < state.Iterations(); ++it)
+				{
+					std::vector<std::thread> threads;
+					for (size_t p = 0; p < producers; ++p)
+					{
+						threads.emplace_back([&queue, producers]()
+							{
+								for (uint64_t i = 0; i < ItemCount / producers; ++i)
+								{
+									while (!queue.TryPush(i))
+										std::this_thread::yield();
+								}
+							});
+					}
+					for (size_t c = 0; c < consumers; ++c)
+					{
+						threads.emplace_back([&queue, consumers]()
+							{
+								uint64_t value;
+								uint64_t sum = 0;
+								for (uint64_t i = 0; i < ItemCount / consumers; ++i)
+								{
+									while (!queue.TryPop(value))
+										std::this_thread::yield();
+									sum += value;
+								}
+								utils::DoNotOptimize(sum);
+							});
+					}
+					for (auto& thread : threads)
+						thread.join();
+				}
+				state.SetItemsPerIteration(ItemCount);
+			}
+		}
+
+		void RegisterQueueBenchmarks(utils::BenchmarkRunner& runner)
+		{
+			runner.Add("Queue/Throughput/Spsc/1P1C", [](utils::BenchmarkState& state)
+				{
+					utils::SpscRingBuffer<uint64_t> queue(4096);
+					Throughput(state, queue, 1, 1);
+				});
+			runner.Add("Queue/Throughput/SpscBatch64/1P1C", [](utils::BenchmarkState& state)
+				{
+					utils::SpscRingBuffer<uint64_t> queue(4096);
+					for (uint64_t it = 0; it < state.Iterations(); ++it)
+					{
+						std::thread producer([&queue]()
+							{
+								uint64_t batch[64];
+								for (uint64_t i = 0; i < ItemCount; i += 64)
+								{
+									for (uint64_t j = 0; j < 64; ++j)
+										batch[j] = i + j;
+									queue.PushBatch(batch, 64);
+								}
+							});
+						uint64_t batch[64];
+						uint64_t sum = 0;
+						for (uint64_t received = 0; received < ItemCount;)
+						{
+							const size_t count = queue.PopBatch(batch, 64);
+							for (size_t j = 0; j < count; ++j)
+								sum += batch[j];
+							received += count;
+						}
+						producer.join();
+						utils::DoNotOptimize(sum);
+					}
+					state.SetItemsPerIteration(ItemCount);
+				});
+			for (const size_t threads : { 1, 2, 4 })
+			{
+				runner.Add(fmt::format("Queue/Throughput/Locked/{0}P{0}C", threads), [threads](utils::BenchmarkState& state)
+					{
+						LockedQueue queue;
+						Throughput(state, queue, threads, threads);
+					});
+				runner.Add(fmt::format("Queue/Throughput/Mpmc/{0}P{0}C", threads), [threads](utils::BenchmarkState& state)
+					{
+						utils::MpmcQueue<uint64_t> queue(4096);
+						Throughput(state, queue, threads, threads);
+					});
+			}
+
+			// Round trip of one item through two queues, the echo thread blocks between messages
+			runner.Add("Queue/Latency/Spsc/RoundTrip", [](utils::BenchmarkState& state)
+				{
+					utils::SpscRingBuffer<uint64_t> ping(64);
+					utils::SpscRingBuffer<uint64_t> pong(64);
+					const uint64_t iterations = state.Iterations();
+					std::thread echo([&]()
+						{
+							for (uint64_t i = 0; i < iterations; ++i)
+								pong.Push(ping.Pop());
+						});
+					for (uint64_t i = 0; i < iterations; ++i)
+					{
+						ping.Push(i);
+						utils::DoNotOptimize(pong.Pop());
+					}
+					echo.join();
+				}, 1024);
+			runner.Add("Queue/Latency/Mpmc/RoundTrip", [](utils::BenchmarkState& state)
+				{
+					utils::MpmcQueue<uint64_t> ping(64);
+					utils::MpmcQueue<uint64_t> pong(64);
+					const uint64_t iterations = state.Iterations();
+					std::thread echo([&]()
+						{
+							for (uint64_t i = 0; i < iterations; ++i)
+								pong.Push(ping.Pop());
+						});
+					for (uint64_t i = 0; i < iterations; ++i)
+					{
+						ping.Push(i);
+						utils::DoNotOptimize(pong.Pop());
+					}
+					echo.join();
+				}, 1024);
+		}
+	}
+}
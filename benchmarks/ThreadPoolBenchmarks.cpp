@@ -0,0 +1,93 @@
+﻿#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "udan/utils/SystemScheduler.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		void RegisterThreadPoolBenchmarks(utils::BenchmarkRunner& runner)
+		{
+			for (const size_t taskCount : { 16, 256, 4096 })
+			{
+				runner.Add(fmt::format("ThreadPool/Schedule/{}", taskCount), [taskCount](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						std::atomic<size_t> executed{ 0 };
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							for (size_t i = 0; i < taskCount; ++i)
+								pool.Schedule(std::make_shared<utils::Task>([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }));
+							pool.WaitUntilQueueEmpty();
+						}
+						utils::DoNotOptimize(executed.load());
+						state.SetItemsPerIteration(taskCount);
+					});
+
+				runner.Add(fmt::format("ThreadPool/BulkSchedule/{}", taskCount), [taskCount](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						std::vector<std::shared_ptr<utils::ATask>> tasks(taskCount);
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							state.PauseTiming();
+							for (auto& task : tasks)
+								task = std::make_shared<utils::Task>([]() {});
+							state.ResumeTiming();
+							pool.BulkSchedule(tasks);
+							pool.WaitUntilQueueEmpty();
+						}
+						state.SetItemsPerIteration(taskCount);
+					});
+			}
+
+			for (const size_t chainLength : { 4, 64 })
+			{
+				runner.Add(fmt::format("ThreadPool/DependencyChain/{}", chainLength), [chainLength](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+						{
+							std::vector<std::shared_ptr<utils::ATask>> chain;
+							chain.reserve(chainLength);
+							chain.push_back(std::make_shared<utils::Task>([]() {}));
+							for (size_t i = 1; i < chainLength; ++i)
+								chain.push_back(std::make_shared<utils::DependencyTask>([]() {}, utils::DependencyVector{ chain.back() }));
+							// Tail first: every dependency is still pending when its dependent registers
+							for (auto task = chain.rbegin(); task != chain.rend(); ++task)
+								pool.Schedule(*task);
+							pool.WaitUntilQueueEmpty();
+						}
+						state.SetItemsPerIteration(chainLength);
+					});
+
+				// Same chain declared through access sets, every system writes the same type
+				runner.Add(fmt::format("SystemScheduler/Chain/{}", chainLength), [chainLength](utils::BenchmarkState& state)
+					{
+						struct Shared {};
+						auto& pool = GetBenchmarkPool();
+						utils::SystemScheduler scheduler;
+						for (size_t i = 0; i < chainLength; ++i)
+							scheduler.Add("chain", utils::SystemAccess().Write<Shared>(), []() {});
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							scheduler.Run(pool);
+						state.SetItemsPerIteration(chainLength);
+					});
+
+				runner.Add(fmt::format("SystemScheduler/Independent/{}", chainLength), [chainLength](utils::BenchmarkState& state)
+					{
+						auto& pool = GetBenchmarkPool();
+						utils::SystemScheduler scheduler;
+						for (size_t i = 0; i < chainLength; ++i)
+							scheduler.Add("independent", utils::SystemAccess(), []() {});
+						for (uint64_t it = 0; it < state.Iterations(); ++it)
+							scheduler.Run(pool);
+						state.SetItemsPerIteration(chainLength);
+					});
+			}
+		}
+	}
+}
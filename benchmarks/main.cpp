@@ -0,0 +1,70 @@
+﻿#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Benchmarks.h"
+
+namespace udan
+{
+	namespace benchmarks
+	{
+		utils::ThreadPool& GetBenchmarkPool()
+		{
+			static utils::ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+			return pool;
+		}
+	}
+}
+
+/**
+ * Usage: udan_utils_benchmarks [--filter <substring>] [--samples <count>] [--json <file>] [--csv <file>]
+ */
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string jsonPath;
+	std::string csvPath;
+	udan::utils::BenchmarkOptions options;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const std::string arg = argv[i];
+		if (i + 1 == argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		if (arg == "--filter")
+			filter = argv[i + 1];
+		else if (arg == "--samples")
+			options.sampleCount = std::strtoul(argv[i + 1], nullptr, 10);
+		else if (arg == "--json")
+			jsonPath = argv[i + 1];
+		else if (arg == "--csv")
+			csvPath = argv[i + 1];
+		else
+		{
+			std::cerr << "Unknown argument " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	udan::utils::BenchmarkRunner runner(options);
+	udan::benchmarks::RegisterThreadPoolBenchmarks(runner);
+	udan::benchmarks::RegisterLockBenchmarks(runner);
+	udan::benchmarks::RegisterEventBenchmarks(runner);
+	udan::benchmarks::RegisterQueueBenchmarks(runner);
+	udan::benchmarks::RegisterDataSetBenchmarks(runner);
+
+	const auto results = runner.Run(filter);
+	std::cout << udan::utils::BenchmarkRunner::ToText(results);
+	if (!jsonPath.empty())
+		std::ofstream(jsonPath) << udan::utils::BenchmarkRunner::ToJson(results);
+	if (!csvPath.empty())
+		std::ofstream(csvPath) << udan::utils::BenchmarkRunner::ToCsv(results);
+
+	udan::benchmarks::GetBenchmarkPool().Stop();
+	return 0;
+}
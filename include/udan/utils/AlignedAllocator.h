@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Standard allocator returning storage aligned on Alignment bytes, e.g. cache lines or SIMD registers
+		 */
+		template<typename T, size_t Alignment>
+		class AlignedAllocator
+		{
+			static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+			static_assert(Alignment >= alignof(T), "Alignment must be at least the alignment of T");
+
+		public:
+			typedef T value_type;
+
+			template<typename U>
+			struct rebind
+			{
+				typedef AlignedAllocator<U, Alignment> other;
+			};
+
+			AlignedAllocator() noexcept = default;
+
+			template<typename U>
+			AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept
+			{}
+
+			T* allocate(size_t count)
+			{
+				return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+			}
+
+			void deallocate(T* pointer, size_t count) noexcept
+			{
+				::operator delete(pointer, count * sizeof(T), std::align_val_t(Alignment));
+			}
+
+			template<typename U>
+			bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept
+			{
+				return true;
+			}
+
+			template<typename U>
+			bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept
+			{
+				return false;
+			}
+		};
+	}
+}
@@ -0,0 +1,777 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/ComponentSignatures.h"
+#include "udan/utils/EntityTraits.h"
+#include "udan/utils/ParallelFor.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Process wide index of a new archetype component type, at most ComponentSignatures::MaxComponents types
+		 * \throw std::length_error Past MaxComponents types, in every build type
+		 */
+		__declspec(dllexport) size_t NextArchetypeComponentIndex();
+
+		template<typename Component>
+		size_t ArchetypeComponentIndex()
+		{
+			static const size_t s_index = NextArchetypeComponentIndex();
+			return s_index;
+		}
+
+		template<typename Component>
+		ComponentMask ArchetypeComponentBit()
+		{
+			return ComponentMask(1) << ArchetypeComponentIndex<Component>();
+		}
+
+		/**
+		 * \brief Type erased operations of a component stored in archetype chunks.
+		 * relocate and destroy are nullptr for trivial types, which are moved with memcpy and never destroyed
+		 */
+		struct ArchetypeComponentInfo
+		{
+			size_t size = 0;
+			size_t alignment = 1;
+			// Move constructs destination from source then destroys source
+			void (*relocate)(void* destination, void* source) = nullptr;
+			void (*destroy)(void* component) = nullptr;
+
+			template<typename Component>
+			static ArchetypeComponentInfo Of()
+			{
+				ArchetypeComponentInfo info;
+				info.size = sizeof(Component);
+				info.alignment = alignof(Component);
+				if constexpr (!std::is_trivially_copyable_v<Component>)
+				{
+					info.relocate = [](void* destination, void* source)
+					{
+						Component* component = static_cast<Component*>(source);
+						new (destination) Component(std::move(*component));
+						component->~Component();
+					};
+				}
+				if constexpr (!std::is_trivially_destructible_v<Component>)
+					info.destroy = [](void* component) { static_cast<Component*>(component)->~Component(); };
+				return info;
+			}
+
+			void Relocate(void* destination, void* source) const
+			{
+				if (relocate != nullptr)
+					relocate(destination, source);
+				else
+					std::memcpy(destination, source, size);
+			}
+
+			void Destroy(void* component) const
+			{
+				if (destroy != nullptr)
+					destroy(component);
+			}
+		};
+
+		/**
+		 * \brief Every entity holding exactly the components of mask, stored in fixed size chunks.
+		 * A chunk holds the entity handles followed by one cache line aligned column per component (structure of arrays),
+		 * rows are kept packed: every chunk is full except the last one.
+		 * Rows are numbered globally, row / GetCapacity() is the chunk and row % GetCapacity() the position in it.
+		 */
+		template<typename Entity>
+		class Archetype
+		{
+		public:
+			static constexpr size_t ChunkSize = 16 * 1024;
+			static constexpr size_t NoColumn = ComponentSignatures<Entity>::MaxComponents;
+
+			Archetype(ComponentMask mask, const ArchetypeComponentInfo* infos) : m_mask(mask)
+			{
+				m_columnOf.fill(NoColumn);
+				size_t rowSize = sizeof(Entity);
+				for (ComponentMask bits = mask; bits != 0; bits &= bits - 1)
+				{
+					const size_t type = std::countr_zero(bits);
+					m_columnOf[type] = m_columns.size();
+					m_columns.push_back({ infos[type], type, 0 });
+					m_chunkAlignment = std::max(m_chunkAlignment, infos[type].alignment);
+					rowSize += infos[type].size;
+				}
+				// Largest capacity whose padded layout fits a chunk, components larger than a chunk get one row per chunk
+				m_capacity = std::max<size_t>(ChunkSize / rowSize, 1);
+				while (m_capacity > 1 && Layout(m_capacity) > ChunkSize)
+					--m_capacity;
+				m_chunkBytes = std::max(ChunkSize, Layout(m_capacity));
+			}
+
+			Archetype(const Archetype&) = delete;
+			Archetype& operator=(const Archetype&) = delete;
+
+			~Archetype()
+			{
+				Clear();
+				for (std::byte* chunk : m_chunks)
+					::operator delete(chunk, m_chunkBytes, std::align_val_t(m_chunkAlignment));
+			}
+
+			/**
+			 * \brief Add an uninitialized row for entity at the back, every column of the row must then be constructed
+			 * \return Row of entity
+			 */
+			size_t AppendRow(Entity entity)
+			{
+				if (m_size == m_chunks.size() * m_capacity)
+					m_chunks.push_back(static_cast<std::byte*>(::operator new(m_chunkBytes, std::align_val_t(m_chunkAlignment))));
+				const size_t row = m_size++;
+				EntityAt(row) = entity;
+				return row;
+			}
+
+			/**
+			 * \brief Fill row with the last row, the components of row must already be destroyed or relocated
+			 * \return Entity moved to row, Null when row was the last one
+			 */
+			Entity EraseRow(size_t row)
+			{
+				const size_t last = --m_size;
+				if (row == last)
+					return EntityTraits<Entity>::Null;
+				for (size_t column = 0; column < m_columns.size(); ++column)
+					m_columns[column].info.Relocate(At(column, row), At(column, last));
+				return EntityAt(row) = EntityAt(last);
+			}
+
+			void DestroyComponent(size_t column, size_t row)
+			{
+				m_columns[column].info.Destroy(At(column, row));
+			}
+
+			/**
+			 * \brief Destroy every row, chunks are kept for reuse
+			 */
+			void Clear()
+			{
+				for (size_t column = 0; column < m_columns.size(); ++column)
+				{
+					if (m_columns[column].info.destroy == nullptr)
+						continue;
+					for (size_t row = 0; row < m_size; ++row)
+						DestroyComponent(column, row);
+				}
+				m_size = 0;
+			}
+
+			void* At(size_t column, size_t row) const
+			{
+				return m_chunks[row / m_capacity] + m_columns[column].offset + (row % m_capacity) * m_columns[column].info.size;
+			}
+
+			template<typename Component>
+			Component* GetComponent(size_t row) const
+			{
+				return static_cast<Component*>(At(FindColumn(ArchetypeComponentIndex<Component>()), row));
+			}
+
+			Entity GetEntity(size_t row) const
+			{
+				return reinterpret_cast<const Entity*>(m_chunks[row / m_capacity])[row % m_capacity];
+			}
+
+			/**
+			 * \brief Component column of the rows of chunk, GetChunkRowCount(chunk) long
+			 */
+			template<typename Component>
+			Component* GetColumn(size_t chunk) const
+			{
+				const size_t column = FindColumn(ArchetypeComponentIndex<Component>());
+				assert(column != NoColumn);
+				return reinterpret_cast<Component*>(m_chunks[chunk] + m_columns[column].offset);
+			}
+
+			const Entity* GetEntities(size_t chunk) const
+			{
+				return reinterpret_cast<const Entity*>(m_chunks[chunk]);
+			}
+
+			size_t FindColumn(size_t type) const
+			{
+				return m_columnOf[type];
+			}
+
+			size_t GetColumnType(size_t column) const
+			{
+				return m_columns[column].type;
+			}
+
+			const ArchetypeComponentInfo& GetColumnInfo(size_t column) const
+			{
+				return m_columns[column].info;
+			}
+
+			size_t GetColumnCount() const
+			{
+				return m_columns.size();
+			}
+
+			ComponentMask GetMask() const
+			{
+				return m_mask;
+			}
+
+			/**
+			 * \brief Rows per chunk
+			 */
+			size_t GetCapacity() const
+			{
+				return m_capacity;
+			}
+
+			/**
+			 * \brief Chunks holding at least one row
+			 */
+			size_t GetChunkCount() const
+			{
+				return (m_size + m_capacity - 1) / m_capacity;
+			}
+
+			size_t GetChunkRowCount(size_t chunk) const
+			{
+				return std::min(m_capacity, m_size - chunk * m_capacity);
+			}
+
+			size_t GetSize() const
+			{
+				return m_size;
+			}
+
+		private:
+			struct Column
+			{
+				ArchetypeComponentInfo info;
+				size_t type;
+				size_t offset;
+			};
+
+			/**
+			 * \brief Place the columns of a chunk of capacity rows
+			 * \return Bytes used
+			 */
+			size_t Layout(size_t capacity)
+			{
+				size_t offset = capacity * sizeof(Entity);
+				for (Column& column : m_columns)
+				{
+					const size_t alignment = std::max(column.info.alignment, CacheLineSize);
+					offset = (offset + alignment - 1) & ~(alignment - 1);
+					column.offset = offset;
+					offset += capacity * column.info.size;
+				}
+				return offset;
+			}
+
+			Entity& EntityAt(size_t row)
+			{
+				return reinterpret_cast<Entity*>(m_chunks[row / m_capacity])[row % m_capacity];
+			}
+
+			ComponentMask m_mask;
+			std::vector<Column> m_columns;
+			std::array<size_t, ComponentSignatures<Entity>::MaxComponents> m_columnOf;
+			size_t m_capacity = 1;
+			size_t m_chunkBytes = ChunkSize;
+			size_t m_chunkAlignment = CacheLineSize;
+			std::vector<std::byte*> m_chunks;
+			size_t m_size = 0;
+		};
+
+		/**
+		 * \brief Component storage grouping entities by their exact set of components (archetype).
+		 * Queries walk the chunks of the matching archetypes linearly instead of probing one sparse set per component,
+		 * in exchange adding or removing a component moves every component of the entity to another archetype.
+		 * Archetypes are never deleted, so queries only have to match the ones created since they last ran.
+		 */
+		template<typename Entity>
+		class ArchetypeStorage
+		{
+			typedef EntityTraits<Entity> Traits;
+			static constexpr size_t NoArchetype = std::numeric_limits<size_t>::max();
+
+			struct Location
+			{
+				size_t archetype = NoArchetype;
+				size_t row = 0;
+			};
+
+		public:
+			ArchetypeStorage() = default;
+			ArchetypeStorage(const ArchetypeStorage&) = delete;
+			ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+			/**
+			 * \brief Give entity the components, components it already has are assigned.
+			 * The entity moves at most once whatever the number of components added.
+			 * Components left behind by a destroyed entity of the same slot are destroyed first, a stale handle of a
+			 * newer entity is ignored.
+			 */
+			template<typename ...Components>
+			void Add(Entity entity, Components&& ...components)
+			{
+				(Register<std::decay_t<Components>>(), ...);
+				const ComponentMask bits = (ArchetypeComponentBit<std::decay_t<Components>>() | ...);
+				Location* assured = Assure(entity);
+				if (assured == nullptr)
+					return;
+				Location& location = *assured;
+				const ComponentMask current = location.archetype == NoArchetype ? 0 : m_archetypes[location.archetype]->GetMask();
+				if ((current & bits) != bits)
+					MoveTo(entity, location, GetOrCreateArchetype(current | bits));
+				const Archetype<Entity>& archetype = *m_archetypes[location.archetype];
+				(Store(archetype, location.row, current, std::forward<Components>(components)), ...);
+			}
+
+			/**
+			 * \brief Destroy the listed components of entity, the entity leaves the storage with its last component
+			 */
+			template<typename ...Components>
+			void Remove(Entity entity)
+			{
+				Location* location = Find(entity);
+				if (location == nullptr)
+					return;
+				const ComponentMask current = m_archetypes[location->archetype]->GetMask();
+				const ComponentMask target = current & ~(ComponentMask(0) | ... | ArchetypeComponentBit<Components>());
+				if (target == current)
+					return;
+				if (target == 0)
+					Destroy(entity);
+				else
+					MoveTo(entity, *location, GetOrCreateArchetype(target));
+			}
+
+			/**
+			 * \brief Destroy every component of entity
+			 */
+			void Destroy(Entity entity)
+			{
+				Location* location = Find(entity);
+				if (location == nullptr)
+					return;
+				Archetype<Entity>& archetype = *m_archetypes[location->archetype];
+				for (size_t column = 0; column < archetype.GetColumnCount(); ++column)
+					archetype.DestroyComponent(column, location->row);
+				EraseRow(location->archetype, location->row);
+				*location = Location();
+				--m_size;
+			}
+
+			template<typename ...Components>
+			[[nodiscard]] bool Has(Entity entity) const
+			{
+				const Location* location = Find(entity);
+				const ComponentMask bits = (ComponentMask(0) | ... | ArchetypeComponentBit<Components>());
+				return location != nullptr && (m_archetypes[location->archetype]->GetMask() & bits) == bits;
+			}
+
+			[[nodiscard]] bool Contains(Entity entity) const
+			{
+				return Find(entity) != nullptr;
+			}
+
+			/**
+			 * \return nullptr when entity does not have the component
+			 */
+			template<typename Component>
+			Component* TryGet(Entity entity) const
+			{
+				const Location* location = Find(entity);
+				if (location == nullptr)
+					return nullptr;
+				const Archetype<Entity>& archetype = *m_archetypes[location->archetype];
+				if (archetype.FindColumn(ArchetypeComponentIndex<Component>()) == Archetype<Entity>::NoColumn)
+					return nullptr;
+				return archetype.template GetComponent<Component>(location->row);
+			}
+
+			template<typename Component>
+			Component& Get(Entity entity) const
+			{
+				Component* component = TryGet<Component>(entity);
+				assert(component != nullptr);
+				return *component;
+			}
+
+			/**
+			 * \brief Destroy every component, archetypes are kept so queries stay valid
+			 */
+			void Clear()
+			{
+				for (auto& archetype : m_archetypes)
+					archetype->Clear();
+				m_locations.clear();
+				m_size = 0;
+			}
+
+			size_t GetArchetypeCount() const
+			{
+				return m_archetypes.size();
+			}
+
+			const Archetype<Entity>& GetArchetype(size_t index) const
+			{
+				return *m_archetypes[index];
+			}
+
+			/**
+			 * \brief Number of entities holding at least one component
+			 */
+			size_t GetSize() const
+			{
+				return m_size;
+			}
+
+		private:
+			template<typename Component>
+			void Register()
+			{
+				const size_t type = ArchetypeComponentIndex<Component>();
+				assert(type < ComponentSignatures<Entity>::MaxComponents);
+				if ((m_registered & (ComponentMask(1) << type)) == 0)
+				{
+					m_infos[type] = ArchetypeComponentInfo::Of<Component>();
+					m_registered |= ComponentMask(1) << type;
+				}
+			}
+
+			template<typename Component>
+			void Store(const Archetype<Entity>& archetype, size_t row, ComponentMask previous, Component&& component)
+			{
+				typedef std::decay_t<Component> Type;
+				Type* destination = archetype.template GetComponent<Type>(row);
+				if ((previous & ArchetypeComponentBit<Type>()) != 0)
+					*destination = std::forward<Component>(component);
+				else
+					new (destination) Type(std::forward<Component>(component));
+			}
+
+			Location* Find(Entity entity)
+			{
+				const Entity index = Traits::Index(entity);
+				if (index >= m_locations.size())
+					return nullptr;
+				Location& location = m_locations[index];
+				if (location.archetype == NoArchetype || m_archetypes[location.archetype]->GetEntity(location.row) != entity)
+					return nullptr;
+				return &location;
+			}
+
+			const Location* Find(Entity entity) const
+			{
+				return const_cast<ArchetypeStorage*>(this)->Find(entity);
+			}
+
+			/**
+			 * \brief Location of entity, empty when it has no component yet.
+			 * Same rules as SparseSet::PrepareInsert: null when a newer entity holds the slot
+			 */
+			Location* Assure(Entity entity)
+			{
+				const Entity index = Traits::Index(entity);
+				if (index >= m_locations.size())
+					m_locations.resize(index + 1);
+				Location& location = m_locations[index];
+				if (location.archetype != NoArchetype)
+				{
+					const Entity stored = m_archetypes[location.archetype]->GetEntity(location.row);
+					if (stored != entity)
+					{
+						if (!Traits::IsNewer(entity, stored))
+							return nullptr;
+						Destroy(stored);
+					}
+				}
+				if (location.archetype == NoArchetype)
+					++m_size;
+				return &location;
+			}
+
+			size_t GetOrCreateArchetype(ComponentMask mask)
+			{
+				const auto it = m_archetypeOf.find(mask);
+				if (it != m_archetypeOf.end())
+					return it->second;
+				m_archetypes.push_back(std::make_unique<Archetype<Entity>>(mask, m_infos.data()));
+				m_archetypeOf.emplace(mask, m_archetypes.size() - 1);
+				return m_archetypes.size() - 1;
+			}
+
+			/**
+			 * \brief Move entity to archetype target: shared components are relocated, the others destroyed.
+			 * Components of target that entity did not have are left unconstructed
+			 */
+			void MoveTo(Entity entity, Location& location, size_t target)
+			{
+				Archetype<Entity>& to = *m_archetypes[target];
+				const size_t row = to.AppendRow(entity);
+				if (location.archetype != NoArchetype)
+				{
+					Archetype<Entity>& from = *m_archetypes[location.archetype];
+					for (size_t column = 0; column < from.GetColumnCount(); ++column)
+					{
+						const size_t destination = to.FindColumn(from.GetColumnType(column));
+						if (destination != Archetype<Entity>::NoColumn)
+							from.GetColumnInfo(column).Relocate(to.At(destination, row), from.At(column, location.row));
+						else
+							from.DestroyComponent(column, location.row);
+					}
+					EraseRow(location.archetype, location.row);
+				}
+				location.archetype = target;
+				location.row = row;
+			}
+
+			void EraseRow(size_t archetype, size_t row)
+			{
+				const Entity moved = m_archetypes[archetype]->EraseRow(row);
+				if (moved != Traits::Null)
+					m_locations[Traits::Index(moved)].row = row;
+			}
+
+			std::vector<std::unique_ptr<Archetype<Entity>>> m_archetypes;
+			std::unordered_map<ComponentMask, size_t> m_archetypeOf;
+			std::vector<Location> m_locations;
+			std::array<ArchetypeComponentInfo, ComponentSignatures<Entity>::MaxComponents> m_infos{};
+			ComponentMask m_registered = 0;
+			size_t m_size = 0;
+		};
+
+		/**
+		 * \brief Entities of an ArchetypeStorage holding every component of the query, same interface as LazyDataSetView.
+		 * The matching archetypes are cached, each call only tests the archetypes created since the previous one.
+		 * The storage must not gain or lose components while an iterator is live.
+		 */
+		template<typename Entity, typename ...Components>
+		class ArchetypeQuery
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = std::tuple<Components&...>;
+				using reference = value_type;
+				using pointer = void;
+
+				Iterator() = default;
+
+				Iterator(const ArchetypeQuery* query, size_t match) : m_query(query), m_match(match)
+				{
+					Settle();
+				}
+
+				value_type operator*() const
+				{
+					return std::apply([this](Components* ...columns) { return value_type(columns[m_row]...); }, m_columns);
+				}
+
+				Entity GetEntity() const
+				{
+					return m_entities[m_row];
+				}
+
+				Iterator& operator++()
+				{
+					if (++m_row == m_rowCount)
+					{
+						m_row = 0;
+						++m_chunk;
+						Settle();
+					}
+					return *this;
+				}
+
+				Iterator operator++(int)
+				{
+					Iterator tmp = *this;
+					++*this;
+					return tmp;
+				}
+
+				bool operator==(const Iterator& other) const
+				{
+					return m_match == other.m_match && m_chunk == other.m_chunk && m_row == other.m_row;
+				}
+
+				bool operator!=(const Iterator& other) const
+				{
+					return !(*this == other);
+				}
+
+			private:
+				// Move to the first row of the next non empty chunk, or to the end
+				void Settle()
+				{
+					for (; m_match < m_query->m_matches.size(); ++m_match, m_chunk = 0)
+					{
+						const Archetype<Entity>& archetype = *m_query->m_matches[m_match];
+						if (m_chunk < archetype.GetChunkCount())
+						{
+							m_entities = archetype.GetEntities(m_chunk);
+							m_rowCount = archetype.GetChunkRowCount(m_chunk);
+							m_columns = std::make_tuple(archetype.template GetColumn<Components>(m_chunk)...);
+							return;
+						}
+					}
+					m_chunk = 0;
+				}
+
+				const ArchetypeQuery* m_query = nullptr;
+				size_t m_match = 0;
+				size_t m_chunk = 0;
+				size_t m_row = 0;
+				size_t m_rowCount = 0;
+				const Entity* m_entities = nullptr;
+				std::tuple<Components*...> m_columns{};
+			};
+
+			explicit ArchetypeQuery(ArchetypeStorage<Entity>& storage) :
+				m_storage(storage),
+				m_query((ComponentMask(0) | ... | ArchetypeComponentBit<Components>()))
+			{}
+
+			Iterator begin()
+			{
+				Refresh();
+				return Iterator(this, 0);
+			}
+
+			Iterator end()
+			{
+				Refresh();
+				return Iterator(this, m_matches.size());
+			}
+
+			/**
+			 * \brief Call func(components&...) or func(entity, components&...) for every match
+			 */
+			template<typename Func>
+			void Each(Func func)
+			{
+				Refresh();
+				for (const Archetype<Entity>* archetype : m_matches)
+				{
+					for (size_t chunk = 0; chunk < archetype->GetChunkCount(); ++chunk)
+						EachInChunk(func, *archetype, chunk);
+				}
+			}
+
+			/**
+			 * \brief Call func(count, entities, columns...) once per chunk, each column holding count components.
+			 * Meant for loops the compiler can vectorize over the columns
+			 */
+			template<typename Func>
+			void EachChunk(Func func)
+			{
+				Refresh();
+				for (const Archetype<Entity>* archetype : m_matches)
+				{
+					for (size_t chunk = 0; chunk < archetype->GetChunkCount(); ++chunk)
+						func(archetype->GetChunkRowCount(chunk), archetype->GetEntities(chunk), archetype->template GetColumn<Components>(chunk)...);
+				}
+			}
+
+			/**
+			 * \brief Each split in groups of grain chunks run on the pool, returns once every chunk ran.
+			 * func runs concurrently on distinct entities
+			 */
+			template<typename Func>
+			void ParallelEach(ThreadPool& threadPool, const Func& func, size_t grain = 1)
+			{
+				Refresh();
+				size_t chunkCount = 0;
+				for (const Archetype<Entity>* archetype : m_matches)
+					chunkCount += archetype->GetChunkCount();
+				ParallelFor(threadPool, chunkCount, grain, [this, &func](size_t begin, size_t end)
+					{
+						// Chunks are numbered across the matching archetypes in order
+						size_t first = 0;
+						for (const Archetype<Entity>* archetype : m_matches)
+						{
+							const size_t count = archetype->GetChunkCount();
+							for (size_t chunk = std::max(begin, first); chunk < std::min(end, first + count); ++chunk)
+								EachInChunk(func, *archetype, chunk - first);
+							first += count;
+							if (first >= end)
+								break;
+						}
+					});
+			}
+
+			/**
+			 * \brief Number of matching entities
+			 */
+			size_t GetSize()
+			{
+				Refresh();
+				size_t size = 0;
+				for (const Archetype<Entity>* archetype : m_matches)
+					size += archetype->GetSize();
+				return size;
+			}
+
+			size_t GetArchetypeCount()
+			{
+				Refresh();
+				return m_matches.size();
+			}
+
+		private:
+			void Refresh()
+			{
+				for (; m_checked < m_storage.GetArchetypeCount(); ++m_checked)
+				{
+					const Archetype<Entity>& archetype = m_storage.GetArchetype(m_checked);
+					if ((archetype.GetMask() & m_query) == m_query)
+						m_matches.push_back(&archetype);
+				}
+			}
+
+			template<typename Func>
+			static void EachInChunk(Func& func, const Archetype<Entity>& archetype, size_t chunk)
+			{
+				const size_t count = archetype.GetChunkRowCount(chunk);
+				const Entity* entities = archetype.GetEntities(chunk);
+				const std::tuple<Components*...> columns(archetype.template GetColumn<Components>(chunk)...);
+				for (size_t row = 0; row < count; ++row)
+				{
+					InvokeWithComponents(func, entities[row],
+						std::apply([row](Components* ...column) { return std::tuple<Components&...>(column[row]...); }, columns));
+				}
+			}
+
+			ArchetypeStorage<Entity>& m_storage;
+			ComponentMask m_query;
+			std::vector<const Archetype<Entity>*> m_matches;
+			size_t m_checked = 0;
+		};
+	}
+}
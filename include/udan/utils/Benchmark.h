@@ -0,0 +1,155 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Timer.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Prevent the compiler from optimizing away the computation of value
+		 */
+		template<typename T>
+		void DoNotOptimize(T&& value)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			static volatile const void* s_sink;
+			s_sink = &value;
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+#else
+			asm volatile("" : : "r,m"(value) : "memory");
+#endif
+		}
+
+		/**
+		 * \brief Handed to a benchmark function which must run its body Iterations() times
+		 */
+		class BenchmarkState
+		{
+		public:
+			explicit BenchmarkState(uint64_t iterations) : m_iterations(iterations)
+			{
+			}
+
+			[[nodiscard]] uint64_t Iterations() const
+			{
+				return m_iterations;
+			}
+
+			/**
+			 * \brief Exclude setup work from the measurement
+			 */
+			void PauseTiming()
+			{
+				m_pause.Reset();
+			}
+
+			void ResumeTiming()
+			{
+				m_paused += m_pause.GetDeltaTicks();
+			}
+
+			/**
+			 * \brief Items handled by one iteration, used to report a throughput
+			 */
+			void SetItemsPerIteration(uint64_t items)
+			{
+				m_itemsPerIteration = items;
+			}
+
+			[[nodiscard]] Clock::Ticks GetPausedTicks() const
+			{
+				return m_paused;
+			}
+
+			[[nodiscard]] uint64_t GetItemsPerIteration() const
+			{
+				return m_itemsPerIteration;
+			}
+
+		private:
+			uint64_t m_iterations;
+			uint64_t m_itemsPerIteration = 0;
+			Timer m_pause;
+			Clock::Ticks m_paused = 0;
+		};
+
+		struct BenchmarkOptions
+		{
+			double warmupSeconds = 0.05;
+			// Iterations per sample are doubled until a sample lasts at least this long
+			double minSampleSeconds = 0.005;
+			size_t sampleCount = 20;
+			// Samples outside [Q1 - k * IQR, Q3 + k * IQR] are rejected (Tukey fences)
+			double outlierFactor = 1.5;
+			// Expensive benchmarks run at least this many iterations per sample
+			uint64_t minIterations = 1;
+		};
+
+		/**
+		 * \brief Statistics of one benchmark, times are nanoseconds per iteration
+		 */
+		struct BenchmarkResult
+		{
+			std::string name;
+			uint64_t iterationsPerSample = 0;
+			size_t samples = 0;
+			size_t outliers = 0;
+			double mean = 0.0;
+			double stddev = 0.0;
+			double min = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+			// 0 when the benchmark did not call SetItemsPerIteration
+			double itemsPerSecond = 0.0;
+		};
+
+		/**
+		 * \brief Runs registered benchmarks with warmup, auto calibrated iteration counts and outlier rejection
+		 */
+		class BenchmarkRunner
+		{
+		public:
+			typedef std::function<void(BenchmarkState&)> BenchmarkFunction;
+
+			explicit BenchmarkRunner(BenchmarkOptions options = {}) : m_options(options)
+			{
+			}
+
+			void Add(std::string name, BenchmarkFunction function, uint64_t minIterations = 0)
+			{
+				m_benchmarks.push_back({ std::move(name), std::move(function), minIterations });
+			}
+
+			/**
+			 * \param filter Only run benchmarks whose name contains filter
+			 */
+			__declspec(dllexport) std::vector<BenchmarkResult> Run(std::string_view filter = {}) const;
+			__declspec(dllexport) BenchmarkResult RunOne(const std::string& name, const BenchmarkFunction& function, uint64_t minIterations = 0) const;
+
+			__declspec(dllexport) static std::string ToText(const std::vector<BenchmarkResult>& results);
+			__declspec(dllexport) static std::string ToJson(const std::vector<BenchmarkResult>& results);
+			__declspec(dllexport) static std::string ToCsv(const std::vector<BenchmarkResult>& results);
+
+		private:
+			struct Entry
+			{
+				std::string name;
+				BenchmarkFunction function;
+				uint64_t minIterations;
+			};
+
+			BenchmarkOptions m_options;
+			std::vector<Entry> m_benchmarks;
+		};
+	}
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <cstddef>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// MSVC ignores [[no_unique_address]] to keep its ABI, only its own spelling removes the storage of empty members
+#if defined(_MSC_VER)
+#define UDAN_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define UDAN_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Granularity used to pad data written by different threads, avoids false sharing
+		 */
+		constexpr size_t CacheLineSize = 64;
+
+		/**
+		 * \brief Hint the cache line holding address into L1 ahead of a read
+		 */
+		inline void Prefetch(const void* address)
+		{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+			_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+			__builtin_prefetch(address);
+#else
+			(void)address;
+#endif
+		}
+	}
+}
@@ -0,0 +1,201 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Default DataSet tracking policy, every hook is empty and the member takes no room
+		 */
+		template<typename Entity>
+		struct NoChangeTracking
+		{
+			static constexpr bool Enabled = false;
+
+			void Reserve(size_t) {}
+			void Append(Entity) {}
+			void Erase(size_t, Entity) {}
+			void Swap(size_t, size_t) {}
+			void Move(size_t, size_t) {}
+			void Truncate(size_t) {}
+			void Permute(const std::vector<Entity>&) {}
+			void Touch(size_t, Entity) {}
+			void TouchAll(std::span<const Entity>) {}
+			void LogRemoved(Entity) {}
+			void Clear(std::span<const Entity>) {}
+		};
+
+		enum class ChangeKind : uint8_t
+		{
+			ADDED,
+			UPDATED,
+			REMOVED
+		};
+
+		/**
+		 * \brief DataSet tracking policy stamping every component with the tick it was last added or obtained mutably,
+		 * and logging additions, first updates of a tick and removals in tick order.
+		 * Incremental systems remember the tick they last ran at and only visit the log entries after it.
+		 * Not synchronized: a tracked set is written from one thread at a time, views refuse to ParallelEach over it mutably.
+		 */
+		template<typename Entity>
+		class ChangeTracking
+		{
+		public:
+			static constexpr bool Enabled = true;
+
+			struct Change
+			{
+				Entity entity;
+				uint32_t tick;
+				ChangeKind kind;
+			};
+
+			/**
+			 * \brief Changes from now on are stamped with tick, ticks only grow
+			 */
+			void SetTick(uint32_t tick)
+			{
+				assert(tick >= m_tick);
+				m_tick = tick;
+			}
+
+			uint32_t GetTick() const
+			{
+				return m_tick;
+			}
+
+			/**
+			 * \brief Tick the component at dense position pos was last added or updated at
+			 */
+			uint32_t GetStamp(size_t pos) const
+			{
+				return m_stamps[pos].tick;
+			}
+
+			/**
+			 * \return true when change, taken from GetChanges, is the last entry logged for the component at pos
+			 */
+			bool IsLatest(size_t pos, const Change& change) const
+			{
+				return m_stamps[pos].entry == m_trimmed + static_cast<uint64_t>(&change - m_log.data());
+			}
+
+			/**
+			 * \brief Log entries stamped after tick, oldest first. An entity updated over several ticks appears once per tick
+			 */
+			std::span<const Change> GetChanges(uint32_t since) const
+			{
+				const auto first = std::upper_bound(m_log.begin(), m_log.end(), since,
+					[](uint32_t tick, const Change& change) { return tick < change.tick; });
+				return { m_log.data() + (first - m_log.begin()), static_cast<size_t>(m_log.end() - first) };
+			}
+
+			/**
+			 * \brief Forget log entries stamped before tick, stamps are kept
+			 */
+			void Trim(uint32_t before)
+			{
+				const auto last = std::lower_bound(m_log.begin(), m_log.end(), before,
+					[](const Change& change, uint32_t tick) { return change.tick < tick; });
+				m_trimmed += static_cast<uint64_t>(last - m_log.begin());
+				m_log.erase(m_log.begin(), last);
+			}
+
+			void Reserve(size_t capacity)
+			{
+				m_stamps.reserve(capacity);
+			}
+
+			void Append(Entity entity)
+			{
+				m_stamps.push_back({ m_tick, NextEntry() });
+				m_log.push_back({ entity, m_tick, ChangeKind::ADDED });
+			}
+
+			// Swap and pop, like the components
+			void Erase(size_t pos, Entity entity)
+			{
+				m_stamps[pos] = m_stamps.back();
+				m_stamps.pop_back();
+				LogRemoved(entity);
+			}
+
+			void Swap(size_t a, size_t b)
+			{
+				std::swap(m_stamps[a], m_stamps[b]);
+			}
+
+			void Move(size_t to, size_t from)
+			{
+				m_stamps[to] = m_stamps[from];
+			}
+
+			void Truncate(size_t size)
+			{
+				m_stamps.resize(size);
+			}
+
+			void Permute(const std::vector<Entity>& order)
+			{
+				std::vector<Stamp> stamps(order.size());
+				for (size_t pos = 0; pos < order.size(); ++pos)
+					stamps[pos] = m_stamps[order[pos]];
+				m_stamps = std::move(stamps);
+			}
+
+			/**
+			 * \brief The component at pos was obtained mutably, only the first update of a tick is logged
+			 */
+			void Touch(size_t pos, Entity entity)
+			{
+				if (m_stamps[pos].tick == m_tick)
+					return;
+				m_stamps[pos] = { m_tick, NextEntry() };
+				m_log.push_back({ entity, m_tick, ChangeKind::UPDATED });
+			}
+
+			void TouchAll(std::span<const Entity> entities)
+			{
+				for (size_t pos = 0; pos < entities.size(); ++pos)
+					Touch(pos, entities[pos]);
+			}
+
+			void LogRemoved(Entity entity)
+			{
+				m_log.push_back({ entity, m_tick, ChangeKind::REMOVED });
+			}
+
+			void Clear(std::span<const Entity> entities)
+			{
+				for (const Entity entity : entities)
+					LogRemoved(entity);
+				m_stamps.clear();
+			}
+
+		private:
+			struct Stamp
+			{
+				uint32_t tick;
+				// Absolute index of the last log entry of the component, counting trimmed entries
+				uint64_t entry;
+			};
+
+			uint64_t NextEntry() const
+			{
+				return m_trimmed + m_log.size();
+			}
+
+			std::vector<Stamp> m_stamps;
+			std::vector<Change> m_log;
+			uint64_t m_trimmed = 0;
+			uint32_t m_tick = 1;
+		};
+	}
+}
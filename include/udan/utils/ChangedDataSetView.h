@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include "udan/utils/ChangeTracking.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Entities whose Tracked component was added or obtained mutably after tick since, and present in every other dataset.
+		 * Walks the change log of Tracked instead of its entities, so the cost follows the number of changes.
+		 * The tracked component is passed read only so that visiting it does not stamp it again,
+		 * other datasets given as const are read only too.
+		 */
+		template<typename Entity, typename Tracked, typename ...Datasets>
+		class ChangedDataSetView
+		{
+			static constexpr Entity NoEntity = PagedSparseArray<Entity>::Null;
+			// Changed entities are scattered, their sparse entries are prefetched this many log entries ahead
+			static constexpr size_t PrefetchDistance = 16;
+
+			using Indices = std::index_sequence_for<Datasets...>;
+			using Positions = std::array<Entity, sizeof...(Datasets) + 1>;
+
+		public:
+			ChangedDataSetView(uint32_t since, Tracked& tracked, Datasets& ...datasets) :
+				m_changes(tracked.GetChanges().GetChanges(since)),
+				m_tracked(tracked),
+				m_datasets(datasets...)
+			{}
+
+			/**
+			 * \brief Call func(tracked, components&...) or func(entity, tracked, components&...) for every match
+			 */
+			template<typename Func>
+			void Each(Func func)
+			{
+				Positions positions;
+				for (size_t i = 0; i < m_changes.size(); ++i)
+				{
+					if (i + PrefetchDistance < m_changes.size())
+						PrefetchAll(m_changes[i + PrefetchDistance].entity, Indices{});
+					const auto& change = m_changes[i];
+					if (change.kind == ChangeKind::REMOVED)
+						continue;
+					positions[0] = m_tracked.Find(change.entity);
+					// An entity changed over several ticks is only visited at its last entry
+					if (positions[0] == NoEntity || !m_tracked.GetChanges().IsLatest(positions[0], change))
+						continue;
+					if (ProbeAll(change.entity, positions, Indices{}))
+						InvokeWithComponents(func, change.entity, Fetch(positions, Indices{}));
+				}
+			}
+
+			/**
+			 * \brief Number of log entries walked, an upper bound of the match count
+			 */
+			size_t GetSize() const
+			{
+				return m_changes.size();
+			}
+
+		private:
+			template<size_t... Is>
+			void PrefetchAll(Entity entity, std::index_sequence<Is...>) const
+			{
+				m_tracked.Prefetch(entity);
+				(std::get<Is>(m_datasets).Prefetch(entity), ...);
+			}
+
+			template<size_t... Is>
+			bool ProbeAll(Entity entity, Positions& positions, std::index_sequence<Is...>) const
+			{
+				return ((positions[Is + 1] = std::get<Is>(m_datasets).Find(entity), positions[Is + 1] != NoEntity) && ...);
+			}
+
+			template<size_t... Is>
+			auto Fetch(const Positions& positions, std::index_sequence<Is...>)
+			{
+				return std::tuple_cat(m_tracked.PeekAtIndex(positions[0]), utils::GetDataAtIndex(std::get<Is>(m_datasets), positions[Is + 1])...);
+			}
+
+			std::span<const typename ChangeTracking<Entity>::Change> m_changes;
+			Tracked& m_tracked;
+			std::tuple<Datasets& ...> m_datasets;
+		};
+	}
+}
@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "CpuFeatures.h"
+
+#if UDAN_ARCH_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Monotonic clock counting integer ticks.
+		 * Reads the time stamp counter when the CPU reports it as invariant (constant rate, synchronized
+		 * between cores), otherwise falls back to QueryPerformanceCounter or clock_gettime(CLOCK_MONOTONIC).
+		 * The tick frequency is calibrated on first use, so the clock can be read from any static initializer.
+		 */
+		class Clock
+		{
+		public:
+			typedef uint64_t Ticks;
+
+			static Ticks Now()
+			{
+#if UDAN_ARCH_X86
+				const Source source = s_source.load(std::memory_order_relaxed);
+				if (source == Source::Tsc)
+					return __rdtsc();
+				if (source == Source::Unknown)
+					return ResolveSource() == Source::Tsc ? __rdtsc() : ReadFallback();
+#endif
+				return ReadFallback();
+			}
+
+			[[nodiscard]] static uint64_t Frequency()
+			{
+				return GetCalibration().frequency;
+			}
+
+			[[nodiscard]] static bool UsesTsc()
+			{
+				return GetCalibration().useTsc;
+			}
+
+			[[nodiscard]] static double ToSeconds(Ticks ticks)
+			{
+				return static_cast<double>(ticks) * GetCalibration().secondsPerTick;
+			}
+
+			[[nodiscard]] static uint64_t ToNanoseconds(Ticks ticks)
+			{
+				return static_cast<uint64_t>(static_cast<double>(ticks) * GetCalibration().nanosecondsPerTick);
+			}
+
+			[[nodiscard]] static Ticks FromNanoseconds(uint64_t nanoseconds)
+			{
+				return static_cast<Ticks>(static_cast<double>(nanoseconds) / GetCalibration().nanosecondsPerTick);
+			}
+
+		private:
+			enum class Source : uint8_t
+			{
+				Unknown,
+				Tsc,
+				Fallback
+			};
+
+			struct Calibration
+			{
+				bool useTsc;
+				uint64_t frequency;
+				double secondsPerTick;
+				double nanosecondsPerTick;
+			};
+
+			__declspec(dllexport) static Ticks ReadFallback();
+			__declspec(dllexport) static uint64_t FallbackFrequency();
+			static Calibration Calibrate();
+
+			__declspec(dllexport) static const Calibration& GetCalibration();
+
+			// First read of the module, calibrates if nobody did yet
+			static Source ResolveSource()
+			{
+				const Source source = GetCalibration().useTsc ? Source::Tsc : Source::Fallback;
+				s_source.store(source, std::memory_order_relaxed);
+				return source;
+			}
+
+			// Clock read by Now, cached so that reads skip the guarded calibration.
+			// Constant initialized, reads from static initializers of any module resolve it themselves
+			static inline std::atomic<Source> s_source{ Source::Unknown };
+		};
+	}
+}
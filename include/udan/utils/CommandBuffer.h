@@ -0,0 +1,481 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/CriticalSectionLock.h"
+#include "udan/utils/EntityRegistry.h"
+#include "udan/utils/LinearArena.h"
+#include "udan/utils/ScopeLock.h"
+#include "udan/utils/SparseSet.h"
+#include "udan/utils/ThreadPool.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		enum class CommandKind : uint8_t
+		{
+			ADD,
+			REMOVE,
+			DESTROY
+		};
+
+		template<typename Entity>
+		class CommandQueue;
+
+		/**
+		 * \brief Structural changes recorded for later: creations, component additions and removals, destructions.
+		 * Recording never touches the datasets, so it is safe while they are iterated. A buffer is written by a single thread,
+		 * CommandQueue hands one to every worker and applies them all at a sync point.
+		 * Components are moved into an arena owned by the buffer until applied.
+		 */
+		template<typename Entity>
+		class alignas(CacheLineSize) CommandBuffer
+		{
+		public:
+			/**
+			 * \brief Entity recorded by Create, the registry hands out its handle when the buffer is applied
+			 */
+			struct PendingEntity
+			{
+				uint32_t index;
+			};
+
+			CommandBuffer() = default;
+			CommandBuffer(const CommandBuffer&) = delete;
+			CommandBuffer& operator=(const CommandBuffer&) = delete;
+			CommandBuffer(CommandBuffer&&) noexcept = default;
+			CommandBuffer& operator=(CommandBuffer&&) noexcept = default;
+
+			~CommandBuffer()
+			{
+				Clear();
+			}
+
+			PendingEntity Create()
+			{
+				if (m_resolved)
+				{
+					m_created.clear();
+					m_resolved = false;
+				}
+				m_created.push_back(Entity(0));
+				return { static_cast<uint32_t>(m_created.size() - 1) };
+			}
+
+			/**
+			 * \brief Handle of an entity created by this buffer, valid once applied and until the buffer records a new Create
+			 */
+			Entity Resolve(PendingEntity pending) const
+			{
+				assert(m_resolved && pending.index < m_created.size());
+				return m_created[pending.index];
+			}
+
+			/**
+			 * \brief Free the slot of entity in the registry once every add and remove was applied, after removing its
+			 * components from the datasets registered with the queue (CommandQueue::Register).
+			 * Components in other datasets stay until a newer entity of the slot is inserted, which drops them
+			 */
+			void Destroy(Entity entity)
+			{
+				m_commands.push_back({ nullptr, nullptr, nullptr, entity, CommandKind::DESTROY, false });
+			}
+
+			void Destroy(PendingEntity entity)
+			{
+				m_commands.push_back({ nullptr, nullptr, nullptr, static_cast<Entity>(entity.index), CommandKind::DESTROY, true });
+			}
+
+			/**
+			 * \brief EmplaceBack of component into dataset, like EmplaceBack nothing happens if the entity already has one
+			 */
+			template<typename Dataset, typename Component>
+			void Add(Dataset& dataset, Entity entity, Component&& component)
+			{
+				RecordAdd(dataset, entity, false, std::forward<Component>(component));
+			}
+
+			template<typename Dataset, typename Component>
+			void Add(Dataset& dataset, PendingEntity entity, Component&& component)
+			{
+				RecordAdd(dataset, static_cast<Entity>(entity.index), true, std::forward<Component>(component));
+			}
+
+			/**
+			 * \brief RemoveComponent of entity from dataset
+			 */
+			template<typename Dataset>
+			void Remove(Dataset& dataset, Entity entity)
+			{
+				m_commands.push_back({ &SetOps<Dataset>::Table, &dataset, nullptr, entity, CommandKind::REMOVE, false });
+			}
+
+			template<typename Dataset>
+			void Remove(Dataset& dataset, PendingEntity entity)
+			{
+				m_commands.push_back({ &SetOps<Dataset>::Table, &dataset, nullptr, static_cast<Entity>(entity.index), CommandKind::REMOVE, true });
+			}
+
+			size_t GetCommandCount() const
+			{
+				return m_commands.size();
+			}
+
+			bool IsEmpty() const
+			{
+				return m_commands.empty() && (m_resolved || m_created.empty());
+			}
+
+			/**
+			 * \brief Drop every command without applying it
+			 */
+			void Clear()
+			{
+				for (const Command& command : m_commands)
+				{
+					if (command.payload != nullptr && command.ops->discard != nullptr)
+						command.ops->discard(command.payload);
+				}
+				Reset();
+				m_created.clear();
+				m_resolved = false;
+			}
+
+		private:
+			friend class CommandQueue<Entity>;
+
+			// Type erased operations on one dataset type, payloads are components of one type
+			struct OpsTable
+			{
+				void (*add)(void* dataset, Entity entity, void* payload);
+				void (*discard)(void* payload);
+				void (*reserve)(void* dataset, size_t extra);
+				void (*removeRange)(void* dataset, std::span<const Entity> entities);
+			};
+
+			template<typename Dataset>
+			struct SetOps
+			{
+				static void Reserve(void* dataset, size_t extra)
+				{
+					Dataset& set = *static_cast<Dataset*>(dataset);
+					if constexpr (requires { set.Reserve(extra); set.GetCapacity(); })
+						ReserveFor(set, set.GetSize() + extra);
+				}
+
+				static void RemoveRange(void* dataset, std::span<const Entity> entities)
+				{
+					Dataset& set = *static_cast<Dataset*>(dataset);
+					if constexpr (requires { set.RemoveRange(entities); })
+						set.RemoveRange(entities);
+					else
+					{
+						for (const Entity entity : entities)
+							set.RemoveComponent(entity);
+					}
+				}
+
+				static constexpr OpsTable Table = { nullptr, nullptr, &Reserve, &RemoveRange };
+			};
+
+			template<typename Dataset, typename Component>
+			struct Ops
+			{
+				static void Add(void* dataset, Entity entity, void* payload)
+				{
+					Component* component = static_cast<Component*>(payload);
+					static_cast<Dataset*>(dataset)->EmplaceBack(entity, std::move(*component));
+					std::destroy_at(component);
+				}
+
+				static void Discard(void* payload)
+				{
+					std::destroy_at(static_cast<Component*>(payload));
+				}
+
+				static constexpr OpsTable Table = {
+					&Add,
+					std::is_trivially_destructible_v<Component> ? nullptr : &Discard,
+					&SetOps<Dataset>::Reserve,
+					&SetOps<Dataset>::RemoveRange
+				};
+			};
+
+			struct Command
+			{
+				const OpsTable* ops;
+				void* dataset;
+				void* payload;
+				// Index of the PendingEntity when pending
+				Entity entity;
+				CommandKind kind;
+				bool pending;
+			};
+
+			template<typename Dataset, typename Component>
+			void RecordAdd(Dataset& dataset, Entity entity, bool pending, Component&& component)
+			{
+				using Stored = std::decay_t<Component>;
+				Stored* payload = m_arena.New<Stored>(std::forward<Component>(component));
+				m_commands.push_back({ &Ops<Dataset, Stored>::Table, &dataset, payload, entity, CommandKind::ADD, pending });
+			}
+
+			Entity Target(const Command& command) const
+			{
+				return command.pending ? m_created[command.entity] : command.entity;
+			}
+
+			// Commands were applied, keeps the resolved creations
+			void Reset()
+			{
+				m_commands.clear();
+				m_arena.Reset();
+			}
+
+			std::vector<Command> m_commands;
+			std::vector<Entity> m_created;
+			bool m_resolved = false;
+			LinearArena m_arena;
+		};
+
+		/**
+		 * \brief One CommandBuffer per recording thread, applied together at a sync point.
+		 * Apply groups the commands by dataset and, inside a dataset, orders them by entity, then buffer, then recording order.
+		 * Every dataset therefore receives its components in an order that does not depend on which worker recorded them,
+		 * as long as the commands of one entity are recorded by one buffer. Datasets are grown once per batch of additions
+		 * and removals go through RemoveRange. Destructions come last, creations first in buffer order.
+		 */
+		template<typename Entity>
+		class CommandQueue
+		{
+		public:
+			typedef typename CommandBuffer<Entity>::PendingEntity PendingEntity;
+
+			/**
+			 * \param bufferCount Buffers created up front, GetLocal adds one per thread past them
+			 */
+			explicit CommandQueue(size_t bufferCount) :
+				m_buffers(std::max<size_t>(bufferCount, 1)),
+				m_id(s_nextId.fetch_add(1, std::memory_order_relaxed))
+			{}
+
+			// Room for the workers and the thread waiting on them
+			explicit CommandQueue(const ThreadPool& pool) : CommandQueue(pool.GetThreadCount() + 1)
+			{}
+
+			CommandQueue(const CommandQueue&) = delete;
+			CommandQueue& operator=(const CommandQueue&) = delete;
+
+			/**
+			 * \brief Buffer owned by the calling thread, whichever pool it belongs to.
+			 * A thread takes the next free buffer on its first call, under a lock, later calls only read a thread local
+			 */
+			CommandBuffer<Entity>& GetLocal()
+			{
+				thread_local LocalBuffer s_local;
+				if (s_local.queue == this && s_local.id == m_id)
+					return *s_local.buffer;
+				ScopeLock<decltype(m_mtx)> lck(m_mtx);
+				const std::thread::id thread = std::this_thread::get_id();
+				const size_t index = std::find(m_owners.begin(), m_owners.end(), thread) - m_owners.begin();
+				if (index == m_owners.size())
+				{
+					m_owners.push_back(thread);
+					// Deque: growing keeps the buffers of the other threads in place
+					if (index == m_buffers.size())
+						m_buffers.emplace_back();
+				}
+				s_local = { this, m_id, &m_buffers[index] };
+				return m_buffers[index];
+			}
+
+			/**
+			 * \brief Components of entities destroyed through the queue are removed from dataset, which must outlive the queue
+			 */
+			template<typename Dataset>
+			void Register(Dataset& dataset)
+			{
+				m_datasets.push_back({ &dataset, &CommandBuffer<Entity>::template SetOps<Dataset>::Table });
+			}
+
+			/**
+			 * \brief For callers handing the buffers out themselves, not to be mixed with GetLocal
+			 */
+			CommandBuffer<Entity>& GetBuffer(size_t index)
+			{
+				return m_buffers[index];
+			}
+
+			size_t GetBufferCount() const
+			{
+				return m_buffers.size();
+			}
+
+			size_t GetCommandCount() const
+			{
+				size_t count = 0;
+				for (const CommandBuffer<Entity>& buffer : m_buffers)
+					count += buffer.GetCommandCount();
+				return count;
+			}
+
+			/**
+			 * \brief Apply and reset every buffer, no other thread may record meanwhile
+			 */
+			void Apply(EntityRegistry<Entity>& registry)
+			{
+				Apply(&registry);
+			}
+
+			/**
+			 * \brief Apply buffers holding neither Create nor Destroy
+			 */
+			void Apply()
+			{
+				Apply(nullptr);
+			}
+
+		private:
+			typedef typename CommandBuffer<Entity>::Command Command;
+			typedef typename CommandBuffer<Entity>::OpsTable OpsTable;
+
+			struct LocalBuffer
+			{
+				const CommandQueue* queue = nullptr;
+				uint64_t id = 0;
+				CommandBuffer<Entity>* buffer = nullptr;
+			};
+
+			struct RegisteredDataset
+			{
+				void* dataset;
+				const OpsTable* ops;
+			};
+
+			struct Entry
+			{
+				void* dataset;
+				Entity entity;
+				uint32_t buffer;
+				uint32_t sequence;
+				const Command* command;
+			};
+
+			void Apply(EntityRegistry<Entity>* registry)
+			{
+				for (CommandBuffer<Entity>& buffer : m_buffers)
+				{
+					if (buffer.m_resolved)
+						continue;
+					assert(registry != nullptr || buffer.m_created.empty());
+					for (Entity& entity : buffer.m_created)
+						entity = registry->Create();
+					buffer.m_resolved = true;
+				}
+
+				m_entries.clear();
+				m_entries.reserve(GetCommandCount());
+				for (size_t b = 0; b < m_buffers.size(); ++b)
+				{
+					const CommandBuffer<Entity>& buffer = m_buffers[b];
+					for (size_t i = 0; i < buffer.m_commands.size(); ++i)
+					{
+						const Command& command = buffer.m_commands[i];
+						m_entries.push_back({ command.dataset, buffer.Target(command), static_cast<uint32_t>(b), static_cast<uint32_t>(i), &command });
+					}
+				}
+				std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b)
+					{
+						if (a.dataset != b.dataset)
+						{
+							// Destructions have no dataset and sort first, they are applied last
+							if (a.dataset == nullptr || b.dataset == nullptr)
+								return a.dataset == nullptr;
+							// Unrelated objects, only std::less orders their addresses
+							return std::less<const void*>()(a.dataset, b.dataset);
+						}
+						return std::tie(a.entity, a.buffer, a.sequence) < std::tie(b.entity, b.buffer, b.sequence);
+					});
+
+				size_t destroyEnd = 0;
+				while (destroyEnd < m_entries.size() && m_entries[destroyEnd].dataset == nullptr)
+					++destroyEnd;
+				for (size_t begin = destroyEnd; begin < m_entries.size();)
+				{
+					// Run of one kind on one dataset
+					const Entry& first = m_entries[begin];
+					size_t end = begin + 1;
+					while (end < m_entries.size() && m_entries[end].dataset == first.dataset && m_entries[end].command->kind == first.command->kind)
+						++end;
+					ApplyRun(begin, end);
+					begin = end;
+				}
+				if (destroyEnd > 0)
+				{
+					assert(registry != nullptr);
+					m_removed.clear();
+					for (size_t i = 0; i < destroyEnd; ++i)
+					{
+						if (m_removed.empty() || m_removed.back() != m_entries[i].entity)
+							m_removed.push_back(m_entries[i].entity);
+					}
+					for (const RegisteredDataset& registered : m_datasets)
+						registered.ops->removeRange(registered.dataset, m_removed);
+					for (const Entity entity : m_removed)
+						registry->Destroy(entity);
+				}
+
+				for (CommandBuffer<Entity>& buffer : m_buffers)
+					buffer.Reset();
+			}
+
+			void ApplyRun(size_t begin, size_t end)
+			{
+				const Command& first = *m_entries[begin].command;
+				if (first.kind == CommandKind::ADD)
+				{
+					first.ops->reserve(first.dataset, end - begin);
+					for (size_t i = begin; i < end; ++i)
+					{
+						const Command& command = *m_entries[i].command;
+						command.ops->add(command.dataset, m_entries[i].entity, command.payload);
+					}
+					return;
+				}
+				m_removed.clear();
+				for (size_t i = begin; i < end; ++i)
+				{
+					// Sorted by entity, an entity removed twice is passed once
+					if (m_removed.empty() || m_removed.back() != m_entries[i].entity)
+						m_removed.push_back(m_entries[i].entity);
+				}
+				first.ops->removeRange(first.dataset, m_removed);
+			}
+
+			std::deque<CommandBuffer<Entity>> m_buffers;
+			// Thread owning each buffer handed out by GetLocal, in buffer order
+			std::vector<std::thread::id> m_owners;
+			CriticalSectionLock m_mtx;
+			std::vector<RegisteredDataset> m_datasets;
+			// Tells apart a queue from an older one allocated at the same address in the thread local cache
+			uint64_t m_id;
+			static inline std::atomic<uint64_t> s_nextId{ 1 };
+			// Scratch kept between applies
+			std::vector<Entry> m_entries;
+			std::vector<Entity> m_removed;
+		};
+	}
+}
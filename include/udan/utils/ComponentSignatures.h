@@ -0,0 +1,158 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/EntityTraits.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		typedef uint64_t ComponentMask;
+
+		/**
+		 * \brief Write to out the index of every mask containing all bits of query, in increasing order.
+		 * Scans 8 (AVX2) or 16 (AVX-512) masks per step, picked like FilterMembers
+		 * \param out Room for count indexes
+		 * \return Number of indexes written
+		 */
+		__declspec(dllexport) size_t ScanComponentMasks(const ComponentMask* masks, size_t count, ComponentMask query, uint32_t* out);
+
+		/**
+		 * \brief Per entity bitmask of the component sets holding it, one bit per bound set (64 at most).
+		 * Sets bound with Bind update it on every insert and remove, so "has A, B, C and D" is a single AND and compare.
+		 * Masks are kept per slot together with the handle that set them: a new handle in a slot starts from an empty mask.
+		 */
+		template<typename Entity>
+		class ComponentSignatures
+		{
+			typedef EntityTraits<Entity> Traits;
+
+		public:
+			static constexpr size_t MaxComponents = 64;
+
+			ComponentSignatures() = default;
+			ComponentSignatures(const ComponentSignatures&) = delete;
+			ComponentSignatures& operator=(const ComponentSignatures&) = delete;
+
+			/**
+			 * \brief Give set the next free bit and record the entities it already holds
+			 * \return Bit of the set
+			 * \throw std::length_error Past MaxComponents sets, in every build type
+			 */
+			template<typename Set>
+			ComponentMask Bind(Set& set)
+			{
+				if (m_boundCount >= MaxComponents)
+					throw std::length_error("ComponentSignatures bound more than MaxComponents sets");
+				const ComponentMask bit = ComponentMask(1) << m_boundCount++;
+				for (const Entity entity : set.Entities())
+					Add(entity, bit);
+				set.BindSignatures(this, bit);
+				return bit;
+			}
+
+			void Add(Entity entity, ComponentMask bits)
+			{
+				const Entity index = Traits::Index(entity);
+				if (index >= m_masks.size())
+				{
+					m_masks.resize(index + 1, 0);
+					m_handles.resize(index + 1, Traits::Null);
+				}
+				if (m_handles[index] != entity)
+				{
+					m_handles[index] = entity;
+					m_masks[index] = 0;
+				}
+				m_masks[index] |= bits;
+			}
+
+			void Remove(Entity entity, ComponentMask bits)
+			{
+				const Entity index = Traits::Index(entity);
+				if (index < m_masks.size() && m_handles[index] == entity)
+					m_masks[index] &= ~bits;
+			}
+
+			/**
+			 * \brief Forget every bit of entity, e.g. when it is destroyed
+			 */
+			void Clear(Entity entity)
+			{
+				const Entity index = Traits::Index(entity);
+				if (index < m_masks.size() && m_handles[index] == entity)
+					m_masks[index] = 0;
+			}
+
+			[[nodiscard]] ComponentMask Get(Entity entity) const
+			{
+				const Entity index = Traits::Index(entity);
+				return index < m_masks.size() && m_handles[index] == entity ? m_masks[index] : 0;
+			}
+
+			void Prefetch(Entity entity) const
+			{
+				const Entity index = Traits::Index(entity);
+				if (index < m_masks.size())
+				{
+					utils::Prefetch(m_masks.data() + index);
+					utils::Prefetch(m_handles.data() + index);
+				}
+			}
+
+			[[nodiscard]] bool Matches(Entity entity, ComponentMask query) const
+			{
+				return (Get(entity) & query) == query;
+			}
+
+			/**
+			 * \brief Every entity whose mask contains query, in slot order
+			 * \param query At least one bit, an empty query would match slots that never held an entity
+			 * \param out Room for GetSlotCount() entities
+			 */
+			size_t Scan(ComponentMask query, Entity* out) const
+			{
+				assert(query != 0);
+				if (query == 0)
+					return 0;
+				if constexpr (sizeof(Entity) == sizeof(uint32_t))
+				{
+					const size_t count = ScanComponentMasks(m_masks.data(), m_masks.size(), query, reinterpret_cast<uint32_t*>(out));
+					for (size_t i = 0; i < count; ++i)
+						out[i] = m_handles[out[i]];
+					return count;
+				}
+				else
+				{
+					size_t count = 0;
+					for (size_t i = 0; i < m_masks.size(); ++i)
+					{
+						if ((m_masks[i] & query) == query)
+							out[count++] = m_handles[i];
+					}
+					return count;
+				}
+			}
+
+			[[nodiscard]] std::span<const ComponentMask> GetMasks() const
+			{
+				return m_masks;
+			}
+
+			[[nodiscard]] size_t GetSlotCount() const
+			{
+				return m_masks.size();
+			}
+
+		private:
+			std::vector<ComponentMask> m_masks;
+			std::vector<Entity> m_handles;
+			size_t m_boundCount = 0;
+		};
+	}
+}
@@ -0,0 +1,358 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/CriticalSectionLock.h"
+#include "udan/utils/EntityTraits.h"
+#include "udan/utils/HugePages.h"
+#include "udan/utils/ScopeLock.h"
+#include "udan/utils/ThreadPool.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief DataSet any number of threads append to at once, without a lock.
+		 * An insert claims the sparse entry of the entity with a compare and swap, takes the next dense slot with a fetch add
+		 * then publishes the slot in the entry. The dense arrays only reserve address space for indexRange entries up front,
+		 * memory is committed in place as the set grows, doubling from 64 KiB, so they never relocate while other threads
+		 * write them. Committing takes a lock, the inserts reaching past the committed size wait for it.
+		 * Find and Exist may run during inserts and see every published entity. Everything else, views included,
+		 * must wait for a sync point after which no insert runs, e.g. the end of a ParallelFor.
+		 * Unlike DataSet an entity whose slot still holds a component of a destroyed entity is not inserted,
+		 * remove the stale component first.
+		 */
+		template<typename Entity, typename ComponentType>
+		class ConcurrentDataSet
+		{
+			typedef EntityTraits<Entity> Traits;
+
+		public:
+			using ValueType = ComponentType;
+
+			static constexpr size_t PageSize = 4096;
+			static constexpr size_t PageMask = PageSize - 1;
+			static constexpr size_t PageShift = std::countr_zero(PageSize);
+			// 16M indexes at most, the dense arrays reserve address space for the whole range
+			static constexpr size_t DefaultIndexRange = std::min<size_t>(size_t(Traits::IndexMask) + 1, size_t(1) << 24);
+
+			/**
+			 * \param indexRange Entity indexes are below it, it bounds the size of the set
+			 */
+			explicit ConcurrentDataSet(size_t indexRange = DefaultIndexRange) :
+				m_indexRange(indexRange),
+				m_pages(std::make_unique<std::atomic<Entity*>[]>((indexRange + PageMask) >> PageShift))
+			{
+				static_assert(alignof(ComponentType) <= HugePageSize);
+				m_dense = static_cast<Entity*>(ReserveAddressSpace(indexRange * sizeof(Entity)));
+				m_components = static_cast<ComponentType*>(ReserveAddressSpace(indexRange * sizeof(ComponentType)));
+				if (m_dense == nullptr || m_components == nullptr)
+				{
+					Release();
+					throw std::bad_alloc();
+				}
+			}
+
+			ConcurrentDataSet(const ConcurrentDataSet&) = delete;
+			ConcurrentDataSet& operator=(const ConcurrentDataSet&) = delete;
+
+			~ConcurrentDataSet()
+			{
+				std::destroy_n(m_components, GetSize());
+				Release();
+			}
+
+			/**
+			 * \brief Thread safe. Does nothing and returns false when the slot of id already holds a component
+			 * \throw std::bad_alloc when memory cannot be committed, the set can then only be destroyed
+			 */
+			template<typename ...Args>
+			bool EmplaceBack(Entity id, Args&& ...args)
+			{
+				if (!InRange(id))
+					return false;
+				std::atomic_ref<Entity> entry(AssureEntry(Traits::Index(id)));
+				if (!Claim(entry))
+					return false;
+				const size_t pos = m_size.fetch_add(1, std::memory_order_relaxed);
+				AssureCommitted(pos + 1);
+				Construct(pos, id, std::forward<Args>(args)...);
+				entry.store(static_cast<Entity>(pos), std::memory_order_release);
+				return true;
+			}
+
+			bool PushBack(Entity id, const ComponentType& component)
+			{
+				return EmplaceBack(id, component);
+			}
+
+			/**
+			 * \brief Thread safe. EmplaceBack of every entity with the component at the same position, the dense slots are
+			 * taken with a single fetch add so that threads inserting batches barely contend
+			 * \return Number of components inserted
+			 */
+			template<std::input_iterator ComponentIt>
+			size_t InsertRange(std::span<const Entity> entities, ComponentIt components)
+			{
+				ScratchScope scratch(ThreadPool::GetScratch());
+				std::pmr::vector<uint32_t> claimed(scratch.GetResource());
+				claimed.reserve(entities.size());
+				for (size_t i = 0; i < entities.size(); ++i)
+				{
+					if (!InRange(entities[i]))
+						continue;
+					std::atomic_ref<Entity> entry(AssureEntry(Traits::Index(entities[i])));
+					if (Claim(entry))
+						claimed.push_back(static_cast<uint32_t>(i));
+				}
+				size_t pos = m_size.fetch_add(claimed.size(), std::memory_order_relaxed);
+				AssureCommitted(pos + claimed.size());
+				size_t read = 0;
+				for (const uint32_t i : claimed)
+				{
+					std::advance(components, i - read);
+					read = i;
+					Construct(pos, entities[i], *components);
+					std::atomic_ref<Entity>(Entry(Traits::Index(entities[i]))).store(static_cast<Entity>(pos), std::memory_order_release);
+					++pos;
+				}
+				return claimed.size();
+			}
+
+			size_t InsertRange(std::span<const Entity> entities, std::span<const ComponentType> components)
+			{
+				assert(entities.size() == components.size());
+				return InsertRange(entities, components.begin());
+			}
+
+			/**
+			 * \brief Swap and pop like DataSet, not thread safe
+			 */
+			void RemoveComponent(Entity id)
+			{
+				const Entity pos = Find(id);
+				if (pos == NoEntity)
+					return;
+				const size_t last = GetSize() - 1;
+				if (pos != last)
+				{
+					m_components[pos] = std::move(m_components[last]);
+					m_dense[pos] = m_dense[last];
+					std::atomic_ref<Entity>(Entry(Traits::Index(m_dense[pos]))).store(pos, std::memory_order_relaxed);
+				}
+				std::destroy_at(m_components + last);
+				std::atomic_ref<Entity>(Entry(Traits::Index(id))).store(NoEntity, std::memory_order_relaxed);
+				m_size.store(last, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Not thread safe, the pages are kept
+			 */
+			void Clear()
+			{
+				const size_t size = GetSize();
+				for (size_t i = 0; i < size; ++i)
+					std::atomic_ref<Entity>(Entry(Traits::Index(m_dense[i]))).store(NoEntity, std::memory_order_relaxed);
+				std::destroy_n(m_components, size);
+				m_size.store(0, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Thread safe
+			 */
+			bool Exist(Entity id) const
+			{
+				return Find(id) != NoEntity;
+			}
+
+			/**
+			 * \brief Thread safe
+			 * \return Dense position of id, or the null entity when id is not in the set
+			 */
+			Entity Find(Entity id) const
+			{
+				const size_t index = Traits::Index(id);
+				if (index >= m_indexRange)
+					return NoEntity;
+				Entity* page = m_pages[index >> PageShift].load(std::memory_order_acquire);
+				if (page == nullptr)
+					return NoEntity;
+				// Claimed entries are never below the size
+				const Entity pos = std::atomic_ref<Entity>(page[index & PageMask]).load(std::memory_order_acquire);
+				return pos < GetSize() && m_dense[pos] == id ? pos : NoEntity;
+			}
+
+			void Prefetch(Entity id) const
+			{
+				const size_t index = Traits::Index(id);
+				if (index >= m_indexRange)
+					return;
+				if (const Entity* page = m_pages[index >> PageShift].load(std::memory_order_relaxed))
+					utils::Prefetch(page + (index & PageMask));
+			}
+
+			std::span<const Entity> Entities() const
+			{
+				return { m_dense, GetSize() };
+			}
+
+			size_t GetSize() const
+			{
+				return m_size.load(std::memory_order_relaxed);
+			}
+
+			size_t GetIndexRange() const
+			{
+				return m_indexRange;
+			}
+
+			ComponentType& GetComponent(Entity id)
+			{
+				return m_components[Find(id)];
+			}
+
+			const ComponentType& Peek(Entity id) const
+			{
+				return m_components[Find(id)];
+			}
+
+			Entity GetComponentId(Entity id)
+			{
+				return Find(id);
+			}
+
+			std::span<ComponentType> GetData()
+			{
+				return { m_components, GetSize() };
+			}
+
+			std::span<const ComponentType> GetComponents() const
+			{
+				return { m_components, GetSize() };
+			}
+
+			std::tuple<ComponentType&> GetDataAtIndex(size_t index)
+			{
+				return { m_components[index] };
+			}
+
+			std::tuple<const ComponentType&> PeekAtIndex(size_t index) const
+			{
+				return { m_components[index] };
+			}
+
+		private:
+			static constexpr Entity NoEntity = Traits::Null;
+			// Divides HugePageSize, commits never reach past the reservations
+			static constexpr size_t CommitGranularity = 64 * 1024;
+			// Entry taken by an insert that did not publish its slot yet
+			static constexpr Entity ClaimedEntry = Traits::Null - 1;
+
+			bool InRange(Entity id) const
+			{
+				assert(Traits::Index(id) < m_indexRange);
+				return Traits::Index(id) < m_indexRange;
+			}
+
+			static bool Claim(std::atomic_ref<Entity>& entry)
+			{
+				Entity expected = NoEntity;
+				return entry.compare_exchange_strong(expected, ClaimedEntry, std::memory_order_relaxed);
+			}
+
+			template<typename ...Args>
+			void Construct(size_t pos, Entity id, Args&& ...args)
+			{
+				if constexpr (std::is_aggregate_v<ComponentType>)
+					new (m_components + pos) ComponentType{ std::forward<Args>(args)... };
+				else
+					new (m_components + pos) ComponentType(std::forward<Args>(args)...);
+				m_dense[pos] = id;
+			}
+
+			// Commit the dense arrays for size entries
+			void AssureCommitted(size_t size)
+			{
+				if (size <= m_committed.load(std::memory_order_acquire))
+					return;
+				ScopeLock<CriticalSectionLock> lock(m_commitLock);
+				const size_t committed = m_committed.load(std::memory_order_relaxed);
+				if (size <= committed)
+					return;
+				const size_t target = std::min(std::max(size, committed * 2), m_indexRange);
+				const size_t denseEnd = CommitArray(m_dense, committed, target);
+				const size_t componentEnd = CommitArray(m_components, committed, target);
+				if (denseEnd == 0 || componentEnd == 0)
+					throw std::bad_alloc();
+				m_committed.store(std::min({ denseEnd / sizeof(Entity), componentEnd / sizeof(ComponentType), m_indexRange }),
+					std::memory_order_release);
+			}
+
+			// Commit whole granules of entries [from, to), the granule holding from may already be committed: committing it
+			// again keeps its content and does not disturb threads writing it
+			template<typename T>
+			static size_t CommitArray(T* array, size_t from, size_t to)
+			{
+				const size_t begin = from * sizeof(T) / CommitGranularity * CommitGranularity;
+				const size_t end = (to * sizeof(T) + CommitGranularity - 1) / CommitGranularity * CommitGranularity;
+				return CommitAddressSpace(reinterpret_cast<std::byte*>(array) + begin, end - begin) ? end : 0;
+			}
+
+			// Sparse entry of an index, the page is allocated by the first thread writing it
+			Entity& AssureEntry(size_t index)
+			{
+				assert(index < m_indexRange);
+				std::atomic<Entity*>& slot = m_pages[index >> PageShift];
+				Entity* page = slot.load(std::memory_order_acquire);
+				if (page == nullptr)
+				{
+					Entity* created = new Entity[PageSize];
+					std::fill_n(created, PageSize, NoEntity);
+					if (slot.compare_exchange_strong(page, created, std::memory_order_acq_rel, std::memory_order_acquire))
+						page = created;
+					else
+						delete[] created;
+				}
+				return page[index & PageMask];
+			}
+
+			// Sparse entry of an index already written
+			Entity& Entry(size_t index)
+			{
+				return m_pages[index >> PageShift].load(std::memory_order_relaxed)[index & PageMask];
+			}
+
+			void Release()
+			{
+				const size_t pageCount = (m_indexRange + PageMask) >> PageShift;
+				for (size_t i = 0; i < pageCount; ++i)
+					delete[] m_pages[i].load(std::memory_order_relaxed);
+				ReleaseAddressSpace(m_dense, m_indexRange * sizeof(Entity));
+				ReleaseAddressSpace(m_components, m_indexRange * sizeof(ComponentType));
+			}
+
+			Entity* m_dense = nullptr;
+			ComponentType* m_components = nullptr;
+			size_t m_indexRange;
+			std::unique_ptr<std::atomic<Entity*>[]> m_pages;
+			// Entries the dense arrays can hold without committing
+			std::atomic<size_t> m_committed{ 0 };
+			CriticalSectionLock m_commitLock;
+			// Hammered by every inserting thread, kept away from the read only members
+			alignas(CacheLineSize) std::atomic<size_t> m_size{ 0 };
+		};
+	}
+}
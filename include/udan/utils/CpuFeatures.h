@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UDAN_ARCH_X86 1
+#else
+#define UDAN_ARCH_X86 0
+#endif
+
+// 64 bit x86 only, for kernels gathering pointers
+#if defined(_M_X64) || defined(__x86_64__)
+#define UDAN_ARCH_X64 1
+#else
+#define UDAN_ARCH_X64 0
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Instruction set extensions usable by the running process (OS state saving included)
+		 */
+		struct CpuFeatures
+		{
+			bool invariantTsc = false;
+			bool sse41 = false;
+			bool avx2 = false;
+			bool avx512f = false;
+		};
+
+		/**
+		 * \brief Queried with cpuid once, then cached
+		 */
+		__declspec(dllexport) const CpuFeatures& GetCpuFeatures();
+	}
+}
@@ -0,0 +1,241 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief DataSet keeping two copies of every component so that readers never wait for writers.
+		 * During a frame Read returns the value the component had when the frame started and Write the value being
+		 * built for the next frame, in the other copy. SwapBuffers publishes every write at once in O(1).
+		 * A slot is only copied between the buffers the first time it is written in a frame, components nobody writes
+		 * cost nothing. Read and Write are safe from any thread as long as a component has a single writer per frame;
+		 * adding and removing components, SwapBuffers included, happen at sync points.
+		 */
+		template<typename Entity, typename ComponentType>
+		class DoubleBufferedDataSet : public SparseSet<Entity>
+		{
+		public:
+			using ValueType = ComponentType;
+
+			/**
+			 * \brief Read only side of the set with the interface views expect, every access returns the previous frame
+			 */
+			class Previous
+			{
+			public:
+				explicit Previous(const DoubleBufferedDataSet& set) : m_set(&set)
+				{}
+
+				const std::vector<Entity>& Entities() const
+				{
+					return m_set->Entities();
+				}
+
+				bool Exist(Entity id) const
+				{
+					return m_set->Exist(id);
+				}
+
+				Entity Find(Entity id) const
+				{
+					return m_set->Find(id);
+				}
+
+				void Prefetch(Entity id) const
+				{
+					m_set->Prefetch(id);
+				}
+
+				Entity GetComponentId(Entity id) const
+				{
+					return m_set->Find(id);
+				}
+
+				size_t GetSize() const
+				{
+					return m_set->GetSize();
+				}
+
+				std::tuple<const ComponentType&> GetDataAtIndex(size_t index) const
+				{
+					return { m_set->ReadAtIndex(index) };
+				}
+
+				std::tuple<const ComponentType&> PeekAtIndex(size_t index) const
+				{
+					return { m_set->ReadAtIndex(index) };
+				}
+
+			private:
+				const DoubleBufferedDataSet* m_set;
+			};
+
+			explicit DoubleBufferedDataSet(size_t capacity = 512) : SparseSet<Entity>(capacity)
+			{
+				Reserve(capacity);
+			}
+
+			template<typename ...Args>
+			void EmplaceBack(Entity id, Args&& ...args)
+			{
+				if (!PrepareInsert(id))
+					return;
+				if constexpr (std::is_aggregate_v<ComponentType>)
+					m_buffers[0].push_back(ComponentType{ std::forward<Args>(args)... });
+				else
+					m_buffers[0].emplace_back(std::forward<Args>(args)...);
+				m_buffers[1].push_back(m_buffers[0].back());
+				// Never written, both buffers hold the value
+				m_slots.push_back(0);
+				this->AppendDense(id);
+				this->NotifyConstruct(id);
+			}
+
+			void PushBack(Entity id, const ComponentType& component)
+			{
+				EmplaceBack(id, component);
+			}
+
+			void RemoveComponent(Entity id)
+			{
+				if (!this->Exist(id))
+					return;
+				this->NotifyDestroy(id);
+				const auto pos = this->EraseDense(id);
+				for (auto& buffer : m_buffers)
+				{
+					buffer[pos] = std::move(buffer.back());
+					buffer.pop_back();
+				}
+				m_slots[pos] = m_slots.back();
+				m_slots.pop_back();
+			}
+
+			void Clear()
+			{
+				if (this->m_observer != nullptr)
+				{
+					while (!this->m_dense.empty())
+						RemoveComponent(this->m_dense.back());
+					return;
+				}
+				this->ClearDense();
+				for (auto& buffer : m_buffers)
+					buffer.clear();
+				m_slots.clear();
+			}
+
+			void Reserve(size_t capacity)
+			{
+				this->m_dense.reserve(capacity);
+				for (auto& buffer : m_buffers)
+					buffer.reserve(capacity);
+				m_slots.reserve(capacity);
+			}
+
+			/**
+			 * \brief Publish the writes of the frame, they become what Read returns
+			 */
+			void SwapBuffers()
+			{
+				++m_frame;
+			}
+
+			/**
+			 * \brief Value of the component when the frame started
+			 */
+			const ComponentType& Read(Entity id) const
+			{
+				return ReadAtIndex(this->m_sparse[Traits::Index(id)]);
+			}
+
+			const ComponentType& ReadAtIndex(size_t index) const
+			{
+				const uint64_t slot = std::atomic_ref<uint64_t>(const_cast<uint64_t&>(m_slots[index])).load(std::memory_order_acquire);
+				// Written this frame: the value of the frame start is in the buffer the writer copied from
+				const uint64_t buffer = (slot >> 1) == m_frame ? (slot & 1) ^ 1 : slot & 1;
+				return m_buffers[buffer][index];
+			}
+
+			/**
+			 * \brief Value of the component for the next frame, holding the current value on the first call of a frame
+			 */
+			ComponentType& Write(Entity id)
+			{
+				return WriteAtIndex(this->m_sparse[Traits::Index(id)]);
+			}
+
+			ComponentType& WriteAtIndex(size_t index)
+			{
+				std::atomic_ref<uint64_t> slot(m_slots[index]);
+				const uint64_t current = slot.load(std::memory_order_relaxed);
+				const uint64_t latest = current & 1;
+				if ((current >> 1) == m_frame)
+					return m_buffers[latest][index];
+				// Readers keep using the latest buffer until the next swap, the copy goes to the other one
+				const uint64_t target = latest ^ 1;
+				m_buffers[target][index] = m_buffers[latest][index];
+				slot.store((m_frame << 1) | target, std::memory_order_release);
+				return m_buffers[target][index];
+			}
+
+			Entity GetComponentId(Entity id)
+			{
+				return this->m_sparse[Traits::Index(id)];
+			}
+
+			/**
+			 * \brief Write access, so that views over the set update the next frame
+			 */
+			std::tuple<ComponentType&> GetDataAtIndex(size_t index)
+			{
+				return { WriteAtIndex(index) };
+			}
+
+			std::tuple<const ComponentType&> PeekAtIndex(size_t index) const
+			{
+				return { ReadAtIndex(index) };
+			}
+
+			Previous GetPrevious() const
+			{
+				return Previous(*this);
+			}
+
+			uint64_t GetFrame() const
+			{
+				return m_frame;
+			}
+
+			size_t GetSize() const
+			{
+				return m_slots.size();
+			}
+
+		private:
+			typedef typename SparseSet<Entity>::Traits Traits;
+
+			bool PrepareInsert(Entity id)
+			{
+				return SparseSet<Entity>::PrepareInsert(id, [this](Entity stale) { RemoveComponent(stale); });
+			}
+
+			std::array<std::vector<ComponentType>, 2> m_buffers;
+			// Per component: frame of its last write (high bits) and buffer holding its latest value (low bit)
+			std::vector<uint64_t> m_slots;
+			// Starts past the frame of components never written
+			uint64_t m_frame = 1;
+		};
+	}
+}
@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include <cassert>
+#include <vector>
+#include "udan/utils/ComponentSignatures.h"
+#include "udan/utils/EntityTraits.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Hands out generational entity handles and recycles freed slots.
+		 * Free slots form an intrusive list threaded through the slot array itself: a free slot stores
+		 * the index of the next free slot together with the version its next owner will get.
+		 * Needs versioned handles, see VersionedEntityTraits to opt Entity in.
+		 */
+		template<typename Entity>
+		class EntityRegistry
+		{
+		public:
+			typedef EntityTraits<Entity> Traits;
+
+			explicit EntityRegistry(size_t capacity = 512)
+			{
+				// Checked on construction, CommandQueue::Apply() names the type without ever having a registry
+				static_assert(Traits::Versioned, "EntityRegistry hands out versioned handles, specialize EntityTraits<Entity> as VersionedEntityTraits<Entity>");
+				m_slots.reserve(capacity);
+			}
+
+			Entity Create()
+			{
+				if (m_freeHead != Traits::IndexMask)
+				{
+					const Entity index = m_freeHead;
+					const Entity slot = m_slots[index];
+					m_freeHead = Traits::Index(slot);
+					m_slots[index] = Traits::Make(index, Traits::Version(slot));
+					++m_alive;
+					return m_slots[index];
+				}
+				const auto index = static_cast<Entity>(m_slots.size());
+				// The last index is the end of the free list
+				assert(index < Traits::IndexMask);
+				m_slots.push_back(Traits::Make(index, 0));
+				++m_alive;
+				return m_slots.back();
+			}
+
+			/**
+			 * \brief Free the slot of entity, stale handles are ignored
+			 */
+			void Destroy(Entity entity)
+			{
+				if (!Valid(entity))
+					return;
+				const Entity index = Traits::Index(entity);
+				Entity version = (Traits::Version(entity) + 1) & Traits::VersionMask;
+				if (Traits::Make(index, version) == Traits::Null)
+					version = 0;
+				m_slots[index] = Traits::Make(m_freeHead, version);
+				m_freeHead = index;
+				--m_alive;
+				m_signatures.Clear(entity);
+			}
+
+			[[nodiscard]] bool Valid(Entity entity) const
+			{
+				const Entity index = Traits::Index(entity);
+				return index < m_slots.size() && m_slots[index] == entity;
+			}
+
+			/**
+			 * \brief Version the next entity created in this slot will get
+			 */
+			[[nodiscard]] Entity CurrentVersion(Entity index) const
+			{
+				return Traits::Version(m_slots[index]);
+			}
+
+			[[nodiscard]] size_t GetAliveCount() const
+			{
+				return m_alive;
+			}
+
+			/**
+			 * \brief Number of slots ever created, upper bound of every live index
+			 */
+			[[nodiscard]] size_t GetSlotCount() const
+			{
+				return m_slots.size();
+			}
+
+			template<typename Func>
+			void Each(Func func) const
+			{
+				for (size_t i = 0; i < m_slots.size(); ++i)
+				{
+					if (Traits::Index(m_slots[i]) == i)
+						func(m_slots[i]);
+				}
+			}
+
+			/**
+			 * \brief Component masks of the entities of this registry, bind sets to it to keep them up to date
+			 */
+			ComponentSignatures<Entity>& GetSignatures()
+			{
+				return m_signatures;
+			}
+
+			const ComponentSignatures<Entity>& GetSignatures() const
+			{
+				return m_signatures;
+			}
+
+			void Clear()
+			{
+				m_slots.clear();
+				m_freeHead = Traits::IndexMask;
+				m_alive = 0;
+			}
+
+		private:
+			std::vector<Entity> m_slots;
+			Entity m_freeHead = Traits::IndexMask;
+			size_t m_alive = 0;
+			ComponentSignatures<Entity> m_signatures;
+		};
+	}
+}
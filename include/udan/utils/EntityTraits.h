@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Versioned handles: a slot index (low bits) and a version (high bits).
+		 * The version is bumped every time the slot is freed so that handles kept after a destroy
+		 * no longer match the slot, and sets drop the component an older version of a slot left behind.
+		 * Indexes are limited to IndexBits (24 bits for 32 bit handles), handles must be built with Make.
+		 * Opt in per handle type where every header sees it, before the first use of the type:
+		 * template<> struct EntityTraits<uint32_t> : VersionedEntityTraits<uint32_t> {};
+		 */
+		template<typename Entity>
+		struct VersionedEntityTraits
+		{
+			static_assert(std::is_unsigned_v<Entity>, "Entity must be an unsigned integer");
+
+			static constexpr bool Versioned = true;
+			static constexpr uint32_t Bits = std::numeric_limits<Entity>::digits;
+			// 16M live entities for 32 bit handles, 4G for 64 bit handles
+			static constexpr uint32_t IndexBits = Bits == 64 ? 32 : (Bits == 32 ? 24 : Bits / 2);
+			static constexpr uint32_t VersionBits = Bits - IndexBits;
+			static constexpr Entity IndexMask = static_cast<Entity>((Entity(1) << IndexBits) - 1);
+			static constexpr Entity VersionMask = static_cast<Entity>((Entity(1) << VersionBits) - 1);
+			static constexpr Entity Null = std::numeric_limits<Entity>::max();
+
+			static constexpr Entity Index(Entity entity)
+			{
+				return entity & IndexMask;
+			}
+
+			static constexpr Entity Version(Entity entity)
+			{
+				return static_cast<Entity>(entity >> IndexBits) & VersionMask;
+			}
+
+			static constexpr Entity Make(Entity index, Entity version)
+			{
+				assert(index <= IndexMask && "Entity index out of the IndexBits range");
+				return static_cast<Entity>((index & IndexMask) | ((version & VersionMask) << IndexBits));
+			}
+
+			/**
+			 * \brief true when a is a later version of the slot than b.
+			 * Versions wrap around, a is later when it is less than half the version range ahead of b
+			 */
+			static constexpr bool IsNewer(Entity a, Entity b)
+			{
+				const Entity distance = static_cast<Entity>(Version(a) - Version(b)) & VersionMask;
+				return distance != 0 && distance <= VersionMask / 2;
+			}
+		};
+
+		/**
+		 * \brief Plain integer ids, the default: the whole value is the index, so every id has its own slot and
+		 * no id is ever read as a version of another. See VersionedEntityTraits for generational handles
+		 */
+		template<typename Entity>
+		struct EntityTraits
+		{
+			static_assert(std::is_unsigned_v<Entity>, "Entity must be an unsigned integer");
+
+			static constexpr bool Versioned = false;
+			static constexpr uint32_t Bits = std::numeric_limits<Entity>::digits;
+			static constexpr uint32_t IndexBits = Bits;
+			static constexpr uint32_t VersionBits = 0;
+			static constexpr Entity IndexMask = std::numeric_limits<Entity>::max();
+			static constexpr Entity VersionMask = 0;
+			// Also the largest index, never a valid id
+			static constexpr Entity Null = std::numeric_limits<Entity>::max();
+
+			static constexpr Entity Index(Entity entity)
+			{
+				return entity;
+			}
+
+			static constexpr Entity Version(Entity)
+			{
+				return 0;
+			}
+
+			static constexpr Entity Make(Entity index, Entity version)
+			{
+				assert(version == 0 && "Plain ids have no version");
+				(void)version;
+				return index;
+			}
+
+			static constexpr bool IsNewer(Entity, Entity)
+			{
+				return false;
+			}
+		};
+	}
+}
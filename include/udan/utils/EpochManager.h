@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "CacheLine.h"
+#include "SpinLock.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Epoch based memory reclamation (Keir Fraser's scheme) for lock free structures.
+		 * Readers pin the global epoch while they may hold pointers into a structure, writers retire
+		 * unlinked nodes instead of deleting them. A node retired during epoch e is freed once the global
+		 * epoch reached e + 2: no pinned thread can still reference it at that point.
+		 * Garbage is kept in per thread retire lists and collected every CollectThreshold retirements,
+		 * a thread that stays pinned forever prevents any reclamation.
+		 */
+		class EpochManager
+		{
+		public:
+			static constexpr size_t CollectThreshold = 64;
+
+			/**
+			 * \brief Process wide domain, every lock free structure of the library retires through it
+			 */
+			__declspec(dllexport) static EpochManager& Instance();
+
+			__declspec(dllexport) ~EpochManager();
+			EpochManager(const EpochManager&) = delete;
+			EpochManager& operator=(const EpochManager&) = delete;
+
+			/**
+			 * \brief Pin the calling thread to the current epoch, calls can be nested
+			 */
+			__declspec(dllexport) void Enter();
+			__declspec(dllexport) void Exit();
+
+			/**
+			 * \brief Defer deleter(ptr) until no pinned thread can reference ptr
+			 */
+			__declspec(dllexport) void Retire(void* ptr, void (*deleter)(void*));
+
+			template<typename T>
+			void Retire(T* ptr)
+			{
+				Retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+			}
+
+			/**
+			 * \brief Advance the global epoch if every pinned thread observed the current one
+			 */
+			__declspec(dllexport) bool TryAdvance();
+
+			/**
+			 * \brief Try to advance then free the garbage of the calling thread that became unreachable
+			 */
+			__declspec(dllexport) void Collect();
+
+			/**
+			 * \brief Number of retired pointers of the calling thread waiting to be freed
+			 */
+			__declspec(dllexport) size_t GetPendingCount();
+
+			[[nodiscard]] uint64_t GetEpoch() const
+			{
+				return m_epoch.load(std::memory_order_acquire);
+			}
+
+		private:
+			struct Retired
+			{
+				void* ptr;
+				void (*deleter)(void*);
+				uint64_t epoch;
+			};
+
+			struct ThreadRecord
+			{
+				// (epoch << 1) | pinned
+				alignas(CacheLineSize) std::atomic<uint64_t> state{ 0 };
+				std::atomic<bool> inUse{ false };
+				uint32_t nesting = 0;
+				std::vector<Retired> retired;
+				ThreadRecord* next = nullptr;
+			};
+
+			struct LocalRecord
+			{
+				ThreadRecord* record = nullptr;
+				~LocalRecord();
+			};
+
+			EpochManager() = default;
+			ThreadRecord* Local();
+			ThreadRecord* AcquireRecord();
+			void ReleaseRecord(ThreadRecord* record);
+			static void FreeExpired(std::vector<Retired>& retired, uint64_t epoch);
+
+			alignas(CacheLineSize) std::atomic<uint64_t> m_epoch{ 0 };
+			alignas(CacheLineSize) std::atomic<ThreadRecord*> m_records{ nullptr };
+			SpinLock m_orphansLock;
+			std::vector<Retired> m_orphans;
+
+			static thread_local LocalRecord s_local;
+		};
+
+		/**
+		 * \brief Keeps the calling thread pinned for the lifetime of the scope.
+		 * Scope it to the reads of protected data, a guard held across a blocking call stalls reclamation everywhere
+		 */
+		class EpochGuard
+		{
+		public:
+			explicit EpochGuard(EpochManager& manager = EpochManager::Instance()) : m_manager(manager)
+			{
+				m_manager.Enter();
+			}
+
+			~EpochGuard()
+			{
+				m_manager.Exit();
+			}
+
+			EpochGuard(const EpochGuard&) = delete;
+			EpochGuard& operator=(const EpochGuard&) = delete;
+
+		private:
+			EpochManager& m_manager;
+		};
+	}
+}
@@ -1,38 +1,66 @@
 ﻿#pragma once
+#include <atomic>
 #include <functional>
+#include <vector>
+
+#include "EpochManager.h"
+#include "ScopeLock.h"
+#include "SpinLock.h"
 
 namespace udan
 {
 	namespace utils
 	{
+		/**
+		 * \brief Observers are stored in an immutable list replaced on Register (copy on write).
+		 * Invoke only pins the epoch and walks the current list, so it never blocks and can run while
+		 * another thread registers, the replaced list is reclaimed through the EpochManager.
+		 */
 		template<typename ... Args>
 		class Event
 		{
+			using ObserverList = std::vector<std::function<void(Args...)>>;
+
 		public:
+			Event() = default;
+			Event(const Event&) = delete;
+			Event& operator=(const Event&) = delete;
+
 			void Invoke(Args&... args)
 			{
-				for (auto& func : m_observers)
+				if (m_observers.load(std::memory_order_relaxed) == nullptr)
+					return;
+				EpochGuard guard;
+				const ObserverList* observers = m_observers.load(std::memory_order_acquire);
+				for (auto& func : *observers)
 					func(std::forward<Args>(args)...);
 			}
 
 			void Register(const std::function<void(Args...)>& func)
 			{
-				m_observers.emplace_back(func);
+				ScopeLock<decltype(m_writeLock)> lck(m_writeLock);
+				const ObserverList* current = m_observers.load(std::memory_order_relaxed);
+				auto* observers = current != nullptr ? new ObserverList(*current) : new ObserverList();
+				observers->emplace_back(func);
+				m_observers.store(observers, std::memory_order_release);
+				if (current != nullptr)
+					EpochManager::Instance().Retire(const_cast<ObserverList*>(current));
 			}
 
 			Event& operator+=(const std::function<void(Args...)>& func)
 			{
-				m_observers.emplace_back(func);
+				Register(func);
 				return *this;
 			}
 
 			~Event()
 			{
-				m_observers.clear();
+				delete m_observers.load(std::memory_order_acquire);
 			}
 
 		private:
-			std::vector<std::function<void(Args...)>> m_observers;
+			std::atomic<const ObserverList*> m_observers{ nullptr };
+			SpinLock m_writeLock;
 		};
 	}
 }
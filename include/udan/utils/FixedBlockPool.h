@@ -0,0 +1,155 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Hands out blocks of one size carved from chunks, freed blocks are recycled through an intrusive free list.
+		 * Allocation and release are a couple of loads and stores, memory goes back to the system with the pool.
+		 * Not thread safe, give every thread its own pool
+		 */
+		class FixedBlockPool
+		{
+		public:
+			static constexpr size_t Alignment = alignof(std::max_align_t);
+
+			explicit FixedBlockPool(size_t blockSize, size_t blocksPerChunk = 256) :
+				m_blockSize((std::max(blockSize, sizeof(FreeBlock)) + Alignment - 1) & ~(Alignment - 1)),
+				m_blocksPerChunk(std::max<size_t>(blocksPerChunk, 1))
+			{}
+
+			FixedBlockPool(const FixedBlockPool&) = delete;
+			FixedBlockPool& operator=(const FixedBlockPool&) = delete;
+
+			~FixedBlockPool()
+			{
+				assert(m_liveCount == 0);
+				for (std::byte* chunk : m_chunks)
+					::operator delete(chunk, std::align_val_t(Alignment));
+			}
+
+			void* Allocate()
+			{
+				if (m_free == nullptr)
+					AddChunk();
+				FreeBlock* block = m_free;
+				m_free = block->next;
+				++m_liveCount;
+				return block;
+			}
+
+			void Deallocate(void* pointer)
+			{
+				FreeBlock* block = static_cast<FreeBlock*>(pointer);
+				block->next = m_free;
+				m_free = block;
+				--m_liveCount;
+			}
+
+			[[nodiscard]] size_t GetBlockSize() const
+			{
+				return m_blockSize;
+			}
+
+			[[nodiscard]] size_t GetLiveCount() const
+			{
+				return m_liveCount;
+			}
+
+			[[nodiscard]] size_t GetCapacity() const
+			{
+				return m_chunks.size() * m_blocksPerChunk;
+			}
+
+		private:
+			struct FreeBlock
+			{
+				FreeBlock* next;
+			};
+
+			void AddChunk()
+			{
+				std::byte* chunk = static_cast<std::byte*>(::operator new(m_blockSize * m_blocksPerChunk, std::align_val_t(Alignment)));
+				m_chunks.push_back(chunk);
+				// Threaded back to front so that blocks are handed out in address order
+				for (size_t i = m_blocksPerChunk; i-- > 0;)
+				{
+					FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * m_blockSize);
+					block->next = m_free;
+					m_free = block;
+				}
+			}
+
+			size_t m_blockSize;
+			size_t m_blocksPerChunk;
+			std::vector<std::byte*> m_chunks;
+			FreeBlock* m_free = nullptr;
+			size_t m_liveCount = 0;
+		};
+
+		/**
+		 * \brief Standard allocator serving allocations that fit a block from a FixedBlockPool, the others from the heap.
+		 * Suits node based containers, every node is one block
+		 */
+		template<typename T>
+		class PoolAllocator
+		{
+		public:
+			typedef T value_type;
+
+			explicit PoolAllocator(FixedBlockPool& pool) noexcept : m_pool(&pool)
+			{}
+
+			template<typename U>
+			PoolAllocator(const PoolAllocator<U>& other) noexcept : m_pool(other.GetPool())
+			{}
+
+			T* allocate(size_t count)
+			{
+				if (Fits(count))
+					return static_cast<T*>(m_pool->Allocate());
+				return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T))));
+			}
+
+			void deallocate(T* pointer, size_t count) noexcept
+			{
+				if (Fits(count))
+					m_pool->Deallocate(pointer);
+				else
+					::operator delete(pointer, count * sizeof(T), std::align_val_t(alignof(T)));
+			}
+
+			FixedBlockPool* GetPool() const noexcept
+			{
+				return m_pool;
+			}
+
+			template<typename U>
+			bool operator==(const PoolAllocator<U>& other) const noexcept
+			{
+				return m_pool == other.GetPool();
+			}
+
+			template<typename U>
+			bool operator!=(const PoolAllocator<U>& other) const noexcept
+			{
+				return m_pool != other.GetPool();
+			}
+
+		private:
+			bool Fits(size_t count) const
+			{
+				return count * sizeof(T) <= m_pool->GetBlockSize() && alignof(T) <= FixedBlockPool::Alignment;
+			}
+
+			FixedBlockPool* m_pool;
+		};
+	}
+}
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace udan
+{
+	namespace utils
+	{
+		constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+		/**
+		 * \brief Map bytes rounded up to HugePageSize of zeroed memory, usable at once.
+		 * Tries explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES), taken from the system as a whole when mapped,
+		 * then falls back to regular pages backed when first written, advised as transparent huge pages on Linux.
+		 * Windows still charges regular pages against the commit limit up front, use ReserveAddressSpace to commit on demand
+		 * \return nullptr when nothing could be mapped
+		 */
+		__declspec(dllexport) void* AllocateHugePages(size_t bytes);
+		/**
+		 * \param bytes Size given to AllocateHugePages
+		 */
+		__declspec(dllexport) void FreeHugePages(void* pointer, size_t bytes);
+
+		/**
+		 * \brief Reserve bytes rounded up to HugePageSize of address space aligned on a huge page, nothing is committed.
+		 * Ranges must be committed with CommitAddressSpace before they are accessed
+		 * \return nullptr when the address space could not be reserved
+		 */
+		__declspec(dllexport) void* ReserveAddressSpace(size_t bytes);
+		/**
+		 * \brief Make a range of a reservation readable and writable, zeroed and backed by physical pages when first written.
+		 * Ranges spanning whole huge pages may be backed by transparent huge pages
+		 * \return false when the system is out of memory
+		 */
+		__declspec(dllexport) bool CommitAddressSpace(void* pointer, size_t bytes);
+		/**
+		 * \param bytes Size given to ReserveAddressSpace
+		 */
+		__declspec(dllexport) void ReleaseAddressSpace(void* pointer, size_t bytes);
+
+		/**
+		 * \brief Standard allocator mapping large arrays on huge pages, fewer page faults and TLB misses while walking them.
+		 * Arrays below half a huge page come from the regular heap
+		 */
+		template<typename T>
+		class HugePageAllocator
+		{
+		public:
+			typedef T value_type;
+
+			static constexpr size_t MinimumBytes = HugePageSize / 2;
+
+			HugePageAllocator() noexcept = default;
+
+			template<typename U>
+			HugePageAllocator(const HugePageAllocator<U>&) noexcept
+			{}
+
+			T* allocate(size_t count)
+			{
+				const size_t bytes = count * sizeof(T);
+				if (bytes < MinimumBytes)
+					return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T))));
+				void* pointer = AllocateHugePages(bytes);
+				if (pointer == nullptr)
+					throw std::bad_alloc();
+				return static_cast<T*>(pointer);
+			}
+
+			void deallocate(T* pointer, size_t count) noexcept
+			{
+				const size_t bytes = count * sizeof(T);
+				if (bytes < MinimumBytes)
+					::operator delete(pointer, bytes, std::align_val_t(alignof(T)));
+				else
+					FreeHugePages(pointer, bytes);
+			}
+
+			template<typename U>
+			bool operator==(const HugePageAllocator<U>&) const noexcept
+			{
+				return true;
+			}
+
+			template<typename U>
+			bool operator!=(const HugePageAllocator<U>&) const noexcept
+			{
+				return false;
+			}
+		};
+	}
+}
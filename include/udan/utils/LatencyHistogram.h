@@ -0,0 +1,261 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CacheLine.h"
+#include "Clock.h"
+#include "udan/debug/uLogger.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Fixed size log bucketed histogram of durations in Clock ticks (HdrHistogram layout).
+		 * Values are grouped by power of two, each power is split into 2^SubBucketBits linear sub buckets,
+		 * so any recorded value is known within 1 / 2^SubBucketBits (~3%).
+		 */
+		class LatencyHistogram
+		{
+		public:
+			static constexpr uint32_t SubBucketBits = 5;
+			static constexpr uint32_t SubBucketCount = 1u << SubBucketBits;
+			// Values above 2^MaxValueBits ticks (~30 minutes at 2.5GHz) are clamped
+			static constexpr uint32_t MaxValueBits = 42;
+			static constexpr uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+			static constexpr Clock::Ticks MaxValue = (Clock::Ticks(1) << MaxValueBits) - 1;
+
+			static uint32_t IndexOf(Clock::Ticks value)
+			{
+				value = std::min(value, MaxValue);
+				if (value < SubBucketCount)
+					return static_cast<uint32_t>(value);
+				const uint32_t msb = 63 - static_cast<uint32_t>(std::countl_zero(value));
+				const uint32_t shift = msb - SubBucketBits;
+				return ((shift + 1) << SubBucketBits) + static_cast<uint32_t>((value >> shift) & (SubBucketCount - 1));
+			}
+
+			/**
+			 * \brief Highest value mapped to the bucket at index
+			 */
+			static Clock::Ticks UpperBoundOf(uint32_t index)
+			{
+				const uint32_t bucket = index >> SubBucketBits;
+				const Clock::Ticks sub = index & (SubBucketCount - 1);
+				if (bucket == 0)
+					return sub;
+				const uint32_t shift = bucket - 1;
+				return ((SubBucketCount + sub) << shift) + ((Clock::Ticks(1) << shift) - 1);
+			}
+
+			void Record(Clock::Ticks value)
+			{
+				RecordCount(IndexOf(value), 1, value);
+			}
+
+			void Merge(const LatencyHistogram& other)
+			{
+				for (uint32_t i = 0; i < BucketCount; ++i)
+					m_counts[i] += other.m_counts[i];
+				m_total += other.m_total;
+				m_sum += other.m_sum;
+				m_min = std::min(m_min, other.m_min);
+				m_max = std::max(m_max, other.m_max);
+			}
+
+			void Reset()
+			{
+				m_counts.fill(0);
+				m_total = 0;
+				m_sum = 0;
+				m_min = UINT64_MAX;
+				m_max = 0;
+			}
+
+			/**
+			 * \param percentile In [0, 100]
+			 * \return Upper bound of the bucket holding the percentile, in ticks
+			 */
+			[[nodiscard]] Clock::Ticks Percentile(double percentile) const
+			{
+				if (m_total == 0)
+					return 0;
+				const double clamped = std::clamp(percentile, 0.0, 100.0);
+				auto rank = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(m_total) + 0.5);
+				rank = std::clamp<uint64_t>(rank, 1, m_total);
+				uint64_t seen = 0;
+				for (uint32_t i = 0; i < BucketCount; ++i)
+				{
+					seen += m_counts[i];
+					if (seen >= rank)
+						return std::clamp(UpperBoundOf(i), m_min, m_max);
+				}
+				return m_max;
+			}
+
+			[[nodiscard]] uint64_t Count() const
+			{
+				return m_total;
+			}
+
+			[[nodiscard]] Clock::Ticks Min() const
+			{
+				return m_total == 0 ? 0 : m_min;
+			}
+
+			[[nodiscard]] Clock::Ticks Max() const
+			{
+				return m_max;
+			}
+
+			[[nodiscard]] double Mean() const
+			{
+				return m_total == 0 ? 0.0 : static_cast<double>(m_sum) / static_cast<double>(m_total);
+			}
+
+			/**
+			 * \brief "count p50 p99 p99.9 max" in microseconds
+			 */
+			[[nodiscard]] std::string Summary() const
+			{
+				return fmt::format("count={} p50={:.2f}us p99={:.2f}us p99.9={:.2f}us max={:.2f}us",
+					m_total,
+					Clock::ToSeconds(Percentile(50.0)) * 1e6,
+					Clock::ToSeconds(Percentile(99.0)) * 1e6,
+					Clock::ToSeconds(Percentile(99.9)) * 1e6,
+					Clock::ToSeconds(Max()) * 1e6);
+			}
+
+		private:
+			friend class ConcurrentLatencyHistogram;
+
+			void RecordCount(uint32_t index, uint64_t count, Clock::Ticks value)
+			{
+				m_counts[index] += count;
+				m_total += count;
+				m_sum += value * count;
+				m_min = std::min(m_min, value);
+				m_max = std::max(m_max, value);
+			}
+
+			std::array<uint64_t, BucketCount> m_counts{};
+			uint64_t m_total = 0;
+			uint64_t m_sum = 0;
+			Clock::Ticks m_min = UINT64_MAX;
+			Clock::Ticks m_max = 0;
+		};
+
+		/**
+		 * \brief LatencyHistogram that any thread can record into without locking, Snapshot merges the shards.
+		 * Record(value) maps each thread round robin onto a shared shard of relaxed atomic counters, threads may share one.
+		 * Record(value, shard) writes a shard the caller owns, e.g. one per pool worker, and never contends
+		 */
+		class ConcurrentLatencyHistogram
+		{
+		public:
+			static constexpr uint32_t ShardCount = 8;
+
+			explicit ConcurrentLatencyHistogram(size_t shardCount = ShardCount) :
+				m_shards(std::make_unique<Shard[]>(std::max<size_t>(shardCount, 1))),
+				m_shardCount(std::max<size_t>(shardCount, 1))
+			{}
+
+			ConcurrentLatencyHistogram(const ConcurrentLatencyHistogram&) = delete;
+			ConcurrentLatencyHistogram& operator=(const ConcurrentLatencyHistogram&) = delete;
+
+			void Record(Clock::Ticks value)
+			{
+				Record(value, ShardIndex() % m_shardCount);
+			}
+
+			/**
+			 * \param shard Below GetShardCount()
+			 */
+			void Record(Clock::Ticks value, size_t shard)
+			{
+				assert(shard < m_shardCount);
+				Record(m_shards[shard], value);
+			}
+
+			[[nodiscard]] size_t GetShardCount() const
+			{
+				return m_shardCount;
+			}
+
+			/**
+			 * \brief Consistent per bucket, records running concurrently may be partially included
+			 */
+			[[nodiscard]] LatencyHistogram Snapshot() const
+			{
+				LatencyHistogram histogram;
+				for (size_t s = 0; s < m_shardCount; ++s)
+				{
+					const Shard& shard = m_shards[s];
+					for (uint32_t i = 0; i < LatencyHistogram::BucketCount; ++i)
+					{
+						const uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+						histogram.m_counts[i] += count;
+						histogram.m_total += count;
+					}
+					histogram.m_sum += shard.sum.load(std::memory_order_relaxed);
+					histogram.m_min = std::min(histogram.m_min, shard.min.load(std::memory_order_relaxed));
+					histogram.m_max = std::max(histogram.m_max, shard.max.load(std::memory_order_relaxed));
+				}
+				return histogram;
+			}
+
+			void Reset()
+			{
+				for (size_t s = 0; s < m_shardCount; ++s)
+				{
+					Shard& shard = m_shards[s];
+					for (auto& count : shard.counts)
+						count.store(0, std::memory_order_relaxed);
+					shard.sum.store(0, std::memory_order_relaxed);
+					shard.min.store(UINT64_MAX, std::memory_order_relaxed);
+					shard.max.store(0, std::memory_order_relaxed);
+				}
+			}
+
+		private:
+			struct alignas(CacheLineSize) Shard
+			{
+				std::atomic<uint64_t> counts[LatencyHistogram::BucketCount]{};
+				std::atomic<uint64_t> sum{ 0 };
+				std::atomic<Clock::Ticks> min{ UINT64_MAX };
+				std::atomic<Clock::Ticks> max{ 0 };
+			};
+
+			static void Record(Shard& shard, Clock::Ticks value)
+			{
+				shard.counts[LatencyHistogram::IndexOf(value)].fetch_add(1, std::memory_order_relaxed);
+				shard.sum.fetch_add(value, std::memory_order_relaxed);
+				Clock::Ticks current = shard.max.load(std::memory_order_relaxed);
+				while (value > current && !shard.max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+				{
+				}
+				current = shard.min.load(std::memory_order_relaxed);
+				while (value < current && !shard.min.compare_exchange_weak(current, value, std::memory_order_relaxed))
+				{
+				}
+			}
+
+			static uint32_t ShardIndex()
+			{
+				static std::atomic<uint32_t> s_nextThread{ 0 };
+				thread_local const uint32_t index = s_nextThread.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+				return index;
+			}
+
+			std::unique_ptr<Shard[]> m_shards;
+			size_t m_shardCount;
+		};
+	}
+}
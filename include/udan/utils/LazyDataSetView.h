@@ -0,0 +1,242 @@
+﻿#pragma once
+
+#include <array>
+#include <cassert>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "udan/utils/ParallelFor.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief View over the entities present in every dataset, resolved while iterating.
+		 * Walks the dense entities of the smallest dataset and looks the others up inline, so building the view
+		 * and iterating it never allocate. The smallest dataset is picked again each time a walk starts (begin, Each,
+		 * ParallelEach), so a view may be kept across structural changes, but datasets must not gain or lose components
+		 * while an iterator is live.
+		 * Iterators dereference to a tuple of component references: for (auto [a, b] : view)
+		 * Datasets given as const (LazyDataSetView<Entity, const A, B>) are read only and never stamped as changed.
+		 */
+		template<typename Entity, typename ...Datasets>
+		class LazyDataSetView
+		{
+			static constexpr size_t DatasetCount = sizeof...(Datasets);
+			// Sparse entries of this many entities ahead are prefetched
+			static constexpr size_t PrefetchDistance = 16;
+			static constexpr Entity NoEntity = PagedSparseArray<Entity>::Null;
+
+			using Indices = std::index_sequence_for<Datasets...>;
+			using Positions = std::array<Entity, DatasetCount>;
+
+			// Dense entities of the smallest dataset, the ones a walk iterates
+			struct Driver
+			{
+				size_t index = 0;
+				const Entity* entities = nullptr;
+				size_t count = 0;
+			};
+
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = decltype(std::tuple_cat(utils::GetDataAtIndex(std::declval<Datasets&>(), 0)...));
+				using reference = value_type;
+				using pointer = void;
+
+				Iterator() = default;
+
+				Iterator(const LazyDataSetView* view, const Driver& driver, size_t index) : m_view(view), m_driver(driver), m_index(index)
+				{
+					Settle();
+				}
+
+				value_type operator*() const
+				{
+					return m_view->Fetch(m_positions, Indices{});
+				}
+
+				Entity GetEntity() const
+				{
+					return m_driver.entities[m_index];
+				}
+
+				Iterator& operator++()
+				{
+					++m_index;
+					Settle();
+					return *this;
+				}
+
+				Iterator operator++(int)
+				{
+					Iterator tmp = *this;
+					++*this;
+					return tmp;
+				}
+
+				bool operator==(const Iterator& other) const
+				{
+					return m_index == other.m_index;
+				}
+
+				bool operator!=(const Iterator& other) const
+				{
+					return !(*this == other);
+				}
+
+			private:
+				void Settle()
+				{
+					while (m_index < m_driver.count && !m_view->Probe(m_driver, m_index, m_positions))
+						++m_index;
+				}
+
+				const LazyDataSetView* m_view = nullptr;
+				Driver m_driver;
+				size_t m_index = 0;
+				Positions m_positions{};
+			};
+
+			explicit LazyDataSetView(Datasets& ...datasets) : m_datasets(datasets...)
+			{}
+
+			/**
+			 * \brief Candidates are first tested against the component masks, a miss costs one load whatever the dataset count.
+			 * Every dataset must be bound to signatures
+			 */
+			LazyDataSetView(const ComponentSignatures<Entity>& signatures, Datasets& ...datasets) : LazyDataSetView(datasets...)
+			{
+				assert(((datasets.GetSignatures() == &signatures) && ...));
+				m_signatures = &signatures;
+				m_query = (datasets.GetSignatureBit() | ...);
+			}
+
+			Iterator begin() const
+			{
+				return Iterator(this, ResolveDriver(), 0);
+			}
+
+			Iterator end() const
+			{
+				const Driver driver = ResolveDriver();
+				return Iterator(this, driver, driver.count);
+			}
+
+			/**
+			 * \brief Call func(components&...) or func(entity, components&...) for every match
+			 */
+			template<typename Func>
+			void Each(Func func) const
+			{
+				const Driver driver = ResolveDriver();
+				EachInRange(func, driver, 0, driver.count);
+			}
+
+			/**
+			 * \brief Each split in chunks of grain walked entities run on the pool, returns once every chunk ran.
+			 * func runs concurrently on distinct entities. Datasets with ChangeTracking must be given as const,
+			 * writes would stamp them from several threads
+			 */
+			template<typename Func>
+			void ParallelEach(ThreadPool& threadPool, const Func& func, size_t grain = 1024) const
+			{
+				static_assert(!(StampsChanges<Datasets> || ...), "ParallelEach cannot stamp changes concurrently, view tracked datasets as const or use Each");
+				const Driver driver = ResolveDriver();
+				ParallelFor(threadPool, driver.count, grain, [this, &func, &driver](size_t begin, size_t end)
+					{
+						EachInRange(func, driver, begin, end);
+					});
+			}
+
+			/**
+			 * \brief Number of entities walked, an upper bound of the match count
+			 */
+			size_t GetSize() const
+			{
+				return ResolveDriver().count;
+			}
+
+		private:
+			// Picked per walk rather than once, sizes and dense arrays change as components are added or removed
+			Driver ResolveDriver() const
+			{
+				const std::array<size_t, DatasetCount> sizes = std::apply([](const auto& ...datasets)
+					{
+						return std::array<size_t, DatasetCount>{ datasets.GetSize()... };
+					}, m_datasets);
+				Driver driver;
+				for (size_t i = 1; i < DatasetCount; ++i)
+				{
+					if (sizes[i] < sizes[driver.index])
+						driver.index = i;
+				}
+				const std::span<const Entity> entities = RuntimeGet<Entity>(m_datasets, driver.index);
+				driver.entities = entities.data();
+				driver.count = entities.size();
+				return driver;
+			}
+
+			template<typename Func>
+			void EachInRange(Func& func, const Driver& driver, size_t begin, size_t end) const
+			{
+				Positions positions;
+				for (size_t i = begin; i < end; ++i)
+				{
+					if (Probe(driver, i, positions))
+						InvokeWithComponents(func, driver.entities[i], Fetch(positions, Indices{}));
+				}
+			}
+
+			bool Probe(const Driver& driver, size_t index, Positions& positions) const
+			{
+				const Entity* const entities = driver.entities;
+				if (m_signatures != nullptr)
+				{
+					// The mask is needed first, fetched twice as far ahead as the sparse entries
+					if (index + 2 * PrefetchDistance < driver.count)
+						m_signatures->Prefetch(entities[index + 2 * PrefetchDistance]);
+					if (index + PrefetchDistance < driver.count && m_signatures->Matches(entities[index + PrefetchDistance], m_query))
+						PrefetchAll(driver.index, entities[index + PrefetchDistance], Indices{});
+					if (!m_signatures->Matches(entities[index], m_query))
+						return false;
+				}
+				else if (index + PrefetchDistance < driver.count)
+					PrefetchAll(driver.index, entities[index + PrefetchDistance], Indices{});
+				return ProbeAll(driver.index, entities[index], index, positions, Indices{});
+			}
+
+			template<size_t... Is>
+			void PrefetchAll(size_t driver, Entity entity, std::index_sequence<Is...>) const
+			{
+				((Is != driver ? std::get<Is>(m_datasets).Prefetch(entity) : void()), ...);
+			}
+
+			template<size_t... Is>
+			bool ProbeAll(size_t driver, Entity entity, size_t index, Positions& positions, std::index_sequence<Is...>) const
+			{
+				// Stops at the first dataset missing the entity
+				return ((positions[Is] = Is == driver ? static_cast<Entity>(index) : std::get<Is>(m_datasets).Find(entity),
+					positions[Is] != NoEntity) && ...);
+			}
+
+			template<size_t... Is>
+			auto Fetch(const Positions& positions, std::index_sequence<Is...>) const
+			{
+				return std::tuple_cat(utils::GetDataAtIndex(std::get<Is>(m_datasets), positions[Is])...);
+			}
+
+			std::tuple<Datasets& ...> m_datasets;
+			const ComponentSignatures<Entity>* m_signatures = nullptr;
+			ComponentMask m_query = 0;
+		};
+	}
+}
@@ -0,0 +1,238 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Bump allocator carving allocations out of large blocks, everything is released at once by Reset.
+		 * Reset keeps the blocks, an arena refilled every frame stops allocating once it reached its peak size.
+		 * Destructors of the objects created in the arena are not run.
+		 */
+		class LinearArena
+		{
+		public:
+			static constexpr size_t DefaultBlockSize = 64 * 1024;
+
+			explicit LinearArena(size_t blockSize = DefaultBlockSize) : m_blockSize(blockSize)
+			{}
+
+			LinearArena(const LinearArena&) = delete;
+			LinearArena& operator=(const LinearArena&) = delete;
+
+			LinearArena(LinearArena&& other) noexcept :
+				m_blocks(std::move(other.m_blocks)),
+				m_current(other.m_current),
+				m_cursor(other.m_cursor),
+				m_end(other.m_end),
+				m_usedBefore(other.m_usedBefore),
+				m_blockSize(other.m_blockSize)
+			{
+				other.m_blocks.clear();
+				other.Reset();
+			}
+
+			LinearArena& operator=(LinearArena&& other) noexcept
+			{
+				std::swap(m_blocks, other.m_blocks);
+				std::swap(m_current, other.m_current);
+				std::swap(m_cursor, other.m_cursor);
+				std::swap(m_end, other.m_end);
+				std::swap(m_usedBefore, other.m_usedBefore);
+				std::swap(m_blockSize, other.m_blockSize);
+				return *this;
+			}
+
+			~LinearArena()
+			{
+				for (const Block& block : m_blocks)
+					::operator delete(block.data, block.size, std::align_val_t(CacheLineSize));
+			}
+
+			/**
+			 * \param alignment Power of two
+			 */
+			void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+			{
+				assert((alignment & (alignment - 1)) == 0);
+				const size_t padding = Padding(m_cursor, alignment);
+				if (m_cursor == nullptr || static_cast<size_t>(m_end - m_cursor) < padding + size)
+					return AllocateSlow(size, alignment);
+				std::byte* result = m_cursor + padding;
+				m_cursor = result + size;
+				return result;
+			}
+
+			template<typename T>
+			T* AllocateArray(size_t count)
+			{
+				return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+			}
+
+			template<typename T, typename ...Args>
+			T* New(Args&& ...args)
+			{
+				return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			}
+
+			/**
+			 * \brief Position of the arena, Rewind to it frees everything allocated after
+			 */
+			struct Marker
+			{
+				size_t block;
+				std::byte* cursor;
+				size_t usedBefore;
+			};
+
+			Marker GetMarker() const
+			{
+				return { m_current, m_cursor, m_usedBefore };
+			}
+
+			/**
+			 * \brief Free everything allocated since marker was taken, markers are rewound last taken first
+			 */
+			void Rewind(const Marker& marker)
+			{
+				if (marker.cursor == nullptr)
+				{
+					Reset();
+					return;
+				}
+				m_current = marker.block;
+				m_cursor = marker.cursor;
+				m_end = m_blocks[marker.block].data + m_blocks[marker.block].size;
+				m_usedBefore = marker.usedBefore;
+			}
+
+			/**
+			 * \brief Release every allocation, the blocks are kept for the next round
+			 */
+			void Reset()
+			{
+				m_current = 0;
+				m_usedBefore = 0;
+				m_cursor = m_blocks.empty() ? nullptr : m_blocks[0].data;
+				m_end = m_blocks.empty() ? nullptr : m_blocks[0].data + m_blocks[0].size;
+			}
+
+			/**
+			 * \brief Bytes handed out since the last Reset, padding included
+			 */
+			size_t GetUsedBytes() const
+			{
+				return m_cursor == nullptr ? 0 : m_usedBefore + static_cast<size_t>(m_cursor - m_blocks[m_current].data);
+			}
+
+			/**
+			 * \brief Bytes of every block owned
+			 */
+			size_t GetCapacity() const
+			{
+				size_t capacity = 0;
+				for (const Block& block : m_blocks)
+					capacity += block.size;
+				return capacity;
+			}
+
+		private:
+			struct Block
+			{
+				std::byte* data;
+				size_t size;
+			};
+
+			static size_t Padding(const std::byte* pointer, size_t alignment)
+			{
+				return static_cast<size_t>(-reinterpret_cast<uintptr_t>(pointer)) & (alignment - 1);
+			}
+
+			// Move to the next block able to hold size bytes, allocating one when none is left
+			void* AllocateSlow(size_t size, size_t alignment)
+			{
+				size_t next = m_cursor == nullptr ? 0 : m_current + 1;
+				while (next < m_blocks.size() && m_blocks[next].size < size + alignment)
+				{
+					// Too small for this request, skipped until the next Reset
+					m_usedBefore += m_blocks[next].size;
+					++next;
+				}
+				if (next == m_blocks.size())
+				{
+					const size_t blockSize = std::max(m_blockSize, size + alignment);
+					m_blocks.push_back({ static_cast<std::byte*>(::operator new(blockSize, std::align_val_t(CacheLineSize))), blockSize });
+				}
+				if (m_cursor != nullptr)
+					m_usedBefore += static_cast<size_t>(m_cursor - m_blocks[m_current].data);
+				m_current = next;
+				m_cursor = m_blocks[next].data;
+				m_end = m_cursor + m_blocks[next].size;
+				return Allocate(size, alignment);
+			}
+
+			std::vector<Block> m_blocks;
+			size_t m_current = 0;
+			std::byte* m_cursor = nullptr;
+			std::byte* m_end = nullptr;
+			// Bytes used in the blocks before m_current
+			size_t m_usedBefore = 0;
+			size_t m_blockSize;
+		};
+
+		/**
+		 * \brief Standard allocator carving from a LinearArena, deallocate does nothing and Reset of the arena frees everything.
+		 * Meant for containers living for a frame: a growing container leaves its previous storage in the arena
+		 */
+		template<typename T>
+		class ArenaAllocator
+		{
+		public:
+			typedef T value_type;
+
+			explicit ArenaAllocator(LinearArena& arena) noexcept : m_arena(&arena)
+			{}
+
+			template<typename U>
+			ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_arena(other.GetArena())
+			{}
+
+			T* allocate(size_t count)
+			{
+				return m_arena->AllocateArray<T>(count);
+			}
+
+			void deallocate(T*, size_t) noexcept
+			{}
+
+			LinearArena* GetArena() const noexcept
+			{
+				return m_arena;
+			}
+
+			template<typename U>
+			bool operator==(const ArenaAllocator<U>& other) const noexcept
+			{
+				return m_arena == other.GetArena();
+			}
+
+			template<typename U>
+			bool operator!=(const ArenaAllocator<U>& other) const noexcept
+			{
+				return m_arena != other.GetArena();
+			}
+
+		private:
+			LinearArena* m_arena;
+		};
+	}
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Read only memory mapping of a whole file, pages are loaded by the OS on first access
+		 */
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			__declspec(dllexport) ~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			__declspec(dllexport) MappedFile(MappedFile&& other) noexcept;
+			__declspec(dllexport) MappedFile& operator=(MappedFile&& other) noexcept;
+
+			/**
+			 * \return false when the file cannot be opened or mapped, the mapping is then closed
+			 */
+			__declspec(dllexport) bool Open(const std::string& path);
+			__declspec(dllexport) void Close();
+
+			[[nodiscard]] bool IsOpen() const
+			{
+				return m_data != nullptr;
+			}
+
+			[[nodiscard]] const std::byte* GetData() const
+			{
+				return m_data;
+			}
+
+			[[nodiscard]] size_t GetSize() const
+			{
+				return m_size;
+			}
+
+		private:
+			const std::byte* m_data = nullptr;
+			size_t m_size = 0;
+#if defined(_WIN32)
+			void* m_file = nullptr;
+			void* m_mapping = nullptr;
+#endif
+		};
+	}
+}
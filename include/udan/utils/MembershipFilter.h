@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "udan/utils/EntityTraits.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Sparse set internals read by the batch membership kernels, 32 bit entities only
+		 */
+		struct MembershipProbe
+		{
+			const uint32_t* const* pages;
+			uint32_t pageCount;
+			uint32_t pageShift;
+			const uint32_t* dense;
+			uint32_t denseSize;
+			// Index bits of the handles, EntityTraits<uint32_t>::IndexMask of the set
+			uint32_t indexMask;
+		};
+
+		enum class MembershipKernel : uint8_t
+		{
+			SCALAR = 0,
+			AVX2 = 1,
+			AVX512 = 2
+		};
+
+		/**
+		 * \brief Widest kernel the running CPU supports, picked once. SSE has no gather so it falls back to SCALAR
+		 */
+		__declspec(dllexport) MembershipKernel GetMembershipKernel();
+
+		/**
+		 * \brief Write to out the index of every candidate present in all probes, in increasing order.
+		 * Processes 8 (AVX2) or 16 (AVX-512) candidates per step with gathers on the sparse pages and dense arrays.
+		 * \param out Room for count indexes
+		 * \return Number of matches written
+		 */
+		__declspec(dllexport) size_t FilterMembers(const uint32_t* candidates, size_t count,
+			const MembershipProbe* probes, size_t probeCount, uint32_t* out);
+
+		/**
+		 * \brief FilterMembers with an explicit kernel, it must be supported by the CPU
+		 */
+		__declspec(dllexport) size_t FilterMembers(MembershipKernel kernel, const uint32_t* candidates, size_t count,
+			const MembershipProbe* probes, size_t probeCount, uint32_t* out);
+
+		template<typename Set>
+		MembershipProbe MakeMembershipProbe(const Set& set)
+		{
+			const auto& sparse = set.GetSparse();
+			return {
+				sparse.GetPages(),
+				static_cast<uint32_t>(sparse.GetPageCount()),
+				static_cast<uint32_t>(std::remove_reference_t<decltype(sparse)>::PageShift),
+				set.Entities().data(),
+				static_cast<uint32_t>(set.Entities().size()),
+				EntityTraits<uint32_t>::IndexMask
+			};
+		}
+
+		/**
+		 * \brief Datasets the kernels can probe: 32 bit entities in a sparse set exposing its pages
+		 */
+		template<typename Dataset>
+		constexpr bool HasSparsePages = requires(const Dataset& dataset) { dataset.GetSparse().GetPages(); };
+
+		template<typename Entity, typename ...Datasets>
+		constexpr bool SupportsMembershipFilter = std::is_same_v<Entity, uint32_t> && (HasSparsePages<Datasets> && ...);
+	}
+}
@@ -0,0 +1,217 @@
+﻿#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "CacheLine.h"
+#include "SpinWait.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Bounded lock free queue for any number of producers and consumers (Dmitry Vyukov's design).
+		 * Every cell carries a sequence number telling whether it is ready for the producer or the consumer
+		 * holding that position, so each operation costs one CAS on the shared position.
+		 * \tparam T Element type
+		 */
+		template<typename T>
+		class MpmcQueue
+		{
+			struct Cell
+			{
+				std::atomic<size_t> sequence;
+				alignas(T) unsigned char storage[sizeof(T)];
+			};
+
+		public:
+			/**
+			 * \param capacity Rounded up to the next power of two
+			 */
+			explicit MpmcQueue(size_t capacity = 1024) :
+				m_capacity(std::bit_ceil(capacity < 2 ? size_t(2) : capacity)),
+				m_mask(m_capacity - 1),
+				m_cells(std::make_unique<Cell[]>(m_capacity))
+			{
+				for (size_t i = 0; i < m_capacity; ++i)
+				{
+					m_cells[i].sequence.store(i, std::memory_order_relaxed);
+				}
+			}
+
+			MpmcQueue(const MpmcQueue&) = delete;
+			MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+			~MpmcQueue()
+			{
+				const size_t end = m_enqueuePos.load(std::memory_order_relaxed);
+				for (size_t pos = m_dequeuePos.load(std::memory_order_relaxed); pos != end; ++pos)
+				{
+					std::launder(reinterpret_cast<T*>(m_cells[pos & m_mask].storage))->~T();
+				}
+			}
+
+			template<typename ...Args>
+			bool TryEmplace(Args&& ...args)
+			{
+				size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+				Cell* cell;
+				for (;;)
+				{
+					cell = &m_cells[pos & m_mask];
+					const size_t seq = cell->sequence.load(std::memory_order_acquire);
+					const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+					if (diff == 0)
+					{
+						if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (diff < 0)
+					{
+						return false;
+					}
+					else
+					{
+						pos = m_enqueuePos.load(std::memory_order_relaxed);
+					}
+				}
+				new (cell->storage) T(std::forward<Args>(args)...);
+				cell->sequence.store(pos + 1, std::memory_order_release);
+				m_wait.Notify(cell->sequence);
+				return true;
+			}
+
+			bool TryPush(const T& value)
+			{
+				return TryEmplace(value);
+			}
+
+			bool TryPush(T&& value)
+			{
+				return TryEmplace(std::move(value));
+			}
+
+			bool TryPop(T& out)
+			{
+				return TryConsume([&out](T&& element) { out = std::move(element); });
+			}
+
+			/**
+			 * \brief TryPop for types that cannot be default constructed
+			 */
+			std::optional<T> TryPop()
+			{
+				std::optional<T> result;
+				TryConsume([&result](T&& element) { result.emplace(std::move(element)); });
+				return result;
+			}
+
+			void Push(const T& value)
+			{
+				while (!TryPush(value))
+					WaitForCell(m_enqueuePos, 0);
+			}
+
+			void Push(T&& value)
+			{
+				while (!TryPush(std::move(value)))
+					WaitForCell(m_enqueuePos, 0);
+			}
+
+			T Pop()
+			{
+				for (;;)
+				{
+					if (std::optional<T> value = TryPop())
+						return std::move(*value);
+					WaitForCell(m_dequeuePos, 1);
+				}
+			}
+
+			/**
+			 * \brief Approximation when called while other threads are running
+			 */
+			[[nodiscard]] size_t Size() const
+			{
+				// Dequeue first: it never passes the enqueue position read after it
+				const size_t dequeued = m_dequeuePos.load(std::memory_order_acquire);
+				const size_t enqueued = m_enqueuePos.load(std::memory_order_acquire);
+				return enqueued > dequeued ? enqueued - dequeued : 0;
+			}
+
+			[[nodiscard]] bool Empty() const
+			{
+				return Size() == 0;
+			}
+
+			[[nodiscard]] size_t Capacity() const
+			{
+				return m_capacity;
+			}
+
+		private:
+			// Claim the next element and hand it to consume before releasing its cell
+			template<typename Consume>
+			bool TryConsume(Consume&& consume)
+			{
+				size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+				Cell* cell;
+				for (;;)
+				{
+					cell = &m_cells[pos & m_mask];
+					const size_t seq = cell->sequence.load(std::memory_order_acquire);
+					const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+					if (diff == 0)
+					{
+						if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (diff < 0)
+					{
+						return false;
+					}
+					else
+					{
+						pos = m_dequeuePos.load(std::memory_order_relaxed);
+					}
+				}
+				T* element = std::launder(reinterpret_cast<T*>(cell->storage));
+				consume(std::move(*element));
+				element->~T();
+				cell->sequence.store(pos + m_capacity, std::memory_order_release);
+				m_wait.Notify(cell->sequence);
+				return true;
+			}
+
+			/**
+			 * \brief Sleep on the cell at the current position until its sequence reaches pos + offset.
+			 * Waiting on the cell rather than on the position avoids missing a producer that already
+			 * claimed the position but did not publish the element yet.
+			 */
+			void WaitForCell(const std::atomic<size_t>& position, size_t offset)
+			{
+				const size_t pos = position.load(std::memory_order_relaxed);
+				const Cell& cell = m_cells[pos & m_mask];
+				m_wait.Wait(cell.sequence, [&]()
+					{
+						return position.load(std::memory_order_relaxed) != pos ||
+							static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire) - (pos + offset)) >= 0;
+					});
+			}
+
+			const size_t m_capacity;
+			const size_t m_mask;
+			std::unique_ptr<Cell[]> m_cells;
+			WaitPoint m_wait;
+
+			alignas(CacheLineSize) std::atomic<size_t> m_enqueuePos{ 0 };
+			alignas(CacheLineSize) std::atomic<size_t> m_dequeuePos{ 0 };
+		};
+	}
+}
@@ -0,0 +1,208 @@
+﻿#pragma once
+
+#include <cassert>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "udan/utils/ParallelFor.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Keeps the entities present in every owned dataset packed at the front of each dense array, in the same order.
+		 * Iterating is a linear scan of the first GetSize() components of each dataset with no lookup.
+		 * The group observes its datasets and repacks on every EmplaceBack/PushBack/RemoveComponent, a dataset can be owned
+		 * by a single group and must not be reordered (Swap) by anything else while owned.
+		 */
+		template<typename Entity, typename ...Datasets>
+		class OwningGroup : public ASparseSetObserver<Entity>
+		{
+			static_assert(sizeof...(Datasets) > 0, "A group owns at least one dataset");
+
+			using Indices = std::index_sequence_for<Datasets...>;
+
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = decltype(std::tuple_cat(std::declval<Datasets&>().GetDataAtIndex(0)...));
+				using reference = value_type;
+				using pointer = void;
+
+				Iterator() = default;
+
+				Iterator(const OwningGroup* group, size_t index) : m_group(group), m_index(index)
+				{}
+
+				value_type operator*() const
+				{
+					return m_group->Get(m_index);
+				}
+
+				Entity GetEntity() const
+				{
+					return m_group->GetEntities()[m_index];
+				}
+
+				Iterator& operator++()
+				{
+					++m_index;
+					return *this;
+				}
+
+				Iterator operator++(int)
+				{
+					Iterator tmp = *this;
+					++m_index;
+					return tmp;
+				}
+
+				bool operator==(const Iterator& other) const
+				{
+					return m_index == other.m_index;
+				}
+
+				bool operator!=(const Iterator& other) const
+				{
+					return !(*this == other);
+				}
+
+			private:
+				const OwningGroup* m_group = nullptr;
+				size_t m_index = 0;
+			};
+
+			/**
+			 * \brief Takes ownership of datasets and packs the entities they already share
+			 */
+			explicit OwningGroup(Datasets& ...datasets) : m_datasets(datasets...)
+			{
+				(datasets.SetObserver(this), ...);
+				auto& driver = std::get<0>(m_datasets);
+				// Positions below i were either packed or rejected, swapping one of them to i is harmless
+				for (size_t i = 0; i < driver.GetSize(); ++i)
+				{
+					const Entity entity = driver.Entities()[i];
+					if ((datasets.Exist(entity) && ...))
+						Pack(entity);
+				}
+			}
+
+			OwningGroup(const OwningGroup&) = delete;
+			OwningGroup& operator=(const OwningGroup&) = delete;
+
+			~OwningGroup() override
+			{
+				std::apply([](Datasets& ...datasets) { (datasets.SetObserver(nullptr), ...); }, m_datasets);
+			}
+
+			void OnConstruct(Entity entity) override
+			{
+				if (std::apply([entity](Datasets& ...datasets) { return (datasets.Exist(entity) && ...); }, m_datasets))
+					Pack(entity);
+			}
+
+			void OnDestroy(Entity entity) override
+			{
+				if (Contains(entity))
+				{
+					--m_length;
+					std::apply([this, entity](Datasets& ...datasets) { (datasets.Swap(m_length, entity), ...); }, m_datasets);
+				}
+			}
+
+			[[nodiscard]] bool Contains(Entity entity) const
+			{
+				return std::get<0>(m_datasets).Find(entity) < m_length;
+			}
+
+			/**
+			 * \brief Components of the matched entity at index, index < GetSize()
+			 */
+			auto Get(size_t index) const
+			{
+				return std::apply([index](Datasets& ...datasets) { return std::tuple_cat(datasets.GetDataAtIndex(index)...); }, m_datasets);
+			}
+
+			/**
+			 * \brief Matched entities are the first GetSize() entries
+			 */
+			const Entity* GetEntities() const
+			{
+				return std::get<0>(m_datasets).Entities().data();
+			}
+
+			Iterator begin() const
+			{
+				return Iterator(this, 0);
+			}
+
+			Iterator end() const
+			{
+				return Iterator(this, m_length);
+			}
+
+			/**
+			 * \brief Call func(components&...) or func(entity, components&...) for every match
+			 */
+			template<typename Func>
+			void Each(Func func) const
+			{
+				EachInRange(func, 0, m_length);
+			}
+
+			/**
+			 * \brief Each split in chunks of grain entities run on the pool, returns once every chunk ran.
+			 * func runs concurrently on distinct entities and must not add or remove owned components.
+			 * Unavailable when an owned dataset has ChangeTracking, its stamps would be written from several threads
+			 */
+			template<typename Func>
+			void ParallelEach(ThreadPool& threadPool, const Func& func, size_t grain = 1024) const
+			{
+				static_assert(!(StampsChanges<Datasets> || ...), "ParallelEach cannot stamp changes concurrently, use Each on groups of tracked datasets");
+				ParallelFor(threadPool, m_length, grain, [this, &func](size_t begin, size_t end)
+					{
+						EachInRange(func, begin, end);
+					});
+			}
+
+			size_t GetSize() const
+			{
+				return m_length;
+			}
+
+			/**
+			 * \brief Field F of the matched components of dataset D, contiguous since matches are packed. D must be a SoaDataSet
+			 */
+			template<size_t D, size_t F>
+			auto GetColumn() const
+			{
+				return std::get<D>(m_datasets).template GetColumn<F>().first(m_length);
+			}
+
+		private:
+			template<typename Func>
+			void EachInRange(Func& func, size_t begin, size_t end) const
+			{
+				const Entity* entities = GetEntities();
+				for (size_t i = begin; i < end; ++i)
+					InvokeWithComponents(func, entities[i], Get(i));
+			}
+
+			void Pack(Entity entity)
+			{
+				std::apply([this, entity](Datasets& ...datasets) { (datasets.Swap(m_length, entity), ...); }, m_datasets);
+				++m_length;
+			}
+
+			std::tuple<Datasets& ...> m_datasets;
+			size_t m_length = 0;
+		};
+	}
+}
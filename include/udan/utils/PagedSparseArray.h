@@ -0,0 +1,196 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Sparse index split into fixed size pages allocated on first write.
+		 * Pages that were never written all point to one shared read only page filled with Null,
+		 * so a read is a bounds check on the page table and two loads whatever the index.
+		 * Memory is proportional to the number of pages holding at least one live index.
+		 * \tparam T Unsigned integer stored per index
+		 * \tparam PageSize Entries per page, power of two
+		 */
+		template<typename T, size_t PageSize = 4096>
+		class PagedSparseArray
+		{
+			static_assert((PageSize & (PageSize - 1)) == 0, "PageSize must be a power of two");
+
+		public:
+			static constexpr T Null = std::numeric_limits<T>::max();
+			static constexpr size_t PageMask = PageSize - 1;
+			static constexpr size_t PageShift = std::countr_zero(PageSize);
+
+			PagedSparseArray() = default;
+
+			PagedSparseArray(const PagedSparseArray& other) : m_pages(other.m_pages.size(), EmptyPage()), m_allocatedPages(0)
+			{
+				for (size_t i = 0; i < other.m_pages.size(); ++i)
+				{
+					if (other.m_pages[i] != EmptyPage())
+					{
+						m_pages[i] = AllocatePage();
+						std::copy_n(other.m_pages[i], PageSize, m_pages[i]);
+					}
+				}
+			}
+
+			PagedSparseArray(PagedSparseArray&& other) noexcept :
+				m_pages(std::move(other.m_pages)),
+				m_allocatedPages(other.m_allocatedPages)
+			{
+				other.m_pages.clear();
+				other.m_allocatedPages = 0;
+			}
+
+			PagedSparseArray& operator=(PagedSparseArray other) noexcept
+			{
+				std::swap(m_pages, other.m_pages);
+				std::swap(m_allocatedPages, other.m_allocatedPages);
+				return *this;
+			}
+
+			~PagedSparseArray()
+			{
+				Release();
+			}
+
+			/**
+			 * \return Null when nothing was stored at index
+			 */
+			T operator[](size_t index) const
+			{
+				const size_t page = index >> PageShift;
+				if (page >= m_pages.size())
+					return Null;
+				return m_pages[page][index & PageMask];
+			}
+
+			/**
+			 * \brief Location operator[] reads for index, nullptr past the page table. Meant for prefetching
+			 */
+			const T* Address(size_t index) const
+			{
+				const size_t page = index >> PageShift;
+				if (page >= m_pages.size())
+					return nullptr;
+				return m_pages[page] + (index & PageMask);
+			}
+
+			/**
+			 * \brief Writable entry, allocates the page (and grows the page table) if needed
+			 */
+			T& Assure(size_t index)
+			{
+				const size_t page = index >> PageShift;
+				if (page >= m_pages.size())
+					m_pages.resize(std::max(page + 1, m_pages.size() * 2), EmptyPage());
+				if (m_pages[page] == EmptyPage())
+					m_pages[page] = AllocatePage();
+				return m_pages[page][index & PageMask];
+			}
+
+			/**
+			 * \brief Writable entry of an index that already holds a value
+			 */
+			T& At(size_t index)
+			{
+				assert((index >> PageShift) < m_pages.size() && m_pages[index >> PageShift] != EmptyPage());
+				return m_pages[index >> PageShift][index & PageMask];
+			}
+
+			/**
+			 * \brief Size the page table for indexes below capacity, pages are still allocated lazily
+			 */
+			void Reserve(size_t capacity)
+			{
+				const size_t pages = (capacity + PageMask) >> PageShift;
+				if (pages > m_pages.size())
+					m_pages.resize(pages, EmptyPage());
+			}
+
+			void Clear()
+			{
+				Release();
+				m_pages.clear();
+			}
+
+			[[nodiscard]] size_t GetPageCount() const
+			{
+				return m_pages.size();
+			}
+
+			[[nodiscard]] size_t GetAllocatedPageCount() const
+			{
+				return m_allocatedPages;
+			}
+
+			/**
+			 * \brief Page at index, nullptr when the page was never written
+			 */
+			[[nodiscard]] const T* GetPage(size_t page) const
+			{
+				return m_pages[page] == EmptyPage() ? nullptr : m_pages[page];
+			}
+
+			/**
+			 * \brief Page table, unallocated pages point to the shared Null page
+			 */
+			[[nodiscard]] const T* const* GetPages() const
+			{
+				return m_pages.data();
+			}
+
+			[[nodiscard]] size_t GetMemoryUsage() const
+			{
+				return m_pages.capacity() * sizeof(T*) + m_allocatedPages * PageSize * sizeof(T);
+			}
+
+		private:
+			static T* EmptyPage()
+			{
+				// Never written through: Assure replaces it before any write
+				static const std::array<T, PageSize> s_empty = []()
+				{
+					std::array<T, PageSize> page;
+					page.fill(Null);
+					return page;
+				}();
+				return const_cast<T*>(s_empty.data());
+			}
+
+			T* AllocatePage()
+			{
+				T* page = new T[PageSize];
+				std::fill_n(page, PageSize, Null);
+				++m_allocatedPages;
+				return page;
+			}
+
+			void Release()
+			{
+				for (T*& page : m_pages)
+				{
+					if (page != EmptyPage())
+					{
+						delete[] page;
+						page = EmptyPage();
+					}
+				}
+				m_allocatedPages = 0;
+			}
+
+			std::vector<T*> m_pages;
+			size_t m_allocatedPages = 0;
+		};
+	}
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include "ScratchArena.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "WaitGroup.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Run func(begin, end) over [0, count) in chunks of grain items on the pool and return once every chunk ran.
+		 * Chunks are claimed from a shared counter by the pool tasks and by the calling thread. Only chunks are waited for,
+		 * a task starting after the last chunk was claimed leaves without touching func, so this can be called from a pool task.
+		 */
+		template<typename Func>
+		void ParallelFor(ThreadPool& pool, size_t count, size_t grain, const Func& func)
+		{
+			if (count == 0)
+				return;
+			grain = std::max<size_t>(grain, 1);
+			const size_t chunkCount = (count + grain - 1) / grain;
+			if (chunkCount == 1 || pool.GetThreadCount() == 0)
+			{
+				func(size_t(0), count);
+				return;
+			}
+
+			struct State
+			{
+				std::atomic<size_t> next{ 0 };
+				WaitGroup done;
+			};
+			// Shared with the tasks, they may outlive this call
+			auto state = std::make_shared<State>();
+			state->done.Add(static_cast<uint32_t>(chunkCount));
+			const auto work = [state, &func, count, grain, chunkCount]()
+			{
+				for (size_t chunk = state->next.fetch_add(1, std::memory_order_relaxed); chunk < chunkCount;
+					chunk = state->next.fetch_add(1, std::memory_order_relaxed))
+				{
+					const size_t begin = chunk * grain;
+					func(begin, std::min(begin + grain, count));
+					state->done.Done();
+				}
+			};
+
+			const size_t taskCount = std::min(pool.GetThreadCount(), chunkCount - 1);
+			ScratchScope scratch(ThreadPool::GetScratch());
+			std::pmr::vector<std::shared_ptr<ATask>> tasks(scratch.GetResource());
+			tasks.reserve(taskCount);
+			for (size_t i = 0; i < taskCount; ++i)
+				tasks.push_back(std::make_shared<Task>(work));
+			pool.BulkSchedule(tasks);
+
+			work();
+			state->done.Wait();
+		}
+	}
+}
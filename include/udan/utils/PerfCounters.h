@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace udan
+{
+	namespace utils
+	{
+		enum class PerfCounter : uint32_t
+		{
+			CYCLES = 0,
+			INSTRUCTIONS = 1,
+			L1D_MISSES = 2,
+			LLC_MISSES = 3,
+			BRANCH_MISSES = 4
+		};
+		constexpr size_t PerfCounterCount = 5;
+
+		/**
+		 * \brief Snapshot (or difference of snapshots) of the hardware counters of one thread
+		 */
+		struct PerfCounterValues
+		{
+			std::array<uint64_t, PerfCounterCount> values{};
+			// Bit i is set when counter i could be opened and read
+			uint32_t validMask = 0;
+
+			[[nodiscard]] uint64_t Get(PerfCounter counter) const
+			{
+				return values[static_cast<size_t>(counter)];
+			}
+
+			[[nodiscard]] bool IsValid(PerfCounter counter) const
+			{
+				return (validMask & (1u << static_cast<uint32_t>(counter))) != 0;
+			}
+
+			[[nodiscard]] double InstructionsPerCycle() const
+			{
+				const uint64_t cycles = Get(PerfCounter::CYCLES);
+				return cycles == 0 ? 0.0 : static_cast<double>(Get(PerfCounter::INSTRUCTIONS)) / static_cast<double>(cycles);
+			}
+
+			PerfCounterValues operator-(const PerfCounterValues& rhs) const
+			{
+				PerfCounterValues delta;
+				delta.validMask = validMask & rhs.validMask;
+				for (size_t i = 0; i < PerfCounterCount; ++i)
+					delta.values[i] = values[i] >= rhs.values[i] ? values[i] - rhs.values[i] : 0;
+				return delta;
+			}
+
+			PerfCounterValues& operator+=(const PerfCounterValues& rhs)
+			{
+				validMask = validMask == 0 ? rhs.validMask : validMask & rhs.validMask;
+				for (size_t i = 0; i < PerfCounterCount; ++i)
+					values[i] += rhs.values[i];
+				return *this;
+			}
+		};
+
+		/**
+		 * \brief Counter group of the calling thread (cycles, instructions, L1D and LLC misses, branch misses).
+		 * Opened lazily through perf_event_open on Linux, user space only. When the kernel refuses the
+		 * counters (perf_event_paranoid, containers, VMs) or on other platforms, Read returns an empty
+		 * validMask and callers simply report no counters. Each Read is one read() system call.
+		 */
+		class PerfCounters
+		{
+		public:
+			/**
+			 * \brief Disabled by default, opening and reading counters is not free
+			 */
+			static void SetEnabled(bool enabled)
+			{
+				s_enabled.store(enabled, std::memory_order_relaxed);
+			}
+
+			[[nodiscard]] static bool IsEnabled()
+			{
+				return s_enabled.load(std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Counters of the calling thread, empty when disabled or unavailable
+			 */
+			__declspec(dllexport) static PerfCounterValues Read();
+
+			/**
+			 * \brief True if at least one counter could be opened for the calling thread
+			 */
+			__declspec(dllexport) static bool Available();
+
+		private:
+			__declspec(dllexport) static std::atomic<bool> s_enabled;
+		};
+	}
+}
@@ -0,0 +1,229 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Clock.h"
+#include "CriticalSectionLock.h"
+#include "PerfCounters.h"
+#include "SpscRingBuffer.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief One completed zone as recorded by the thread that ran it
+		 */
+		struct ProfileZoneRecord
+		{
+			const char* name;
+			Clock::Ticks start;
+			Clock::Ticks end;
+			uint32_t depth;
+			// Empty unless PerfCounters was enabled when the zone started
+			PerfCounterValues counters;
+		};
+
+		/**
+		 * \brief Aggregate of every call to a zone reached through the same path in the call tree
+		 */
+		struct ProfileNode
+		{
+			static constexpr uint32_t NoParent = UINT32_MAX;
+
+			std::string name;
+			uint32_t parent = NoParent;
+			uint32_t depth = 0;
+			uint64_t calls = 0;
+			Clock::Ticks inclusive = 0;
+			Clock::Ticks exclusive = 0;
+			Clock::Ticks min = UINT64_MAX;
+			Clock::Ticks max = 0;
+			// Inclusive hardware counters, validMask is 0 when they were not recorded
+			PerfCounterValues counters;
+			std::vector<uint32_t> children;
+
+			[[nodiscard]] Clock::Ticks Average() const
+			{
+				return calls == 0 ? 0 : inclusive / calls;
+			}
+		};
+
+		/**
+		 * \brief Call tree of one frame, zones of every thread merged by path
+		 */
+		class ProfileFrame
+		{
+		public:
+			[[nodiscard]] const std::vector<ProfileNode>& Nodes() const
+			{
+				return m_nodes;
+			}
+
+			[[nodiscard]] const std::vector<uint32_t>& Roots() const
+			{
+				return m_roots;
+			}
+
+			/**
+			 * \param path Zone names separated by '/', starting from a root zone
+			 * \return nullptr when no zone was recorded through this path
+			 */
+			__declspec(dllexport) const ProfileNode* Find(std::string_view path) const;
+
+			/**
+			 * \brief Indented table with calls, inclusive, exclusive and min/avg/max times,
+			 * plus IPC and miss counts when hardware counters were recorded
+			 */
+			__declspec(dllexport) std::string Report() const;
+
+			[[nodiscard]] uint64_t GetFrameIndex() const
+			{
+				return m_frameIndex;
+			}
+
+			/**
+			 * \brief Records lost because a thread buffer was full
+			 */
+			[[nodiscard]] uint64_t GetDroppedCount() const
+			{
+				return m_dropped;
+			}
+
+		private:
+			friend class Profiler;
+
+			uint32_t GetOrAddNode(uint32_t parent, const char* name);
+
+			std::vector<ProfileNode> m_nodes;
+			std::vector<uint32_t> m_roots;
+			uint64_t m_frameIndex = 0;
+			uint64_t m_dropped = 0;
+		};
+
+		/**
+		 * \brief Collects ProfileZone records from every thread.
+		 * Each thread writes into its own ring buffer, recording takes no lock and does no logging.
+		 * EndFrame drains the buffers and aggregates them, it must always be called from the same thread.
+		 */
+		class Profiler
+		{
+		public:
+			static constexpr size_t DefaultBufferCapacity = 16384;
+
+			__declspec(dllexport) static Profiler& Instance();
+
+			void SetEnabled(bool enabled)
+			{
+				m_enabled.store(enabled, std::memory_order_relaxed);
+			}
+
+			[[nodiscard]] bool IsEnabled() const
+			{
+				return m_enabled.load(std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Aggregate everything recorded since the previous call into a new frame
+			 */
+			__declspec(dllexport) const ProfileFrame& EndFrame();
+
+			[[nodiscard]] const ProfileFrame& GetLastFrame() const
+			{
+				return m_lastFrame;
+			}
+
+			struct ThreadBuffer
+			{
+				explicit ThreadBuffer(size_t capacity) : records(capacity)
+				{
+				}
+
+				SpscRingBuffer<ProfileZoneRecord> records;
+				uint32_t depth = 0;
+				std::atomic<uint64_t> dropped{ 0 };
+				std::atomic<bool> inUse{ true };
+			};
+
+			/**
+			 * \brief Buffer of the calling thread, registered on first use
+			 */
+			static ThreadBuffer& LocalBuffer()
+			{
+				if (s_local.buffer == nullptr)
+					s_local.buffer = Instance().AcquireBuffer();
+				return *s_local.buffer;
+			}
+
+		private:
+			struct LocalThreadBuffer
+			{
+				ThreadBuffer* buffer = nullptr;
+				~LocalThreadBuffer();
+			};
+
+			Profiler() = default;
+			__declspec(dllexport) ThreadBuffer* AcquireBuffer();
+
+			std::atomic<bool> m_enabled{ true };
+			CriticalSectionLock m_buffersLock;
+			std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+			std::vector<ProfileZoneRecord> m_scratch;
+			ProfileFrame m_lastFrame;
+			uint64_t m_frameIndex = 0;
+
+			__declspec(dllexport) static thread_local LocalThreadBuffer s_local;
+		};
+
+		/**
+		 * \brief Named profiling zone, nested zones build the call tree
+		 */
+		class ProfileZone
+		{
+		public:
+			explicit ProfileZone(const char* name) :
+				m_buffer(Profiler::Instance().IsEnabled() ? &Profiler::LocalBuffer() : nullptr),
+				m_name(name)
+			{
+				if (m_buffer != nullptr)
+				{
+					m_depth = ++m_buffer->depth;
+					if (PerfCounters::IsEnabled())
+						m_startCounters = PerfCounters::Read();
+					m_start = Clock::Now();
+				}
+			}
+
+			ProfileZone(const ProfileZone&) = delete;
+			ProfileZone& operator=(const ProfileZone&) = delete;
+
+			~ProfileZone()
+			{
+				if (m_buffer == nullptr)
+					return;
+				const Clock::Ticks end = Clock::Now();
+				--m_buffer->depth;
+				PerfCounterValues counters;
+				if (m_startCounters.validMask != 0)
+					counters = PerfCounters::Read() - m_startCounters;
+				if (!m_buffer->records.TryPush({ m_name, m_start, end, m_depth, counters }))
+					m_buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+
+		private:
+			Profiler::ThreadBuffer* m_buffer;
+			const char* m_name;
+			Clock::Ticks m_start = 0;
+			uint32_t m_depth = 0;
+			PerfCounterValues m_startCounters;
+		};
+	}
+}
+
+#define UDAN_PROFILE_CONCAT_INNER(a, b) a##b
+#define UDAN_PROFILE_CONCAT(a, b) UDAN_PROFILE_CONCAT_INNER(a, b)
+#define UDAN_PROFILE_ZONE(name) udan::utils::ProfileZone UDAN_PROFILE_CONCAT(udanProfileZone, __LINE__)(name)
@@ -0,0 +1,334 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "udan/utils/HugePages.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Allocator argument of sets storing their dense arrays in ReservedVector, holds the most elements they will store
+		 */
+		template<typename T>
+		class ReservedAllocator
+		{
+		public:
+			typedef T value_type;
+
+			explicit ReservedAllocator(size_t maxSize) noexcept : m_maxSize(maxSize)
+			{}
+
+			template<typename U>
+			ReservedAllocator(const ReservedAllocator<U>& other) noexcept : m_maxSize(other.GetMaxSize())
+			{}
+
+			size_t GetMaxSize() const noexcept
+			{
+				return m_maxSize;
+			}
+
+			template<typename U>
+			bool operator==(const ReservedAllocator<U>& other) const noexcept
+			{
+				return m_maxSize == other.GetMaxSize();
+			}
+
+			template<typename U>
+			bool operator!=(const ReservedAllocator<U>& other) const noexcept
+			{
+				return m_maxSize != other.GetMaxSize();
+			}
+
+		private:
+			size_t m_maxSize;
+		};
+
+		/**
+		 * \brief Contiguous array that never relocates: the address space of its largest size is reserved on first growth
+		 * and committed in place as it grows, so growing neither copies nor invalidates pointers.
+		 * Commits double from 64 KiB, whole huge pages past the first one.
+		 * Offers the part of the std::vector interface the sets use, insert only appends
+		 */
+		template<typename T>
+		class ReservedVector
+		{
+			static_assert(alignof(T) <= HugePageSize);
+
+		public:
+			typedef T value_type;
+			typedef size_t size_type;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef T* iterator;
+			typedef const T* const_iterator;
+			typedef ReservedAllocator<T> allocator_type;
+
+			explicit ReservedVector(const allocator_type& allocator) noexcept : m_maxSize(allocator.GetMaxSize())
+			{}
+
+			ReservedVector(const ReservedVector& other) : m_maxSize(other.m_maxSize)
+			{
+				Commit(other.m_size);
+				std::uninitialized_copy(other.begin(), other.end(), m_data);
+				m_size = other.m_size;
+			}
+
+			ReservedVector(ReservedVector&& other) noexcept :
+				m_data(std::exchange(other.m_data, nullptr)),
+				m_size(std::exchange(other.m_size, 0)),
+				m_committed(std::exchange(other.m_committed, 0)),
+				m_committedBytes(std::exchange(other.m_committedBytes, 0)),
+				m_maxSize(other.m_maxSize)
+			{}
+
+			ReservedVector& operator=(const ReservedVector& other)
+			{
+				if (this != &other)
+				{
+					ReservedVector copy(other);
+					swap(copy);
+				}
+				return *this;
+			}
+
+			ReservedVector& operator=(ReservedVector&& other) noexcept
+			{
+				ReservedVector moved(std::move(other));
+				swap(moved);
+				return *this;
+			}
+
+			~ReservedVector()
+			{
+				std::destroy_n(m_data, m_size);
+				ReleaseAddressSpace(m_data, m_maxSize * sizeof(T));
+			}
+
+			void swap(ReservedVector& other) noexcept
+			{
+				std::swap(m_data, other.m_data);
+				std::swap(m_size, other.m_size);
+				std::swap(m_committed, other.m_committed);
+				std::swap(m_committedBytes, other.m_committedBytes);
+				std::swap(m_maxSize, other.m_maxSize);
+			}
+
+			template<typename ...Args>
+			T& emplace_back(Args&& ...args)
+			{
+				if (m_size == m_committed)
+					Commit(m_size + 1);
+				T* element = new (m_data + m_size) T(std::forward<Args>(args)...);
+				++m_size;
+				return *element;
+			}
+
+			void push_back(const T& value)
+			{
+				emplace_back(value);
+			}
+
+			void push_back(T&& value)
+			{
+				emplace_back(std::move(value));
+			}
+
+			void pop_back()
+			{
+				assert(m_size != 0);
+				std::destroy_at(m_data + --m_size);
+			}
+
+			/**
+			 * \brief Append [first, last), pos must be end()
+			 */
+			template<std::forward_iterator It>
+			iterator insert(const_iterator pos, It first, It last)
+			{
+				assert(pos == end());
+				(void)pos;
+				const size_t count = static_cast<size_t>(std::distance(first, last));
+				Commit(m_size + count);
+				std::uninitialized_copy(first, last, m_data + m_size);
+				m_size += count;
+				return m_data + m_size - count;
+			}
+
+			iterator erase(const_iterator first, const_iterator last)
+			{
+				T* const begin = m_data + (first - m_data);
+				T* const end = std::move(m_data + (last - m_data), m_data + m_size, begin);
+				std::destroy(end, m_data + m_size);
+				m_size = static_cast<size_t>(end - m_data);
+				return begin;
+			}
+
+			void resize(size_t size)
+			{
+				if (size < m_size)
+				{
+					std::destroy(m_data + size, m_data + m_size);
+				}
+				else
+				{
+					Commit(size);
+					std::uninitialized_value_construct(m_data + m_size, m_data + size);
+				}
+				m_size = size;
+			}
+
+			void clear() noexcept
+			{
+				std::destroy_n(m_data, m_size);
+				m_size = 0;
+			}
+
+			/**
+			 * \brief Only checks that size fits the reservation, memory is committed as elements are added
+			 */
+			void reserve(size_t size) const
+			{
+				if (size > m_maxSize)
+					throw std::length_error("ReservedVector grows past the size it reserved");
+			}
+
+			size_t capacity() const noexcept
+			{
+				return m_maxSize;
+			}
+
+			size_t max_size() const noexcept
+			{
+				return m_maxSize;
+			}
+
+			size_t size() const noexcept
+			{
+				return m_size;
+			}
+
+			bool empty() const noexcept
+			{
+				return m_size == 0;
+			}
+
+			T* data() noexcept
+			{
+				return m_data;
+			}
+
+			const T* data() const noexcept
+			{
+				return m_data;
+			}
+
+			T& operator[](size_t index)
+			{
+				return m_data[index];
+			}
+
+			const T& operator[](size_t index) const
+			{
+				return m_data[index];
+			}
+
+			T& back()
+			{
+				return m_data[m_size - 1];
+			}
+
+			const T& back() const
+			{
+				return m_data[m_size - 1];
+			}
+
+			iterator begin() noexcept
+			{
+				return m_data;
+			}
+
+			iterator end() noexcept
+			{
+				return m_data + m_size;
+			}
+
+			const_iterator begin() const noexcept
+			{
+				return m_data;
+			}
+
+			const_iterator end() const noexcept
+			{
+				return m_data + m_size;
+			}
+
+			allocator_type get_allocator() const noexcept
+			{
+				return allocator_type(m_maxSize);
+			}
+
+		private:
+			// Make room for size elements, the reservation is taken on first growth so that empty arrays cost nothing
+			void Commit(size_t size)
+			{
+				if (size <= m_committed)
+					return;
+				reserve(size);
+				const size_t reserved = RoundUp(m_maxSize * sizeof(T), HugePageSize);
+				if (m_data == nullptr)
+				{
+					m_data = static_cast<T*>(ReserveAddressSpace(reserved));
+					if (m_data == nullptr)
+						throw std::bad_alloc();
+				}
+				// Small arrays would pay for zeroing a whole huge page on their first element
+				const size_t wanted = std::max(size * sizeof(T), m_committedBytes * 2);
+				const size_t bytes = std::min(RoundUp(wanted, wanted < HugePageSize ? CommitGranularity : HugePageSize), reserved);
+				if (!CommitAddressSpace(reinterpret_cast<std::byte*>(m_data) + m_committedBytes, bytes - m_committedBytes))
+					throw std::bad_alloc();
+				m_committedBytes = bytes;
+				m_committed = std::min(bytes / sizeof(T), m_maxSize);
+			}
+
+			static constexpr size_t CommitGranularity = 64 * 1024;
+
+			static size_t RoundUp(size_t bytes, size_t granularity)
+			{
+				return (bytes + granularity - 1) / granularity * granularity;
+			}
+
+			T* m_data = nullptr;
+			size_t m_size = 0;
+			size_t m_committed = 0;
+			size_t m_committedBytes = 0;
+			size_t m_maxSize;
+		};
+
+		/**
+		 * \brief Container of the dense arrays of sets given Allocator: std::vector, ReservedVector for ReservedAllocator
+		 */
+		template<typename T, typename Allocator>
+		struct DenseStorage
+		{
+			typedef std::vector<T, Allocator> Type;
+		};
+
+		template<typename T>
+		struct DenseStorage<T, ReservedAllocator<T>>
+		{
+			typedef ReservedVector<T> Type;
+		};
+
+		template<typename T, typename Allocator>
+		using DenseVector = typename DenseStorage<T, Allocator>::Type;
+	}
+}
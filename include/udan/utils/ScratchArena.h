@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include "udan/utils/LinearArena.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Bump pointer memory resource for temporaries, std::pmr containers built on it never reach malloc once warm.
+		 * Every pool worker and every other thread owns one, see ThreadPool::GetScratch. Memory is released by a
+		 * ScratchScope ending or by ThreadPool::ResetScratch at a frame boundary, deallocate does nothing
+		 */
+		class ScratchArena final : public std::pmr::memory_resource
+		{
+		public:
+			explicit ScratchArena(size_t blockSize = LinearArena::DefaultBlockSize) : m_arena(blockSize)
+			{}
+
+			void Reset()
+			{
+				m_arena.Reset();
+			}
+
+			LinearArena& GetArena()
+			{
+				return m_arena;
+			}
+
+			[[nodiscard]] size_t GetUsedBytes() const
+			{
+				return m_arena.GetUsedBytes();
+			}
+
+			[[nodiscard]] size_t GetCapacity() const
+			{
+				return m_arena.GetCapacity();
+			}
+
+		private:
+			void* do_allocate(size_t bytes, size_t alignment) override
+			{
+				return m_arena.Allocate(bytes, alignment);
+			}
+
+			void do_deallocate(void*, size_t, size_t) override
+			{}
+
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+			{
+				return this == &other;
+			}
+
+			LinearArena m_arena;
+		};
+
+		/**
+		 * \brief Frees what was allocated from arena during its lifetime. Scopes of one arena must end in reverse order,
+		 * which holds for scopes opened on the thread owning the arena
+		 */
+		class ScratchScope
+		{
+		public:
+			explicit ScratchScope(ScratchArena& arena) : m_arena(arena), m_marker(arena.GetArena().GetMarker())
+			{}
+
+			ScratchScope(const ScratchScope&) = delete;
+			ScratchScope& operator=(const ScratchScope&) = delete;
+
+			~ScratchScope()
+			{
+				m_arena.GetArena().Rewind(m_marker);
+			}
+
+			std::pmr::memory_resource* GetResource() const
+			{
+				return &m_arena;
+			}
+
+		private:
+			ScratchArena& m_arena;
+			LinearArena::Marker m_marker;
+		};
+	}
+}
@@ -0,0 +1,521 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/EntityTraits.h"
+#include "udan/utils/MappedFile.h"
+#include "udan/utils/PagedSparseArray.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		constexpr uint32_t SnapshotMagic = 0x53534455; // "UDSS"
+		constexpr uint16_t SnapshotVersion = 1;
+		// Every block starts at a multiple of this offset
+		constexpr size_t SnapshotAlignment = CacheLineSize;
+
+		/**
+		 * \brief First bytes of a snapshot file, followed by the blocks at the given offsets.
+		 * Blocks: dense entities, page table (one uint32_t slot per sparse page, NoPage when never written),
+		 * the allocated sparse pages back to back, the components in dense order. Values use the native byte order
+		 */
+		struct SnapshotHeader
+		{
+			static constexpr uint32_t NoPage = UINT32_MAX;
+
+			uint32_t magic;
+			uint16_t version;
+			uint16_t entitySize;
+			// 0 for a plain SparseSet
+			uint32_t componentSize;
+			uint32_t componentAlignment;
+			uint64_t count;
+			uint64_t pageSize;
+			uint64_t pageCount;
+			uint64_t allocatedPageCount;
+			uint64_t denseOffset;
+			uint64_t pageTableOffset;
+			uint64_t pagesOffset;
+			uint64_t componentsOffset;
+			uint64_t fileSize;
+		};
+
+		/**
+		 * \brief Size and alignment recorded in the header, 0 for the void component of a plain SparseSet
+		 */
+		template<typename Component>
+		struct SnapshotComponentLayout
+		{
+			static constexpr uint32_t Size = sizeof(Component);
+			static constexpr uint32_t Alignment = alignof(Component);
+		};
+
+		template<>
+		struct SnapshotComponentLayout<void>
+		{
+			static constexpr uint32_t Size = 0;
+			static constexpr uint32_t Alignment = 0;
+		};
+
+		/**
+		 * \brief Writes a SparseSet, or a DataSet of trivially copyable components, as a snapshot file.
+		 * The writer keeps its own copy of the set, the file is written from it by WriteSome in bounded steps,
+		 * e.g. a slice per frame or from a pool task. Only capturing must not overlap with changes to the set:
+		 * Capture copies the whole set, CaptureChanges then replays the change log of a tracking DataSet so that
+		 * the pause follows the number of changes instead of the size of the set.
+		 * \tparam Component void for a SparseSet
+		 */
+		template<typename Entity, typename Component = void>
+		class SnapshotWriter
+		{
+			static_assert(std::is_void_v<Component> || std::is_trivially_copyable_v<Component>,
+				"Snapshots store components as raw bytes");
+			static_assert(SnapshotComponentLayout<Component>::Alignment <= SnapshotAlignment);
+
+		public:
+			SnapshotWriter() = default;
+			SnapshotWriter(const SnapshotWriter&) = delete;
+			SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+			~SnapshotWriter()
+			{
+				Close();
+			}
+
+			/**
+			 * \brief Copy the whole set, a few bulk copies
+			 */
+			template<typename Set>
+			void Capture(const Set& set)
+			{
+				assert(m_file == nullptr);
+				m_sparse = set.GetSparse();
+				m_dense.assign(set.Entities().begin(), set.Entities().end());
+				if constexpr (!std::is_void_v<Component>)
+				{
+					const std::span<const Component> components = set.GetComponents();
+					m_components.assign(components.begin(), components.end());
+				}
+				BuildBlocks();
+			}
+
+			/**
+			 * \brief Update the copy with the changes set logged after tick since, instead of copying it again.
+			 * since is the tick the previous capture ended, the set may not have changed later in that tick.
+			 * The copy keeps its own dense order, the file holds the same entities and components as a Capture
+			 */
+			template<typename Set>
+			void CaptureChanges(const Set& set, uint32_t since) requires (!std::is_void_v<Component>)
+			{
+				assert(m_file == nullptr);
+				for (const auto& change : set.GetChanges().GetChanges(since))
+				{
+					// Entries of one entity may repeat, the current state of the set wins
+					const Entity pos = set.Find(change.entity);
+					if (pos == NoEntity)
+						Erase(change.entity);
+					else
+						Upsert(change.entity, set.GetComponents()[pos]);
+				}
+				BuildBlocks();
+			}
+
+			/**
+			 * \brief Start writing the captured set to path, WriteSome does the writing
+			 */
+			bool Open(const std::string& path)
+			{
+				Close();
+				m_failed = false;
+				m_position = 0;
+				m_block = 0;
+				m_file = std::fopen(path.c_str(), "wb");
+				m_failed = m_file == nullptr;
+				return !m_failed;
+			}
+
+			/**
+			 * \brief Write at most maxBytes more
+			 * \return true once the whole snapshot is written and the file closed, check Failed then
+			 */
+			bool WriteSome(size_t maxBytes)
+			{
+				if (m_file == nullptr)
+					return true;
+				static constexpr std::byte Padding[SnapshotAlignment] = {};
+				while (maxBytes > 0 && m_block < m_blocks.size())
+				{
+					const Block& block = m_blocks[m_block];
+					size_t size;
+					if (m_position < block.offset)
+					{
+						size = std::min<size_t>(block.offset - m_position, maxBytes);
+						m_failed |= std::fwrite(Padding, 1, size, m_file) != size;
+					}
+					else
+					{
+						const size_t done = static_cast<size_t>(m_position - block.offset);
+						size = std::min(block.size - done, maxBytes);
+						m_failed |= size > 0 && std::fwrite(block.data + done, 1, size, m_file) != size;
+					}
+					m_position += size;
+					maxBytes -= size;
+					if (m_position == block.offset + block.size)
+						++m_block;
+					if (m_failed)
+						break;
+				}
+				if (m_block < m_blocks.size() && !m_failed)
+					return false;
+				Close();
+				return true;
+			}
+
+			/**
+			 * \brief Open and write everything captured
+			 */
+			bool Write(const std::string& path)
+			{
+				if (!Open(path))
+					return false;
+				WriteSome(SIZE_MAX);
+				return !m_failed;
+			}
+
+			[[nodiscard]] bool Failed() const
+			{
+				return m_failed;
+			}
+
+			[[nodiscard]] uint64_t GetWrittenBytes() const
+			{
+				return m_position;
+			}
+
+			[[nodiscard]] uint64_t GetTotalBytes() const
+			{
+				return m_header.fileSize;
+			}
+
+		private:
+			static constexpr size_t PageSize = PagedSparseArray<Entity>::PageMask + 1;
+			static constexpr Entity NoEntity = PagedSparseArray<Entity>::Null;
+			// Pages are written as consecutive blocks, no padding may fall between them
+			static_assert(PageSize * sizeof(Entity) % SnapshotAlignment == 0);
+
+			struct Block
+			{
+				const std::byte* data;
+				size_t size;
+				uint64_t offset;
+			};
+
+			static uint64_t AlignUp(uint64_t offset)
+			{
+				return (offset + SnapshotAlignment - 1) & ~uint64_t(SnapshotAlignment - 1);
+			}
+
+			template<typename C>
+			void Upsert(Entity entity, const C& component)
+			{
+				const Entity index = EntityTraits<Entity>::Index(entity);
+				const Entity pos = m_sparse[index];
+				if (pos != NoEntity && m_dense[pos] == entity)
+				{
+					m_components[pos] = component;
+					return;
+				}
+				// Left by a destroyed entity of the slot
+				if (pos != NoEntity)
+					Erase(m_dense[pos]);
+				m_sparse.Assure(index) = static_cast<Entity>(m_dense.size());
+				m_dense.push_back(entity);
+				m_components.push_back(component);
+			}
+
+			// Swap and pop, like DataSet
+			void Erase(Entity entity)
+			{
+				const Entity index = EntityTraits<Entity>::Index(entity);
+				const Entity pos = m_sparse[index];
+				if (pos == NoEntity || m_dense[pos] != entity)
+					return;
+				const Entity last = m_dense.back();
+				m_dense[pos] = last;
+				m_components[pos] = m_components.back();
+				m_sparse.At(EntityTraits<Entity>::Index(last)) = pos;
+				m_dense.pop_back();
+				m_components.pop_back();
+				m_sparse.At(index) = NoEntity;
+			}
+
+			// The file points straight into the copy: header, dense, page table, each allocated page, components
+			void BuildBlocks()
+			{
+				m_pageTable.assign(m_sparse.GetPageCount(), SnapshotHeader::NoPage);
+				uint32_t allocated = 0;
+				for (size_t page = 0; page < m_pageTable.size(); ++page)
+				{
+					if (m_sparse.GetPage(page) != nullptr)
+						m_pageTable[page] = allocated++;
+				}
+
+				m_header = {};
+				m_header.magic = SnapshotMagic;
+				m_header.version = SnapshotVersion;
+				m_header.entitySize = sizeof(Entity);
+				m_header.componentSize = SnapshotComponentLayout<Component>::Size;
+				m_header.componentAlignment = SnapshotComponentLayout<Component>::Alignment;
+				m_header.count = m_dense.size();
+				m_header.pageSize = PageSize;
+				m_header.pageCount = m_pageTable.size();
+				m_header.allocatedPageCount = allocated;
+
+				m_blocks.clear();
+				uint64_t offset = 0;
+				const auto addBlock = [this, &offset](const void* data, size_t size)
+				{
+					offset = AlignUp(offset);
+					m_blocks.push_back({ static_cast<const std::byte*>(data), size, offset });
+					offset += size;
+					return m_blocks.back().offset;
+				};
+				addBlock(&m_header, sizeof(SnapshotHeader));
+				m_header.denseOffset = addBlock(m_dense.data(), m_dense.size() * sizeof(Entity));
+				m_header.pageTableOffset = addBlock(m_pageTable.data(), m_pageTable.size() * sizeof(uint32_t));
+				m_header.pagesOffset = AlignUp(offset);
+				for (size_t page = 0; page < m_pageTable.size(); ++page)
+				{
+					if (const Entity* entries = m_sparse.GetPage(page))
+						addBlock(entries, PageSize * sizeof(Entity));
+				}
+				m_header.componentsOffset = addBlock(m_components.data(), m_components.size() * SnapshotComponentLayout<Component>::Size);
+				m_header.fileSize = offset;
+				m_position = 0;
+				m_block = 0;
+			}
+
+			void Close()
+			{
+				if (m_file == nullptr)
+					return;
+				m_failed |= std::fclose(m_file) != 0;
+				m_file = nullptr;
+			}
+
+			SnapshotHeader m_header{};
+			PagedSparseArray<Entity> m_sparse;
+			std::vector<Entity> m_dense;
+			std::vector<uint32_t> m_pageTable;
+			// Unused for a SparseSet
+			std::vector<std::conditional_t<std::is_void_v<Component>, std::byte, Component>> m_components;
+			std::vector<Block> m_blocks;
+			size_t m_block = 0;
+			uint64_t m_position = 0;
+			std::FILE* m_file = nullptr;
+			bool m_failed = false;
+		};
+
+		/**
+		 * \brief Read only set served straight from a memory mapped snapshot.
+		 * Opening validates the header and builds the sparse page table, nothing is done per entity:
+		 * entities and components are read in place, their pages loaded by the OS on first access.
+		 * Only this read only access is zero copy: CopyTo, to get a mutable DataSet, copies every component.
+		 * \tparam Component void for a snapshot of a SparseSet
+		 */
+		template<typename Entity, typename Component = void>
+		class DataSetSnapshot
+		{
+			typedef EntityTraits<Entity> Traits;
+			static constexpr Entity NoEntity = PagedSparseArray<Entity>::Null;
+
+		public:
+			/**
+			 * \return false when the file cannot be mapped or was not written for this Entity and Component
+			 */
+			bool Open(const std::string& path)
+			{
+				Close();
+				if (!m_file.Open(path) || !Validate())
+				{
+					Close();
+					return false;
+				}
+				const std::byte* data = m_file.GetData();
+				const SnapshotHeader& header = GetHeader();
+				m_dense = reinterpret_cast<const Entity*>(data + header.denseOffset);
+				m_count = static_cast<size_t>(header.count);
+				if constexpr (!std::is_void_v<Component>)
+					m_components = reinterpret_cast<const Component*>(data + header.componentsOffset);
+				m_pageShift = static_cast<size_t>(std::countr_zero(header.pageSize));
+				m_pageMask = static_cast<size_t>(header.pageSize - 1);
+				m_nullPage.assign(static_cast<size_t>(header.pageSize), NoEntity);
+				const uint32_t* table = reinterpret_cast<const uint32_t*>(data + header.pageTableOffset);
+				const Entity* pages = reinterpret_cast<const Entity*>(data + header.pagesOffset);
+				m_pages.resize(static_cast<size_t>(header.pageCount));
+				for (size_t page = 0; page < m_pages.size(); ++page)
+				{
+					m_pages[page] = table[page] == SnapshotHeader::NoPage
+						? m_nullPage.data()
+						: pages + static_cast<size_t>(table[page]) * static_cast<size_t>(header.pageSize);
+				}
+				return true;
+			}
+
+			void Close()
+			{
+				m_file.Close();
+				m_pages.clear();
+				m_dense = nullptr;
+				m_components = nullptr;
+				m_count = 0;
+			}
+
+			[[nodiscard]] bool IsOpen() const
+			{
+				return m_file.IsOpen();
+			}
+
+			[[nodiscard]] const SnapshotHeader& GetHeader() const
+			{
+				return *reinterpret_cast<const SnapshotHeader*>(m_file.GetData());
+			}
+
+			bool Exist(Entity id) const
+			{
+				return Find(id) != NoEntity;
+			}
+
+			/**
+			 * \return Dense position of id, or the null entity when id is not in the snapshot
+			 */
+			Entity Find(Entity id) const
+			{
+				const size_t index = Traits::Index(id);
+				const size_t page = index >> m_pageShift;
+				if (page >= m_pages.size())
+					return NoEntity;
+				const Entity pos = m_pages[page][index & m_pageMask];
+				return pos < m_count && m_dense[pos] == id ? pos : NoEntity;
+			}
+
+			void Prefetch(Entity id) const
+			{
+				const size_t index = Traits::Index(id);
+				if ((index >> m_pageShift) < m_pages.size())
+					utils::Prefetch(m_pages[index >> m_pageShift] + (index & m_pageMask));
+			}
+
+			std::span<const Entity> Entities() const
+			{
+				return { m_dense, m_count };
+			}
+
+			size_t GetSize() const
+			{
+				return m_count;
+			}
+
+			template<typename C = Component>
+			std::span<const C> GetComponents() const requires (!std::is_void_v<C>)
+			{
+				return { m_components, m_count };
+			}
+
+			template<typename C = Component>
+			const C& Get(Entity id) const requires (!std::is_void_v<C>)
+			{
+				return m_components[Find(id)];
+			}
+
+			template<typename C = Component>
+			std::tuple<const C&> GetDataAtIndex(size_t index) const requires (!std::is_void_v<C>)
+			{
+				return { m_components[index] };
+			}
+
+			template<typename C = Component>
+			std::tuple<const C&> PeekAtIndex(size_t index) const requires (!std::is_void_v<C>)
+			{
+				return { m_components[index] };
+			}
+
+			/**
+			 * \brief Call func(component) or func(entity, component) for every entity, in dense order
+			 */
+			template<typename Func>
+			void Each(Func func) const requires (!std::is_void_v<Component>)
+			{
+				for (size_t i = 0; i < m_count; ++i)
+					InvokeWithComponents(func, m_dense[i], GetDataAtIndex(i));
+			}
+
+			/**
+			 * \brief Replace the content of set with the snapshot, one bulk insertion copying every entity and component
+			 */
+			template<typename Tracking, typename Allocator>
+			void CopyTo(DataSet<Entity, Component, Tracking, Allocator>& set) const requires (!std::is_void_v<Component>)
+			{
+				set.Clear();
+				set.InsertRange(Entities(), GetComponents());
+			}
+
+		private:
+			bool Validate() const
+			{
+				const size_t size = m_file.GetSize();
+				if (size < sizeof(SnapshotHeader))
+					return false;
+				const SnapshotHeader& header = GetHeader();
+				const size_t componentSize = SnapshotComponentLayout<Component>::Size;
+				const size_t componentAlignment = SnapshotComponentLayout<Component>::Alignment;
+				if (header.magic != SnapshotMagic || header.version != SnapshotVersion || header.entitySize != sizeof(Entity)
+					|| header.componentSize != componentSize || header.componentAlignment != componentAlignment
+					|| header.fileSize != size || header.pageSize == 0 || (header.pageSize & (header.pageSize - 1)) != 0)
+					return false;
+				// Bounds every count so that the block sizes below cannot overflow
+				if (header.count > size || header.pageCount > size || header.allocatedPageCount > size || header.pageSize > UINT32_MAX)
+					return false;
+				const auto fits = [size](uint64_t offset, uint64_t bytes)
+				{
+					return offset % SnapshotAlignment == 0 && offset <= size && bytes <= size - offset;
+				};
+				if (!fits(header.denseOffset, header.count * sizeof(Entity))
+					|| !fits(header.pageTableOffset, header.pageCount * sizeof(uint32_t))
+					|| !fits(header.pagesOffset, header.allocatedPageCount * header.pageSize * sizeof(Entity))
+					|| !fits(header.componentsOffset, header.count * componentSize))
+					return false;
+				const uint32_t* table = reinterpret_cast<const uint32_t*>(m_file.GetData() + header.pageTableOffset);
+				for (uint64_t page = 0; page < header.pageCount; ++page)
+				{
+					if (table[page] != SnapshotHeader::NoPage && table[page] >= header.allocatedPageCount)
+						return false;
+				}
+				return true;
+			}
+
+			MappedFile m_file;
+			std::vector<const Entity*> m_pages;
+			// Target of the pages that were never written
+			std::vector<Entity> m_nullPage;
+			const Entity* m_dense = nullptr;
+			const Component* m_components = nullptr;
+			size_t m_count = 0;
+			size_t m_pageShift = 0;
+			size_t m_pageMask = 0;
+		};
+	}
+}
@@ -0,0 +1,218 @@
+﻿#pragma once
+
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "udan/utils/AlignedAllocator.h"
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/SparseSet.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		template<typename T>
+		struct MemberPointerTraits;
+
+		template<typename Class, typename Field>
+		struct MemberPointerTraits<Field Class::*>
+		{
+			typedef Class ClassType;
+			typedef Field FieldType;
+		};
+
+		/**
+		 * \brief Fields of a component stored by SoaDataSet, one column per member pointer:
+		 * struct Position { float x, y, z; using SoaFields = SoaLayout<&Position::x, &Position::y, &Position::z>; };
+		 */
+		template<auto ...Members>
+		struct SoaLayout
+		{
+			static_assert(sizeof...(Members) > 0, "A layout has at least one field");
+			static_assert((!std::is_array_v<typename MemberPointerTraits<decltype(Members)>::FieldType> && ...), "Use std::array for array fields");
+
+			static constexpr size_t FieldCount = sizeof...(Members);
+			static constexpr std::tuple<decltype(Members)...> Pointers{ Members... };
+
+			using Fields = std::tuple<typename MemberPointerTraits<decltype(Members)>::FieldType...>;
+			template<size_t I>
+			using FieldType = std::tuple_element_t<I, Fields>;
+			using Reference = std::tuple<typename MemberPointerTraits<decltype(Members)>::FieldType&...>;
+			using ConstReference = std::tuple<const typename MemberPointerTraits<decltype(Members)>::FieldType&...>;
+			template<size_t Alignment>
+			using Columns = std::tuple<std::vector<typename MemberPointerTraits<decltype(Members)>::FieldType,
+				AlignedAllocator<typename MemberPointerTraits<decltype(Members)>::FieldType, Alignment>>...>;
+		};
+
+		/**
+		 * \brief Layout of ComponentType, specialize it for components that cannot declare SoaFields themselves
+		 */
+		template<typename ComponentType>
+		struct SoaLayoutOf
+		{
+			typedef typename ComponentType::SoaFields Type;
+		};
+
+		/**
+		 * \brief DataSet storing each field of the component in its own cache line aligned column (structure of arrays).
+		 * Loops touching a few fields of a large component only stream those columns and can be vectorized over GetColumn spans.
+		 * Components are accessed as a tuple of field references (Reference) instead of a ComponentType&.
+		 */
+		template<typename Entity, typename ComponentType>
+		class SoaDataSet : public SparseSet<Entity>
+		{
+			using Layout = typename SoaLayoutOf<ComponentType>::Type;
+			using FieldIndices = std::make_index_sequence<Layout::FieldCount>;
+			using Columns = typename Layout::template Columns<CacheLineSize>;
+
+		public:
+			using ValueType = ComponentType;
+			using Reference = typename Layout::Reference;
+			using ConstReference = typename Layout::ConstReference;
+			template<size_t F>
+			using FieldType = typename Layout::template FieldType<F>;
+
+			explicit SoaDataSet(size_t capacity = 512) : SparseSet<Entity>(capacity)
+			{
+				std::apply([capacity](auto& ...columns) { (columns.reserve(capacity), ...); }, m_columns);
+			}
+
+			void PushBack(Entity id, const ComponentType& component)
+			{
+				if (!PrepareInsert(id))
+				{
+					return; //Component already exist
+				}
+				Append(component, FieldIndices{});
+				this->AppendDense(id);
+				this->NotifyConstruct(id);
+			}
+
+			template<typename ...Args>
+			void EmplaceBack(Entity id, Args&& ...args)
+			{
+				if constexpr (std::is_aggregate_v<ComponentType>)
+					PushBack(id, ComponentType{ std::forward<Args>(args)... });
+				else
+					PushBack(id, ComponentType(std::forward<Args>(args)...));
+			}
+
+			void RemoveComponent(Entity entity)
+			{
+				if (!this->Exist(entity))
+				{
+					return;
+				}
+				this->NotifyDestroy(entity);
+				const auto pos = this->EraseDense(entity);
+				std::apply([pos](auto& ...columns)
+					{
+						((columns[pos] = std::move(columns.back()), columns.pop_back()), ...);
+					}, m_columns);
+			}
+
+			Reference GetComponent(Entity id)
+			{
+				return At(this->m_sparse[Traits::Index(id)], FieldIndices{});
+			}
+
+			template<size_t F>
+			FieldType<F>& Get(Entity id)
+			{
+				return std::get<F>(m_columns)[this->m_sparse[Traits::Index(id)]];
+			}
+
+			Entity GetComponentId(Entity id)
+			{
+				return this->m_sparse[Traits::Index(id)];
+			}
+
+			/**
+			 * \brief Copy of the component at index gathered from every column
+			 */
+			ComponentType Load(size_t index) const
+			{
+				ComponentType component{};
+				Gather(component, index, FieldIndices{});
+				return component;
+			}
+
+			void Store(size_t index, const ComponentType& component)
+			{
+				Scatter(component, index, FieldIndices{});
+			}
+
+			FORCEINLINE void Swap(size_t index, Entity entity)
+			{
+				const auto pos = this->SwapDense(index, entity);
+				std::apply([index, pos](auto& ...columns) { (std::swap(columns[index], columns[pos]), ...); }, m_columns);
+			}
+
+			/**
+			 * \brief Field F of every component, in dense order
+			 */
+			template<size_t F>
+			std::span<FieldType<F>> GetColumn()
+			{
+				return { std::get<F>(m_columns).data(), std::get<F>(m_columns).size() };
+			}
+
+			std::tuple<Reference> GetDataAtIndex(size_t index)
+			{
+				return { At(index, FieldIndices{}) };
+			}
+
+			std::tuple<ConstReference> PeekAtIndex(size_t index) const
+			{
+				return { At(index, FieldIndices{}) };
+			}
+
+			size_t GetSize() const
+			{
+				return this->m_dense.size();
+			}
+
+		private:
+			typedef typename SparseSet<Entity>::Traits Traits;
+
+			template<size_t... Fs>
+			Reference At(size_t index, std::index_sequence<Fs...>)
+			{
+				return Reference(std::get<Fs>(m_columns)[index]...);
+			}
+
+			template<size_t... Fs>
+			ConstReference At(size_t index, std::index_sequence<Fs...>) const
+			{
+				return ConstReference(std::get<Fs>(m_columns)[index]...);
+			}
+
+			template<size_t... Fs>
+			void Append(const ComponentType& component, std::index_sequence<Fs...>)
+			{
+				(std::get<Fs>(m_columns).push_back(component.*std::get<Fs>(Layout::Pointers)), ...);
+			}
+
+			template<size_t... Fs>
+			void Gather(ComponentType& component, size_t index, std::index_sequence<Fs...>) const
+			{
+				((component.*std::get<Fs>(Layout::Pointers) = std::get<Fs>(m_columns)[index]), ...);
+			}
+
+			template<size_t... Fs>
+			void Scatter(const ComponentType& component, size_t index, std::index_sequence<Fs...>)
+			{
+				((std::get<Fs>(m_columns)[index] = component.*std::get<Fs>(Layout::Pointers)), ...);
+			}
+
+			bool PrepareInsert(Entity id)
+			{
+				return SparseSet<Entity>::PrepareInsert(id, [this](Entity stale) { RemoveComponent(stale); });
+			}
+
+			Columns m_columns;
+		};
+	}
+}
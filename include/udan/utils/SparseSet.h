@@ -1,8 +1,26 @@
 ﻿#pragma once
 #include <typeindex>
 #include <vector>
+#include <algorithm>
 #include <array>
-#include "udan/utils/utils.h"
+#include <cassert>
+#include <climits>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "udan/utils/CacheLine.h"
+#include "udan/utils/ChangeTracking.h"
+#include "udan/utils/ComponentSignatures.h"
+#include "udan/utils/EntityTraits.h"
+#include "udan/utils/MembershipFilter.h"
+#include "udan/utils/PagedSparseArray.h"
+#include "udan/utils/ParallelFor.h"
+#include "udan/utils/ReservedVector.h"
 #include "udan/utils/ThreadPool.h"
 #include "udan/utils/Task.h"
 
@@ -10,33 +28,361 @@ namespace udan
 {
 	namespace utils
 	{
+		/**
+		 * \brief Notified when an entity gains or loses its entry in a set, used by groups to keep their entities packed
+		 */
 		template<typename Entity>
+		class ASparseSetObserver
+		{
+		public:
+			virtual ~ASparseSetObserver() = default;
+			/**
+			 * \brief Called once entity was appended to the set
+			 */
+			virtual void OnConstruct(Entity entity) = 0;
+			/**
+			 * \brief Called before entity is removed from the set, it may still be moved inside the dense array
+			 */
+			virtual void OnDestroy(Entity entity) = 0;
+		};
+
+		/**
+		 * \brief Maps entity handles to dense positions.
+		 * The sparse index is keyed by the slot index of the handle, the whole id for plain integers, and the dense array
+		 * keeps the full handle: with VersionedEntityTraits a handle whose slot was recycled by an EntityRegistry no longer matches.
+		 * \tparam Allocator Allocator of the dense array, ReservedAllocator stores it in a ReservedVector that never relocates
+		 */
+		template<typename Entity, typename Allocator = std::allocator<Entity>>
 		class SparseSet {
 		protected:
-			std::vector<Entity> m_sparse;
-			std::vector<Entity> m_dense;
-			std::queue<Entity> m_freeEntities;
-			size_t m_noEntity;
+			typedef EntityTraits<Entity> Traits;
+
+			PagedSparseArray<Entity> m_sparse;
+			DenseVector<Entity, Allocator> m_dense;
+			ASparseSetObserver<Entity>* m_observer = nullptr;
+			ComponentSignatures<Entity>* m_signatures = nullptr;
+			ComponentMask m_signatureBit = 0;
+			static constexpr Entity m_noEntity = PagedSparseArray<Entity>::Null;
 
 		public:
-			explicit SparseSet(size_t capacity = 512) : m_sparse(capacity, capacity - 1)
+			/**
+			 * \param capacity Expected entity range, only sizes the page table, pages are allocated on first use
+			 */
+			explicit SparseSet(size_t capacity = 512, const Allocator& allocator = Allocator()) : m_dense(allocator)
+			{
+				m_sparse.Reserve(capacity);
+			}
+
+			// The observer and signatures are bound to this instance, copies start without them
+			SparseSet(const SparseSet& other) : m_sparse(other.m_sparse), m_dense(other.m_dense)
+			{}
+
+			// The signature binding follows the entities, the observer stays with the moved from set
+			SparseSet(SparseSet&& other) noexcept :
+				m_sparse(std::move(other.m_sparse)),
+				m_dense(std::move(other.m_dense)),
+				m_signatures(std::exchange(other.m_signatures, nullptr)),
+				m_signatureBit(std::exchange(other.m_signatureBit, 0))
+			{}
+
+			// Keeps the signature binding of this set, the masks follow the new entities
+			SparseSet& operator=(const SparseSet& other)
+			{
+				if (this == &other)
+					return *this;
+				UnmarkSignatures();
+				m_sparse = other.m_sparse;
+				m_dense = other.m_dense;
+				if (m_signatures != nullptr)
+				{
+					for (const Entity id : m_dense)
+						m_signatures->Add(id, m_signatureBit);
+				}
+				return *this;
+			}
+
+			SparseSet& operator=(SparseSet&& other) noexcept
+			{
+				if (this == &other)
+					return *this;
+				UnmarkSignatures();
+				m_sparse = std::move(other.m_sparse);
+				m_dense = std::move(other.m_dense);
+				m_signatures = std::exchange(other.m_signatures, nullptr);
+				m_signatureBit = std::exchange(other.m_signatureBit, 0);
+				return *this;
+			}
+
+			/**
+			 * \brief A set has at most one observer, pass nullptr to detach it
+			 */
+			void SetObserver(ASparseSetObserver<Entity>* observer)
+			{
+				assert(observer == nullptr || m_observer == nullptr);
+				m_observer = observer;
+			}
+
+			ASparseSetObserver<Entity>* GetObserver() const
 			{
-				m_noEntity = capacity - 1;
+				return m_observer;
 			}
 
-			const std::vector<Entity>& Entities() const
+			/**
+			 * \brief Called by ComponentSignatures::Bind, bit is set in the mask of every entity of the set
+			 */
+			void BindSignatures(ComponentSignatures<Entity>* signatures, ComponentMask bit)
+			{
+				m_signatures = signatures;
+				m_signatureBit = bit;
+			}
+
+			ComponentSignatures<Entity>* GetSignatures() const
+			{
+				return m_signatures;
+			}
+
+			ComponentMask GetSignatureBit() const
+			{
+				return m_signatureBit;
+			}
+
+			const DenseVector<Entity, Allocator>& Entities() const
 			{
 				return m_dense;
 			}
+
+			/**
+			 * \brief Entities the dense array holds before it grows
+			 */
+			size_t GetCapacity() const
+			{
+				return m_dense.capacity();
+			}
+
+			const PagedSparseArray<Entity>& GetSparse() const
+			{
+				return m_sparse;
+			}
+
+			FORCEINLINE bool Exist(Entity id) const
+			{
+				return Find(id) != m_noEntity;
+			}
+
+			/**
+			 * \return Dense position of id, or the null entity when id is not in the set
+			 */
+			FORCEINLINE Entity Find(Entity id) const
+			{
+				// Null positions are never below the dense size
+				const Entity pos = m_sparse[Traits::Index(id)];
+				return pos < m_dense.size() && m_dense[pos] == id ? pos : m_noEntity;
+			}
+
+			/**
+			 * \brief Start loading the sparse entry of id, for lookups a few iterations ahead
+			 */
+			FORCEINLINE void Prefetch(Entity id) const
+			{
+				if (const Entity* address = m_sparse.Address(Traits::Index(id)))
+					utils::Prefetch(address);
+			}
+
+		protected:
+			// Clear the bit of the set from the masks of its entities, before they are replaced
+			void UnmarkSignatures()
+			{
+				if (m_signatures == nullptr)
+					return;
+				for (const Entity id : m_dense)
+					m_signatures->Remove(id, m_signatureBit);
+			}
+
+			/**
+			 * \brief Append id, the component storage appends at the returned position
+			 */
+			Entity AppendDense(Entity id)
+			{
+				const auto pos = static_cast<Entity>(m_dense.size());
+				m_dense.push_back(id);
+				m_sparse.Assure(Traits::Index(id)) = pos;
+				if (m_signatures != nullptr)
+					m_signatures->Add(id, m_signatureBit);
+				return pos;
+			}
+
+			/**
+			 * \brief Swap and pop id, the component storage moves its back into the returned position then pops
+			 */
+			Entity EraseDense(Entity id)
+			{
+				const Entity pos = m_sparse[Traits::Index(id)];
+				const Entity last = m_dense.back();
+				m_dense[pos] = last;
+				m_sparse.At(Traits::Index(last)) = pos;
+				m_dense.pop_back();
+				m_sparse.At(Traits::Index(id)) = m_noEntity;
+				if (m_signatures != nullptr)
+					m_signatures->Remove(id, m_signatureBit);
+				return pos;
+			}
+
+			/**
+			 * \brief Move entity to index, the component storage swaps index with the returned former position of entity
+			 */
+			Entity SwapDense(size_t index, Entity entity)
+			{
+				const Entity other = m_dense[index];
+				const Entity pos = m_sparse[Traits::Index(entity)];
+				m_sparse.At(Traits::Index(entity)) = static_cast<Entity>(index);
+				m_sparse.At(Traits::Index(other)) = pos;
+				std::swap(m_dense[index], m_dense[pos]);
+				return pos;
+			}
+
+			/**
+			 * \brief Check shared by every storage before appending id.
+			 * With versioned handles a component left behind by an older version of the slot (destroyed entity) is dropped
+			 * with remove(stale). Plain ids each have their own slot and never evict anything.
+			 * \return false when id already has a component, or when id is itself a stale handle of a newer live entity
+			 */
+			template<typename Remove>
+			bool PrepareInsert(Entity id, Remove&& remove)
+			{
+				const Entity pos = m_sparse[Traits::Index(id)];
+				if (pos == m_noEntity)
+					return true;
+				const Entity stored = m_dense[pos];
+				if (stored == id || !Traits::IsNewer(id, stored))
+					return false;
+				remove(stored);
+				return true;
+			}
+
+			/**
+			 * \return true when no handle holds the slot of id, id can then be appended without further checks
+			 */
+			bool IsSlotFree(Entity id) const
+			{
+				return m_sparse[Traits::Index(id)] == m_noEntity;
+			}
+
+			/**
+			 * \brief Remove entities in a single pass over the dense array, the remaining entities keep their order.
+			 * move(to, from) moves the component at from to to, the component storage is then resized to the returned size
+			 * \return Dense size after the removal
+			 */
+			template<typename Move>
+			size_t CompactDense(std::span<const Entity> entities, Move move)
+			{
+				for (const Entity id : entities)
+				{
+					if (!Exist(id))
+						continue;
+					m_sparse.At(Traits::Index(id)) = m_noEntity;
+					if (m_signatures != nullptr)
+						m_signatures->Remove(id, m_signatureBit);
+				}
+				size_t kept = 0;
+				for (size_t pos = 0; pos < m_dense.size(); ++pos)
+				{
+					const Entity id = m_dense[pos];
+					if (IsSlotFree(id))
+						continue;
+					if (kept != pos)
+					{
+						m_dense[kept] = id;
+						m_sparse.At(Traits::Index(id)) = static_cast<Entity>(kept);
+						move(kept, pos);
+					}
+					++kept;
+				}
+				m_dense.resize(kept);
+				return kept;
+			}
+
+			/**
+			 * \brief Remove every entity without going through the observer
+			 */
+			void ClearDense()
+			{
+				for (const Entity id : m_dense)
+				{
+					m_sparse.At(Traits::Index(id)) = m_noEntity;
+					if (m_signatures != nullptr)
+						m_signatures->Remove(id, m_signatureBit);
+				}
+				m_dense.clear();
+			}
+
+			/**
+			 * \brief Reorder the dense array as order (dense positions) and update the sparse index,
+			 * the component storage applies the same permutation
+			 */
+			void PermuteDense(const std::vector<Entity>& order)
+			{
+				std::vector<Entity> dense(order.size());
+				for (size_t pos = 0; pos < order.size(); ++pos)
+				{
+					dense[pos] = m_dense[order[pos]];
+					m_sparse.At(Traits::Index(dense[pos])) = static_cast<Entity>(pos);
+				}
+				std::copy(dense.begin(), dense.end(), m_dense.begin());
+			}
+
+			void NotifyConstruct(Entity id)
+			{
+				if (m_observer != nullptr)
+					m_observer->OnConstruct(id);
+			}
+
+			void NotifyDestroy(Entity id)
+			{
+				if (m_observer != nullptr)
+					m_observer->OnDestroy(id);
+			}
 		};
 
 
+		template<typename Func, typename Entity, typename Components>
+		struct AcceptsEntity;
+
+		template<typename Func, typename Entity, typename ...Components>
+		struct AcceptsEntity<Func, Entity, std::tuple<Components...>> : std::is_invocable<Func&, Entity, Components...>
+		{};
+
+		/**
+		 * \brief Call func(components...) or func(entity, components...) depending on what func accepts
+		 */
+		template<typename Func, typename Entity, typename Components>
+		FORCEINLINE void InvokeWithComponents(Func& func, Entity entity, Components&& components)
+		{
+			if constexpr (AcceptsEntity<Func, Entity, std::decay_t<Components>>::value)
+				std::apply(func, std::tuple_cat(std::make_tuple(entity), std::forward<Components>(components)));
+			else
+				std::apply(func, std::forward<Components>(components));
+		}
+
+		/**
+		 * \brief Components at a dense position, as views fetch them.
+		 * Datasets a view holds as const are read through PeekAtIndex and never stamped as changed
+		 */
 		template<typename Dataset>
 		auto GetDataAtIndex(Dataset& dataset, size_t index)
 		{
-			return dataset.GetDataAtIndex(index);
+			if constexpr (std::is_const_v<Dataset>)
+				return dataset.PeekAtIndex(index);
+			else
+				return dataset.GetDataAtIndex(index);
 		}
 
+		/**
+		 * \brief Whether fetching from Dataset stamps changes: a non const DataSet with ChangeTracking.
+		 * Stamps and the change log are not synchronized, ParallelEach refuses such datasets
+		 */
+		template<typename Dataset>
+		inline constexpr bool StampsChanges = !std::is_const_v<Dataset> && requires(Dataset& dataset) { dataset.GetChanges(); };
+
 		template<typename Entity, typename Dataset, size_t N = 0>
 		auto GetDataAtIndexes(Dataset& dataset, const std::vector<std::vector<Entity>>& indexes,  size_t index)
 		{
@@ -49,6 +395,18 @@ namespace udan
 			return dataset.GetSize();
 		}
 
+		/**
+		 * \brief Growth of the bulk inserts: nothing while size fits, else Reserve at least twice the capacity.
+		 * Reserving exactly GetSize() + batch would reallocate on every small batch and copy the set each time
+		 */
+		template<typename Dataset>
+		void ReserveFor(Dataset& dataset, size_t size)
+		{
+			const size_t capacity = dataset.GetCapacity();
+			if (size > capacity)
+				dataset.Reserve(std::max(size, capacity * 2));
+		}
+
 		template<typename Entity, typename Dataset>
 		bool EntityExist(Entity e, const Dataset& dataset)
 		{
@@ -69,7 +427,7 @@ namespace udan
 		}
 
 		template <typename Entity, class Tuple, size_t N = 0>
-		const std::vector<Entity>& RuntimeGet(Tuple& tup, size_t idx) {
+		std::span<const Entity> RuntimeGet(Tuple& tup, size_t idx) {
 			if (N == idx) {
 				return std::get<N>(tup).Entities();
 			}
@@ -91,181 +449,86 @@ namespace udan
 		public:
 			DataSetView(const std::vector<Entity>& m_entities, Datasets& ...datasets) : m_datasets(std::make_tuple(std::ref(datasets)...))
 			{
-
-				//std::vector<Entity> matches;
-				//{
-				//	const udan::utils::Timer timer;
-				//	for (const auto entity : m_entities)
-				//	{
-				//		std::vector<bool> exists = { EntityExist(entity, std::get<Datasets&>(m_datasets)) ... };
-				//		bool match = true;
-				//		for (bool ee : exists)
-				//		{
-				//			if (!ee)
-				//			{
-				//				match = false;
-				//				break;
-				//			}
-				//		}
-				//		if (match)
-				//		{
-				//			matches.push_back(entity);
-				//		}
-				//	}
-				//	const auto execTime = timer.GetDeltaTime();
-				//	LOG_INFO("Match Time: (fps {}) {}s", 1.0 / execTime, execTime);
-				//}
-
+				const std::array<size_t, sizeof...(Datasets)> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
+				size_t result = sizes[0];
+				int index = 0;
+				for (int i = 1; i < sizes.size(); ++i)
 				{
-					udan::utils::Timer timer;
-
-					std::vector<size_t> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
-					size_t result = sizes[0];
-					int index = 0;
-					for (int i = 1; i < sizes.size(); ++i)
+					if (sizes[i] < result)
 					{
-						if (sizes[i] < result)
-						{
-							result = sizes[i];
-							index = i;
-						}
+						result = sizes[i];
+						index = i;
 					}
-					auto execTime = timer.GetDeltaTime();
-					std::cout << fmt::format("ECS Find lowest: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					timer.Reset();
-					auto entities = RuntimeGet<Entity, decltype(m_datasets)>(m_datasets, index);
-					execTime = timer.GetDeltaTime();
-					std::cout << fmt::format("ECS RuntimeGet: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					index = 0;
-					timer.Reset();
-					for (const auto entity : entities)
+				}
+				const auto& entities = RuntimeGet<Entity, decltype(m_datasets)>(m_datasets, index);
+				if constexpr (SupportsMembershipFilter<Entity, Datasets...>)
+				{
+					// Batch filter the driver entities against every other dataset
+					const MembershipProbe all[] = { MakeMembershipProbe(datasets)... };
+					MembershipProbe probes[sizeof...(Datasets)];
+					size_t probeCount = 0;
+					for (size_t i = 0; i < sizeof...(Datasets); ++i)
 					{
-						std::vector<bool> exists = { EntityExist(entity, std::get<Datasets&>(m_datasets)) ... };
-						bool match = true;
-						for (bool ee : exists)
-						{
-							if (!ee)
-							{
-								std::cout << "=========================" << std::endl;
-								std::cout << entity << std::endl;
-								match = false;
-								goto NextLoop;
-							}
-						}
-						{
-							std::array<Entity, sizeof...(Datasets)> componentIndexes = { GetComponentId(entity, std::get<Datasets&>(m_datasets)) ... };
-							m_entityIndexes.push_back(componentIndexes);
-							index++;
-						}
-						//matches.push_back(entity);
-						//std::vector<bool> exists = { SwapEntity(index, entity, std::get<Datasets&>(m_datasets)) ... };
-					NextLoop: continue;
+						if (i != static_cast<size_t>(index))
+							probes[probeCount++] = all[i];
 					}
-					execTime = timer.GetDeltaTime();
-					std::cout << fmt::format("ECS Match Time: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					//LOG_DEBUG("Match Time: (fps {}) {}s", 1.0 / execTime, execTime);
+					ScratchScope scratch(ThreadPool::GetScratch());
+					std::pmr::vector<uint32_t> matches(entities.size(), scratch.GetResource());
+					matches.resize(FilterMembers(entities.data(), entities.size(), probes, probeCount, matches.data()));
+					m_entityIndexes.reserve(matches.size());
+					for (const uint32_t match : matches)
+						m_entityIndexes.push_back({ GetComponentId(entities[match], std::get<Datasets&>(m_datasets)) ... });
 				}
-
-				/*{
-					const udan::utils::Timer timer;
-					m_start = 0;
-					m_end = matches.size();
-					for (size_t i = 0; i < matches.size(); ++i)
+				else
+				{
+					for (const auto entity : entities)
 					{
-						std::vector<bool> exists = { SwapEntity(i, matches[i], std::get<Datasets&>(m_datasets)) ... };
+						if ((EntityExist(entity, std::get<Datasets&>(m_datasets)) && ...))
+							m_entityIndexes.push_back({ GetComponentId(entity, std::get<Datasets&>(m_datasets)) ... });
 					}
-					const auto execTime = timer.GetDeltaTime();
-					std::cout << fmt::format("ECS Sort Time: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					LOG_DEBUG("Sort Time: (fps {}) {}s", 1.0 / execTime, execTime);
-				}*/
+				}
 			}
 
 			DataSetView(const std::vector<Entity>& m_entities, utils::ThreadPool& threadPool, Datasets& ...datasets) : m_datasets(std::make_tuple(std::ref(datasets)...))
 			{
+				const std::array<size_t, sizeof...(Datasets)> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
+				size_t result = sizes[0];
+				int index = 0;
+				for (int i = 1; i < sizes.size(); ++i)
 				{
-					//udan::utils::Timer timer;
-
-					std::vector<size_t> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
-					size_t result = sizes[0];
-					int index = 0;
-					for (int i = 1; i < sizes.size(); ++i)
-					{
-						if (sizes[i] < result)
-						{
-							result = sizes[i];
-							index = i;
-						}
-					}
-					//auto execTime = timer.GetDeltaTime();
-					//std::cout << fmt::format("ECS Find lowest: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					//timer.Reset();
-					auto entities = RuntimeGet<Entity, decltype(m_datasets)>(m_datasets, index);
-					//execTime = timer.GetDeltaTime();
-					//std::cout << fmt::format("ECS RuntimeGet: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					index = 0;
-					//timer.Reset();
-					const size_t thread_count = threadPool.GetThreadCount();
-					auto totalSize = entities.size();
-					m_entityIndexes.reserve(totalSize);
-					const size_t index_per_thread = totalSize / thread_count;
-					std::vector<std::shared_ptr<utils::ATask>> tasks;
-					tasks.reserve(thread_count);
-					std::vector<std::vector<Entity>> results(thread_count);
-					for (size_t ti = 0; ti < thread_count; ++ti)
+					if (sizes[i] < result)
 					{
-						const size_t start = ti * index_per_thread;
-						size_t end = start + index_per_thread;
-						if (end > totalSize || (ti == thread_count - 1 && end < totalSize))
-							end = totalSize;
-						tasks.push_back(std::make_shared<udan::utils::DependencyTask>(
-							[&results, &entities, this, start, end, ti]() {
-								for (size_t i = start; i < end; i++)
-								{
-									auto entity = entities[i];
-									std::vector<bool> exists = { EntityExist(entity, std::get<Datasets&>(m_datasets)) ... };
-									for (bool ee : exists)
-									{
-										if (!ee)
-										{
-											std::cout << "=========================" << std::endl;
-											std::cout << entity << std::endl;
-											results[ti].push_back(entity);
-											break;
-										}
-									}
-								}
-							}
-						));
+						result = sizes[i];
+						index = i;
 					}
-					for (const auto& task : tasks)
-					{
-						threadPool.Schedule(task);
-					}
-					threadPool.WaitUntilQueueEmpty();
-					//execTime = timer.GetDeltaTime();
-					//std::cout << fmt::format("ECS Match Time: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					//timer.Reset();
-					for (size_t ti = 0; ti < thread_count; ++ti)
+				}
+				const auto& entities = RuntimeGet<Entity, decltype(m_datasets)>(m_datasets, index);
+				const size_t threadCount = std::max<size_t>(threadPool.GetThreadCount(), 1);
+				const size_t grain = std::max<size_t>((entities.size() + threadCount - 1) / threadCount, 1);
+				// Every chunk writes its matches at the start of its own range, the ranges are then packed in chunk order
+				// to keep the serial order. Only the match counts are temporary and they live in the scratch arena
+				ScratchScope scratch(ThreadPool::GetScratch());
+				std::pmr::vector<size_t> counts((entities.size() + grain - 1) / grain, scratch.GetResource());
+				m_entityIndexes.resize(entities.size());
+				ParallelFor(threadPool, entities.size(), grain, [&](size_t begin, size_t end)
 					{
-						auto result = results[ti];
-						const size_t start = ti * index_per_thread;
-						size_t end = start + index_per_thread;
-						if (end > totalSize || (ti == thread_count - 1 && end < totalSize))
-							end = totalSize;
-						if (result.size() == 0)
+						size_t count = 0;
+						for (size_t i = begin; i < end; i++)
 						{
-							for (size_t i = start; i < end; i++)
-							{
-								std::array<Entity, sizeof...(Datasets)> componentIndexes = { GetComponentId(entities[i], std::get<Datasets&>(m_datasets)) ... };
-								m_entityIndexes.push_back(componentIndexes);
-								index++;
-							}
+							const auto entity = entities[i];
+							if ((EntityExist(entity, std::get<Datasets&>(m_datasets)) && ...))
+								m_entityIndexes[begin + count++] = { GetComponentId(entity, std::get<Datasets&>(m_datasets)) ... };
 						}
-					}
-					//execTime = timer.GetDeltaTime();
-					//std::cout << fmt::format("ECS Indexing Time: (fps {}) {}s", 1.0 / execTime, execTime) << std::endl;
-					//LOG_DEBUG("Match Time: (fps {}) {}s", 1.0 / execTime, execTime);
+						counts[begin / grain] = count;
+					});
+				size_t packed = 0;
+				for (size_t chunk = 0; chunk < counts.size(); ++chunk)
+				{
+					const auto first = m_entityIndexes.begin() + chunk * grain;
+					std::copy(first, first + counts[chunk], m_entityIndexes.begin() + packed);
+					packed += counts[chunk];
 				}
+				m_entityIndexes.resize(packed);
 			}
 
 			auto Get(size_t index) const
@@ -282,9 +545,30 @@ namespace udan
 					std::get<Is>(indexes))...);
 			}
 
+			size_t GetMatchCount() const
+			{
+				return m_entityIndexes.size();
+			}
+
+			/**
+			 * \brief Call func(components&...) or func(entity, components&...) for every match, chunks of grain matches run on the pool.
+			 * Unavailable when a dataset has ChangeTracking, its stamps would be written from several threads
+			 */
+			template<typename Func>
+			void ParallelEach(ThreadPool& threadPool, const Func& func, size_t grain = 1024)
+			{
+				static_assert(!(StampsChanges<Datasets> || ...), "ParallelEach cannot stamp changes concurrently, use Each on views of tracked datasets");
+				ParallelFor(threadPool, m_entityIndexes.size(), grain, [this, &func](size_t begin, size_t end)
+					{
+						const auto& entities = std::get<0>(m_datasets).Entities();
+						for (size_t i = begin; i < end; ++i)
+							InvokeWithComponents(func, entities[m_entityIndexes[i][0]], Get(i));
+					});
+			}
+
 			size_t GetSize()
 			{
-				std::vector<size_t> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
+				const std::array<size_t, sizeof...(Datasets)> sizes = { GetDataSize(std::get<Datasets&>(m_datasets)) ... };
 				size_t result = UINT_MAX;
 				for (auto s : sizes)
 				{
@@ -386,101 +670,321 @@ namespace udan
 			}
 		};
 
-		template<typename Entity, typename ComponentType>
-		class DataSet : public  SparseSet<Entity> {
-			std::vector<ComponentType> m_denseComponent;
+		/**
+		 * \brief Components stored densely next to their entities.
+		 * \tparam Tracking ChangeTracking<Entity> to stamp and log changes, the default NoChangeTracking costs nothing
+		 * \tparam Allocator Allocator of the component and entity arrays, e.g. HugePageAllocator for large sets, ArenaAllocator
+		 * for frame scoped ones or ReservedAllocator for sets that must grow without ever relocating
+		 */
+		template<typename Entity, typename ComponentType, typename Tracking = NoChangeTracking<Entity>,
+			typename Allocator = std::allocator<ComponentType>>
+		class DataSet : public  SparseSet<Entity, typename std::allocator_traits<Allocator>::template rebind_alloc<Entity>> {
+			typedef SparseSet<Entity, typename std::allocator_traits<Allocator>::template rebind_alloc<Entity>> Base;
+
+			DenseVector<ComponentType, Allocator> m_denseComponent;
+			UDAN_NO_UNIQUE_ADDRESS Tracking m_changes;
 
 			using ValueType = ComponentType;
-			using Iterator = DatasetIterator<DataSet<Entity, ComponentType>>;
+			using Iterator = DatasetIterator<DataSet<Entity, ComponentType, Tracking, Allocator>>;
 
 		public:
-			explicit DataSet(size_t capacity = 512) : SparseSet<Entity>(capacity)
+			explicit DataSet(size_t capacity = 512, const Allocator& allocator = Allocator()) :
+				Base(capacity, allocator),
+				m_denseComponent(allocator)
 			{
 				m_denseComponent.reserve(capacity);
 			}
 
-			FORCEINLINE void PushBack(Entity id, ComponentType& component)
+			FORCEINLINE void PushBack(Entity id, const ComponentType& component)
 			{
-				if (this->m_sparse[id] != this->m_noEntity)
+				if (!PrepareInsert(id))
 				{
 					return; //Component already exist
 				}
-				size_t pos = m_denseComponent.size();
 				m_denseComponent.push_back(component);
-				this->m_dense.push_back(id);
-				this->m_sparse[id] = pos;
+				this->AppendDense(id);
+				m_changes.Append(id);
+				this->NotifyConstruct(id);
 			}
 
 			template<typename ...Args>
 			FORCEINLINE void EmplaceBack(Entity id, Args&& ...args)
 			{
-				if (this->m_sparse[id] != this->m_noEntity)
+				if (!PrepareInsert(id))
 				{
 					return; //Component already exist
 				}
-				size_t pos = m_denseComponent.size();
 				if constexpr (std::is_aggregate_v<ComponentType>) {
 					m_denseComponent.push_back(ComponentType{ std::forward<Args>(args)... });
 				}
 				else {
 					m_denseComponent.emplace_back(std::forward<Args>(args)...);
 				}
-				this->m_dense.push_back(id);
-				this->m_sparse[id] = pos;
+				this->AppendDense(id);
+				m_changes.Append(id);
+				this->NotifyConstruct(id);
 			}
 
 			void RemoveComponent(Entity entity)
 			{
-				const auto last = m_denseComponent.back();
-				std::swap(m_denseComponent.back(), m_denseComponent[this->m_sparse[entity]]);
-				std::swap(this->m_sparse[last], this->m_sparse[entity]);
+				if (!this->Exist(entity))
+				{
+					return;
+				}
+				this->NotifyDestroy(entity);
+				const auto pos = this->EraseDense(entity);
+				m_denseComponent[pos] = std::move(m_denseComponent.back());
 				m_denseComponent.pop_back();
-				this->m_sparse[entity] = this->m_noEntity;
-				this->m_freeEntities.push(entity);
+				m_changes.Erase(pos, entity);
+			}
+
+			/**
+			 * \brief Grow the storage once for capacity components.
+			 * With ReservedAllocator the arrays never reallocate, growing commits their next huge page in place
+			 */
+			void Reserve(size_t capacity)
+			{
+				this->m_dense.reserve(capacity);
+				m_denseComponent.reserve(capacity);
+				m_changes.Reserve(capacity);
 			}
 
+			/**
+			 * \brief PushBack of every entity with the component at the same position, the storage grows at most once.
+			 * Input iterators are read in a single pass, pass a std::move_iterator to move the components instead of copying them
+			 */
+			template<std::input_iterator ComponentIt>
+			void InsertRange(std::span<const Entity> entities, ComponentIt components)
+			{
+				ReserveFor(*this, GetSize() + entities.size());
+				size_t i = 0;
+				if (this->m_observer == nullptr)
+				{
+					// Leading run of free slots: no check nor notification per entity
+					if constexpr (std::forward_iterator<ComponentIt>)
+					{
+						// Handles first, then their components in one copy
+						for (; i < entities.size() && this->IsSlotFree(entities[i]); ++i)
+						{
+							this->AppendDense(entities[i]);
+							m_changes.Append(entities[i]);
+						}
+						m_denseComponent.insert(m_denseComponent.end(), components, std::next(components, i));
+						std::advance(components, i);
+					}
+					else
+					{
+						for (; i < entities.size() && this->IsSlotFree(entities[i]); ++i, ++components)
+						{
+							m_denseComponent.push_back(*components);
+							this->AppendDense(entities[i]);
+							m_changes.Append(entities[i]);
+						}
+					}
+				}
+				for (; i < entities.size(); ++i, ++components)
+				{
+					if (!PrepareInsert(entities[i]))
+						continue;
+					m_denseComponent.push_back(*components);
+					this->AppendDense(entities[i]);
+					m_changes.Append(entities[i]);
+					this->NotifyConstruct(entities[i]);
+				}
+			}
+
+			void InsertRange(std::span<const Entity> entities, std::span<const ComponentType> components)
+			{
+				assert(entities.size() == components.size());
+				InsertRange(entities, components.begin());
+			}
+
+			/**
+			 * \brief RemoveComponent of every entity.
+			 * Large ranges compact the set in a single pass instead, the remaining components then keep their order
+			 */
+			void RemoveRange(std::span<const Entity> entities)
+			{
+				// Swap and pop touches random positions, one pass wins once a quarter of the set goes
+				if (this->m_observer == nullptr && entities.size() * 4 >= GetSize())
+				{
+					if constexpr (Tracking::Enabled)
+					{
+						for (const Entity entity : entities)
+						{
+							if (this->Exist(entity))
+								m_changes.LogRemoved(entity);
+						}
+					}
+					const size_t size = this->CompactDense(entities, [this](size_t to, size_t from)
+						{
+							m_denseComponent[to] = std::move(m_denseComponent[from]);
+							m_changes.Move(to, from);
+						});
+					m_denseComponent.erase(m_denseComponent.begin() + size, m_denseComponent.end());
+					m_changes.Truncate(size);
+					return;
+				}
+				for (const Entity entity : entities)
+					RemoveComponent(entity);
+			}
+
+			void Clear()
+			{
+				if (this->m_observer != nullptr)
+				{
+					// Back to front so that no removal moves a component
+					while (!this->m_dense.empty())
+						RemoveComponent(this->m_dense.back());
+					return;
+				}
+				m_changes.Clear(this->m_dense);
+				this->ClearDense();
+				m_denseComponent.clear();
+			}
+
+			/**
+			 * \brief Sort with compare taking two components, or two entities.
+			 * A set owned by a group cannot be sorted, the group keeps its own order
+			 * \return false, leaving the set untouched, when an observer is attached
+			 */
+			template<typename Compare>
+			bool Sort(Compare compare)
+			{
+				if (this->m_observer != nullptr)
+					return false;
+				std::vector<Entity> order(GetSize());
+				std::iota(order.begin(), order.end(), Entity(0));
+				if constexpr (std::is_invocable_r_v<bool, Compare&, const ComponentType&, const ComponentType&>)
+					std::sort(order.begin(), order.end(), [this, &compare](Entity a, Entity b) { return compare(m_denseComponent[a], m_denseComponent[b]); });
+				else
+					std::sort(order.begin(), order.end(), [this, &compare](Entity a, Entity b) { return compare(this->m_dense[a], this->m_dense[b]); });
+
+				DenseVector<ComponentType, Allocator> components(m_denseComponent.get_allocator());
+				components.reserve(m_denseComponent.capacity());
+				for (const Entity pos : order)
+					components.push_back(std::move(m_denseComponent[pos]));
+				m_denseComponent = std::move(components);
+				m_changes.Permute(order);
+				this->PermuteDense(order);
+				return true;
+			}
+
+			/**
+			 * \brief Put the entities shared with other first, in the order of other, so that joined iterations walk both
+			 * sets sequentially. The other entities follow in no particular order
+			 * \return false, leaving the set untouched, when an observer is attached
+			 */
+			template<typename OtherAllocator>
+			bool SortAs(const SparseSet<Entity, OtherAllocator>& other)
+			{
+				if (this->m_observer != nullptr)
+					return false;
+				size_t pos = 0;
+				for (const Entity id : other.Entities())
+				{
+					if (this->Exist(id))
+						Swap(pos++, id);
+				}
+				return true;
+			}
+
+			/**
+			 * \brief Mutable access, stamps the component as updated when changes are tracked
+			 */
 			ComponentType& GetComponent(Entity id)
 			{
-				return m_denseComponent[this->m_sparse[id]];
+				const Entity pos = this->m_sparse[Traits::Index(id)];
+				m_changes.Touch(pos, id);
+				return m_denseComponent[pos];
 			}
 
-			Entity GetComponentId(Entity id)
+			/**
+			 * \brief Read only access, never stamps
+			 */
+			const ComponentType& Peek(Entity id) const
 			{
-				return this->m_sparse[id];
+				return m_denseComponent[this->m_sparse[Traits::Index(id)]];
 			}
 
-			FORCEINLINE bool Exist(Entity id) const
+			Entity GetComponentId(Entity id)
 			{
-				return this->m_sparse[id] != this->m_noEntity;
+				return this->m_sparse[Traits::Index(id)];
 			}
 
 			FORCEINLINE void Swap(size_t index, Entity entity)
 			{
-				auto e1 = entity;
-				auto e2 = this->m_dense[index];
-
-				auto p1 = this->m_sparse[e1];
-				this->m_sparse[e1] = index;
-				this->m_sparse[e2] = p1;
+				const auto pos = this->SwapDense(index, entity);
+				std::swap(m_denseComponent[index], m_denseComponent[pos]);
+				m_changes.Swap(index, pos);
+			}
 
-				std::swap(this->m_dense[index], this->m_dense[p1]);
-				std::swap(m_denseComponent[index], m_denseComponent[p1]);
+			/**
+			 * \brief Every component, stamped as updated when changes are tracked
+			 */
+			FORCEINLINE DenseVector<ComponentType, Allocator>& GetData()
+			{
+				m_changes.TouchAll(this->m_dense);
+				return m_denseComponent;
 			}
 
-			FORCEINLINE std::vector<ComponentType>& GetData()
+			/**
+			 * \brief Every component, read only, never stamps
+			 */
+			std::span<const ComponentType> GetComponents() const
 			{
 				return m_denseComponent;
 			}
 
 			std::tuple<ComponentType&> GetDataAtIndex(size_t index)
+			{
+				m_changes.Touch(index, this->m_dense[index]);
+				return { m_denseComponent[index] };
+			}
+
+			/**
+			 * \brief GetDataAtIndex without stamping
+			 */
+			std::tuple<const ComponentType&> PeekAtIndex(size_t index) const
 			{
 				return { m_denseComponent[index] };
 			}
 
+			/**
+			 * \brief Stamps and change log, only with ChangeTracking.
+			 * Call SetTick on it every frame before touching components
+			 */
+			Tracking& GetChanges() requires Tracking::Enabled
+			{
+				return m_changes;
+			}
+
+			const Tracking& GetChanges() const requires Tracking::Enabled
+			{
+				return m_changes;
+			}
+
+			/**
+			 * \return true when id was added or obtained mutably after tick
+			 */
+			bool ChangedSince(Entity id, uint32_t tick) const requires Tracking::Enabled
+			{
+				const Entity pos = this->Find(id);
+				return pos != this->m_noEntity && m_changes.GetStamp(pos) > tick;
+			}
+
 			size_t GetSize() const
 			{
 				return  m_denseComponent.size();
 			}
+
+		private:
+			typedef typename Base::Traits Traits;
+
+			bool PrepareInsert(Entity id)
+			{
+				return Base::PrepareInsert(id, [this](Entity stale) { RemoveComponent(stale); });
+			}
 		};
 	}
 }
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <windows.h>
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Exponential backoff used before blocking: pause instructions first, then yield the time slice
+		 */
+		class SpinWait
+		{
+		public:
+			static constexpr uint32_t PauseCount = 10;
+			static constexpr uint32_t YieldCount = 20;
+
+			/**
+			 * \brief Back off once
+			 * \return false once the caller should stop spinning and block
+			 */
+			bool SpinOnce()
+			{
+				if (m_count < PauseCount)
+				{
+					for (uint32_t i = 0; i < (1u << m_count); ++i)
+					{
+						YieldProcessor();
+					}
+				}
+				else if (m_count < YieldCount)
+				{
+					std::this_thread::yield();
+				}
+				else
+				{
+					return false;
+				}
+				++m_count;
+				return true;
+			}
+
+			void Reset()
+			{
+				m_count = 0;
+			}
+
+		private:
+			uint32_t m_count = 0;
+		};
+
+		/**
+		 * \brief Lets threads sleep on an atomic word while keeping Notify free when nobody sleeps
+		 */
+		class WaitPoint
+		{
+		public:
+			/**
+			 * \brief Spin then sleep until ready() returns true, word must change whenever ready() may change
+			 */
+			template<typename T, typename Predicate>
+			void Wait(const std::atomic<T>& word, Predicate ready)
+			{
+				SpinWait spin;
+				while (!ready())
+				{
+					const T observed = word.load(std::memory_order_acquire);
+					if (ready())
+						return;
+					if (spin.SpinOnce())
+						continue;
+					m_waiters.fetch_add(1, std::memory_order_seq_cst);
+					if (!ready())
+						word.wait(observed, std::memory_order_acquire);
+					m_waiters.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+
+			/**
+			 * \brief Must be called after every store to word that can make a waiter ready
+			 */
+			template<typename T>
+			void Notify(std::atomic<T>& word)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (m_waiters.load(std::memory_order_relaxed) != 0)
+					word.notify_all();
+			}
+
+		private:
+			std::atomic<uint32_t> m_waiters{ 0 };
+		};
+	}
+}
@@ -0,0 +1,267 @@
+﻿#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "CacheLine.h"
+#include "SpinWait.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Bounded lock free queue for exactly one producer thread and one consumer thread.
+		 * Each side caches the other side's index so a push or a pop only touches the shared lines
+		 * when the cached view says the ring looks full or empty.
+		 * \tparam T Element type
+		 */
+		template<typename T>
+		class SpscRingBuffer
+		{
+			struct Slot
+			{
+				alignas(T) unsigned char storage[sizeof(T)];
+			};
+
+		public:
+			/**
+			 * \param capacity Rounded up to the next power of two
+			 */
+			explicit SpscRingBuffer(size_t capacity = 1024) :
+				m_capacity(std::bit_ceil(capacity < 2 ? size_t(2) : capacity)),
+				m_mask(m_capacity - 1),
+				m_slots(std::make_unique<Slot[]>(m_capacity))
+			{
+			}
+
+			SpscRingBuffer(const SpscRingBuffer&) = delete;
+			SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+			~SpscRingBuffer()
+			{
+				const size_t tail = m_tail.load(std::memory_order_relaxed);
+				for (size_t i = m_head.load(std::memory_order_relaxed); i != tail; ++i)
+				{
+					Element(i)->~T();
+				}
+			}
+
+			template<typename ...Args>
+			bool TryEmplace(Args&& ...args)
+			{
+				const size_t tail = m_tail.load(std::memory_order_relaxed);
+				if (tail - m_cachedHead == m_capacity)
+				{
+					m_cachedHead = m_head.load(std::memory_order_acquire);
+					if (tail - m_cachedHead == m_capacity)
+						return false;
+				}
+				new (Storage(tail)) T(std::forward<Args>(args)...);
+				m_tail.store(tail + 1, std::memory_order_release);
+				m_wait.Notify(m_tail);
+				return true;
+			}
+
+			bool TryPush(const T& value)
+			{
+				return TryEmplace(value);
+			}
+
+			bool TryPush(T&& value)
+			{
+				return TryEmplace(std::move(value));
+			}
+
+			bool TryPop(T& out)
+			{
+				return TryConsume([&out](T&& element) { out = std::move(element); });
+			}
+
+			/**
+			 * \brief TryPop for types that cannot be default constructed
+			 */
+			std::optional<T> TryPop()
+			{
+				std::optional<T> result;
+				TryConsume([&result](T&& element) { result.emplace(std::move(element)); });
+				return result;
+			}
+
+			/**
+			 * \brief Copy as many items as fit with a single publication of the tail
+			 * \return Number of items pushed, may be lower than count
+			 */
+			template<typename InputIt>
+			size_t TryPushBatch(InputIt first, size_t count)
+			{
+				const size_t tail = m_tail.load(std::memory_order_relaxed);
+				size_t free = m_capacity - (tail - m_cachedHead);
+				if (free < count)
+				{
+					m_cachedHead = m_head.load(std::memory_order_acquire);
+					free = m_capacity - (tail - m_cachedHead);
+				}
+				const size_t pushed = count < free ? count : free;
+				if (pushed == 0)
+					return 0;
+				for (size_t i = 0; i < pushed; ++i, ++first)
+				{
+					new (Storage(tail + i)) T(*first);
+				}
+				m_tail.store(tail + pushed, std::memory_order_release);
+				m_wait.Notify(m_tail);
+				return pushed;
+			}
+
+			/**
+			 * \brief Move up to maxCount items to out with a single publication of the head
+			 * \return Number of items popped
+			 */
+			template<typename OutputIt>
+			size_t TryPopBatch(OutputIt out, size_t maxCount)
+			{
+				const size_t head = m_head.load(std::memory_order_relaxed);
+				size_t available = m_cachedTail - head;
+				if (available < maxCount)
+				{
+					m_cachedTail = m_tail.load(std::memory_order_acquire);
+					available = m_cachedTail - head;
+				}
+				const size_t popped = maxCount < available ? maxCount : available;
+				if (popped == 0)
+					return 0;
+				for (size_t i = 0; i < popped; ++i, ++out)
+				{
+					T* element = Element(head + i);
+					*out = std::move(*element);
+					element->~T();
+				}
+				m_head.store(head + popped, std::memory_order_release);
+				m_wait.Notify(m_head);
+				return popped;
+			}
+
+			void Push(const T& value)
+			{
+				while (!TryPush(value))
+					m_wait.Wait(m_head, [this]() { return !Full(); });
+			}
+
+			void Push(T&& value)
+			{
+				while (!TryPush(std::move(value)))
+					m_wait.Wait(m_head, [this]() { return !Full(); });
+			}
+
+			T Pop()
+			{
+				for (;;)
+				{
+					if (std::optional<T> value = TryPop())
+						return std::move(*value);
+					m_wait.Wait(m_tail, [this]() { return !Empty(); });
+				}
+			}
+
+			template<typename InputIt>
+			void PushBatch(InputIt first, size_t count)
+			{
+				while (count != 0)
+				{
+					const size_t pushed = TryPushBatch(first, count);
+					std::advance(first, pushed);
+					count -= pushed;
+					if (count != 0)
+						m_wait.Wait(m_head, [this]() { return !Full(); });
+				}
+			}
+
+			/**
+			 * \brief Block until at least one item is available then pop up to maxCount items
+			 */
+			template<typename OutputIt>
+			size_t PopBatch(OutputIt out, size_t maxCount)
+			{
+				size_t popped;
+				while ((popped = TryPopBatch(out, maxCount)) == 0)
+					m_wait.Wait(m_tail, [this]() { return !Empty(); });
+				return popped;
+			}
+
+			[[nodiscard]] bool Empty() const
+			{
+				return Size() == 0;
+			}
+
+			[[nodiscard]] bool Full() const
+			{
+				return Size() == m_capacity;
+			}
+
+			/**
+			 * \brief Approximation when called while the other side is running, always within [0, Capacity()]
+			 */
+			[[nodiscard]] size_t Size() const
+			{
+				// Head first: the tail read after it is never behind it, so the difference cannot wrap
+				const size_t head = m_head.load(std::memory_order_acquire);
+				const size_t tail = m_tail.load(std::memory_order_acquire);
+				return tail - head < m_capacity ? tail - head : m_capacity;
+			}
+
+			[[nodiscard]] size_t Capacity() const
+			{
+				return m_capacity;
+			}
+
+		private:
+			// Take the element at the head and hand it to consume before releasing its slot
+			template<typename Consume>
+			bool TryConsume(Consume&& consume)
+			{
+				const size_t head = m_head.load(std::memory_order_relaxed);
+				if (head == m_cachedTail)
+				{
+					m_cachedTail = m_tail.load(std::memory_order_acquire);
+					if (head == m_cachedTail)
+						return false;
+				}
+				T* element = Element(head);
+				consume(std::move(*element));
+				element->~T();
+				m_head.store(head + 1, std::memory_order_release);
+				m_wait.Notify(m_head);
+				return true;
+			}
+
+			void* Storage(size_t index) const
+			{
+				return m_slots[index & m_mask].storage;
+			}
+
+			T* Element(size_t index) const
+			{
+				return std::launder(reinterpret_cast<T*>(m_slots[index & m_mask].storage));
+			}
+
+			const size_t m_capacity;
+			const size_t m_mask;
+			std::unique_ptr<Slot[]> m_slots;
+			WaitPoint m_wait;
+
+			// Consumer line
+			alignas(CacheLineSize) std::atomic<size_t> m_head{ 0 };
+			size_t m_cachedTail = 0;
+
+			// Producer line
+			alignas(CacheLineSize) std::atomic<size_t> m_tail{ 0 };
+			size_t m_cachedHead = 0;
+		};
+	}
+}
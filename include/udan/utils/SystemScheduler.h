@@ -0,0 +1,166 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "WaitGroup.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Process wide index of a new type a system can access
+		 */
+		__declspec(dllexport) size_t NextSystemResourceIndex();
+
+		template<typename Resource>
+		size_t SystemResourceIndex()
+		{
+			static const size_t s_index = NextSystemResourceIndex();
+			return s_index;
+		}
+
+		/**
+		 * \brief Types a system reads and writes, usually DataSet types.
+		 * Two systems conflict when one writes a type the other accesses, or when either is exclusive
+		 */
+		class SystemAccess
+		{
+		public:
+			template<typename ...Resources>
+			SystemAccess& Read()
+			{
+				(m_reads.push_back(SystemResourceIndex<Resources>()), ...);
+				return *this;
+			}
+
+			template<typename ...Resources>
+			SystemAccess& Write()
+			{
+				(m_writes.push_back(SystemResourceIndex<Resources>()), ...);
+				return *this;
+			}
+
+			/**
+			 * \brief Conflicts with every other system, e.g. structural changes or a CommandQueue Apply
+			 */
+			SystemAccess& Exclusive()
+			{
+				m_exclusive = true;
+				return *this;
+			}
+
+			[[nodiscard]] bool IsExclusive() const
+			{
+				return m_exclusive;
+			}
+
+			[[nodiscard]] const std::vector<size_t>& GetReads() const
+			{
+				return m_reads;
+			}
+
+			[[nodiscard]] const std::vector<size_t>& GetWrites() const
+			{
+				return m_writes;
+			}
+
+			[[nodiscard]] __declspec(dllexport) bool ConflictsWith(const SystemAccess& other) const;
+
+		private:
+			std::vector<size_t> m_reads;
+			std::vector<size_t> m_writes;
+			bool m_exclusive = false;
+		};
+
+		struct SystemTiming
+		{
+			std::string name;
+			uint64_t lastNanoseconds;
+			uint64_t averageNanoseconds;
+			uint64_t maxNanoseconds;
+			uint64_t runCount;
+		};
+
+		/**
+		 * \brief Runs systems once per frame, concurrently when their accesses do not conflict.
+		 * The result is the one of running them one after the other in the order they were added: a system waits
+		 * for the last earlier system writing what it accesses, and a writer for every earlier reader.
+		 * The dependency graph is only rebuilt after systems are added or removed.
+		 */
+		class SystemScheduler
+		{
+		public:
+			typedef size_t SystemId;
+
+			__declspec(dllexport) SystemScheduler();
+			__declspec(dllexport) ~SystemScheduler();
+
+			SystemScheduler(const SystemScheduler&) = delete;
+			SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+			__declspec(dllexport) SystemId Add(std::string name, SystemAccess access, std::function<void()> system,
+				TaskPriority priority = TaskPriority::NORMAL);
+			__declspec(dllexport) void Remove(SystemId id);
+
+			/**
+			 * \brief Run every system on the pool and return once all ran.
+			 * Must not be called from a pool task, the calling thread only waits
+			 */
+			__declspec(dllexport) void Run(ThreadPool& pool);
+			/**
+			 * \brief Run every system on the calling thread, in the order they were added
+			 */
+			__declspec(dllexport) void RunSerial();
+
+			/**
+			 * \brief Systems id waits for, rebuilds the graph when needed
+			 */
+			[[nodiscard]] __declspec(dllexport) std::vector<SystemId> GetDependencies(SystemId id);
+			[[nodiscard]] __declspec(dllexport) std::vector<SystemTiming> GetTimings() const;
+			/**
+			 * \brief Wall time of the last Run or RunSerial
+			 */
+			[[nodiscard]] __declspec(dllexport) uint64_t GetLastFrameNanoseconds() const;
+			__declspec(dllexport) void ResetTimings();
+			[[nodiscard]] __declspec(dllexport) size_t GetSystemCount() const;
+
+		private:
+			struct System
+			{
+				std::string name;
+				SystemAccess access;
+				std::function<void()> func;
+				TaskPriority priority;
+				std::vector<SystemId> dependencies;
+				std::vector<SystemId> dependents;
+				std::atomic<uint32_t> pending{ 0 };
+				// Written by the thread running the system
+				Clock::Ticks lastTicks = 0;
+				Clock::Ticks totalTicks = 0;
+				Clock::Ticks maxTicks = 0;
+				uint64_t runCount = 0;
+			};
+
+			void Build();
+			void Execute(SystemId id);
+			void RunChain(ThreadPool& pool, SystemId id, const std::shared_ptr<WaitGroup>& done);
+			void ScheduleSystem(ThreadPool& pool, SystemId id, const std::shared_ptr<WaitGroup>& done);
+
+			// Removed systems leave an empty slot so that ids stay stable
+			std::vector<std::unique_ptr<System>> m_systems;
+			std::vector<SystemId> m_roots;
+			size_t m_systemCount = 0;
+			bool m_dirty = false;
+			Clock::Ticks m_lastFrameTicks = 0;
+		};
+	}
+}
@@ -1,10 +1,12 @@
 ﻿#pragma once
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <list>
 #include <vector>
 
 
+#include "Clock.h"
 #include "CriticalSectionLock.h"
 #include "Event.h"
 
@@ -19,6 +21,7 @@ namespace udan
 			HIGH = 2,
 			CRITICAL = 3
 		};
+		constexpr size_t TaskPriorityCount = 4;
 
 		class ATask
 		{
@@ -42,7 +45,19 @@ namespace udan
 			}
 			static void ResetId()
 			{
-				m_taskId = 0;
+				m_taskId.store(0, std::memory_order_relaxed);
+			}
+
+			/**
+			 * \brief Tick at which the task was queued, used for schedule to start latency
+			 */
+			[[nodiscard]] Clock::Ticks GetScheduledTicks() const
+			{
+				return m_scheduledTicks;
+			}
+			void MarkScheduled()
+			{
+				m_scheduledTicks = Clock::Now();
 			}
 
 			void Done()
@@ -54,8 +69,10 @@ namespace udan
 			TaskPriority m_priority;
 			uint64_t m_id;
 			bool m_completed;
+			Clock::Ticks m_scheduledTicks;
 
-			static uint64_t m_taskId;
+			// Tasks are created from any thread, e.g. ParallelFor called inside a pool task
+			static std::atomic<uint64_t> m_taskId;
 		};
 
 		inline bool operator<(const std::shared_ptr<ATask>& lhs, const std::shared_ptr <ATask>& rhs)
@@ -1,13 +1,19 @@
 ﻿#pragma once
 
+#include <array>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
+#include <span>
 #include <thread>
 #include <vector>
 
 
 #include "ConditionVariable.h"
+#include "LatencyHistogram.h"
+#include "ScratchArena.h"
 #include "Task.h"
 
 namespace udan
@@ -17,6 +23,8 @@ namespace udan
 		class ThreadPool
 		{
 		public:
+			static constexpr size_t NoWorker = SIZE_MAX;
+
 			__declspec(dllexport) ThreadPool(size_t capacity);
 			/**
 			 * \brief This function finish running, then stop threads and join
@@ -32,15 +40,54 @@ namespace udan
 #if DEBUG
 			void Interrupt();
 #endif
-			__declspec(dllexport) void BulkSchedule(const std::vector<std::shared_ptr<ATask>>& task);
+			__declspec(dllexport) void BulkSchedule(std::span<const std::shared_ptr<ATask>> tasks);
 			__declspec(dllexport) void Schedule(const std::shared_ptr<ATask>& task);
 			__declspec(dllexport) void ResetTaskCount();
 			__declspec(dllexport) size_t GetThreadCount() const;
+			/**
+			 * \brief Index in [0, GetThreadCount()) of the pool thread calling, NoWorker from any other thread.
+			 * Meant to pick per worker data such as command buffers without locking
+			 */
+			__declspec(dllexport) static size_t GetWorkerIndex();
+			/**
+			 * \brief Scratch arena of the calling thread: its own for a pool worker, a thread local one for any other thread.
+			 * Allocations stay valid until the enclosing ScratchScope ends or until ResetScratch
+			 */
+			__declspec(dllexport) static ScratchArena& GetScratch();
+			/**
+			 * \brief Free the scratch arenas of every worker and of the calling thread, at a frame boundary once no task runs
+			 */
+			__declspec(dllexport) void ResetScratch();
+
+			/**
+			 * \brief Time tasks of this priority spent queued, from Schedule to the start of Exec
+			 */
+			__declspec(dllexport) LatencyHistogram GetScheduleLatency(TaskPriority priority) const;
+			/**
+			 * \brief Time tasks of this priority spent in Exec
+			 */
+			__declspec(dllexport) LatencyHistogram GetExecutionLatency(TaskPriority priority) const;
+			__declspec(dllexport) void ResetLatencies();
 
 			//void ThreadPool::Print();
 		private:
 			void ScheduleCompletedDependency(const std::shared_ptr<ATask>& task);
-			void Run();
+			void Run(size_t workerIndex);
+
+			// One shard per worker, workers record without sharing a cache line
+			struct Latencies
+			{
+				static_assert(TaskPriorityCount == 4);
+				explicit Latencies(size_t workers) :
+					schedule{ ConcurrentLatencyHistogram(workers), ConcurrentLatencyHistogram(workers),
+						ConcurrentLatencyHistogram(workers), ConcurrentLatencyHistogram(workers) },
+					execution{ ConcurrentLatencyHistogram(workers), ConcurrentLatencyHistogram(workers),
+						ConcurrentLatencyHistogram(workers), ConcurrentLatencyHistogram(workers) }
+				{}
+
+				std::array<ConcurrentLatencyHistogram, TaskPriorityCount> schedule;
+				std::array<ConcurrentLatencyHistogram, TaskPriorityCount> execution;
+			};
 			std::vector<std::thread> m_threads;
 			ConditionVariable m_cv;
 			ConditionVariable m_queueEmpty;
@@ -50,6 +97,11 @@ namespace udan
 
 			std::priority_queue<std::shared_ptr<ATask>, std::vector<std::shared_ptr<ATask>>, std::greater<>> m_tasks;
 			std::set<size_t> m_remainingTasks;
+			// Heap allocated, the histograms are too large for a pool living on the stack
+			std::unique_ptr<Latencies> m_latencies;
+			std::vector<std::unique_ptr<ScratchArena>> m_scratch;
+			static thread_local size_t s_workerIndex;
+			static thread_local ScratchArena* s_scratch;
 		};
 	}
 }
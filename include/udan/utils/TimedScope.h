@@ -1,24 +1,101 @@
 ﻿#pragma once
 
-#include <timeapi.h>
-
+#include "Clock.h"
+#include "LatencyHistogram.h"
+#include "PerfCounters.h"
 #include "udan/debug/uLogger.h"
 
 namespace udan
 {
 	namespace utils
 	{
-		template<typename Timer>
+		/**
+		 * \brief Measures the lifetime of a scope.
+		 * Logs the elapsed time when built from a name, otherwise adds the elapsed ticks to an accumulator
+		 * or records them in a histogram, which only costs two clock reads.
+		 * Hardware counters are read only when PerfCounters is enabled (logging) or explicitly requested.
+		 */
 		class TimedScope
 		{
 		public:
+			explicit TimedScope(const char* name = "TimedScope") :
+				m_name(name),
+				m_accumulator(nullptr),
+				m_histogram(nullptr),
+				m_counters(nullptr),
+				m_startCounters(PerfCounters::Read()),
+				m_start(Clock::Now())
+			{
+			}
+
+			explicit TimedScope(Clock::Ticks& accumulator) :
+				m_name(nullptr),
+				m_accumulator(&accumulator),
+				m_histogram(nullptr),
+				m_counters(nullptr),
+				m_start(Clock::Now())
+			{
+			}
+
+			/**
+			 * \brief Also adds the hardware counter deltas of the scope to counters
+			 */
+			TimedScope(Clock::Ticks& accumulator, PerfCounterValues& counters) :
+				m_name(nullptr),
+				m_accumulator(&accumulator),
+				m_histogram(nullptr),
+				m_counters(&counters),
+				m_startCounters(PerfCounters::Read()),
+				m_start(Clock::Now())
+			{
+			}
+
+			explicit TimedScope(ConcurrentLatencyHistogram& histogram) :
+				m_name(nullptr),
+				m_accumulator(nullptr),
+				m_histogram(&histogram),
+				m_counters(nullptr),
+				m_start(Clock::Now())
+			{
+			}
+
+			TimedScope(const TimedScope&) = delete;
+			TimedScope& operator=(const TimedScope&) = delete;
+
 			~TimedScope()
 			{
-				LOG_DEBUG("TimedScope: {} s", m_timer->GetDeltaTime());
+				const Clock::Ticks elapsed = Clock::Now() - m_start;
+				if (m_counters != nullptr)
+					*m_counters += PerfCounters::Read() - m_startCounters;
+				if (m_accumulator != nullptr)
+				{
+					*m_accumulator += elapsed;
+				}
+				else if (m_histogram != nullptr)
+				{
+					m_histogram->Record(elapsed);
+				}
+				else if (m_startCounters.validMask != 0)
+				{
+					const PerfCounterValues delta = PerfCounters::Read() - m_startCounters;
+					LOG_DEBUG("{}: {} s, {} cycles, IPC {:.2f}, L1D misses {}, LLC misses {}, branch misses {}",
+						m_name, Clock::ToSeconds(elapsed),
+						delta.Get(PerfCounter::CYCLES), delta.InstructionsPerCycle(),
+						delta.Get(PerfCounter::L1D_MISSES), delta.Get(PerfCounter::LLC_MISSES), delta.Get(PerfCounter::BRANCH_MISSES));
+				}
+				else
+				{
+					LOG_DEBUG("{}: {} s", m_name, Clock::ToSeconds(elapsed));
+				}
 			}
 
 		private:
-			Timer m_timer;
+			const char* m_name;
+			Clock::Ticks* m_accumulator;
+			ConcurrentLatencyHistogram* m_histogram;
+			PerfCounterValues* m_counters;
+			PerfCounterValues m_startCounters;
+			Clock::Ticks m_start;
 		};
 	}
 }
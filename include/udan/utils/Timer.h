@@ -1,7 +1,6 @@
 ﻿#pragma once
 
-#include <timeapi.h>
-#include <windows.h>
+#include "Clock.h"
 
 namespace udan
 {
@@ -10,34 +9,35 @@ namespace udan
 		class Timer
 		{
 		public:
-			explicit Timer()
+			explicit Timer() : m_start(Clock::Now())
 			{
-				timeBeginPeriod(1);
-				LARGE_INTEGER frequency;
-				QueryPerformanceFrequency(&frequency);
-				m_frequency = static_cast<double>(frequency.QuadPart);
-				m_time = GetCurrentTimeSeconds();
 			}
 
+			/**
+			 * \return Elapsed time in seconds since construction or the last Reset
+			 */
 			[[nodiscard]] double GetDeltaTime() const
 			{
-				return GetCurrentTimeSeconds() - m_time;
+				return Clock::ToSeconds(GetDeltaTicks());
 			}
 
-			void Reset()
+			[[nodiscard]] Clock::Ticks GetDeltaTicks() const
 			{
-				m_time = GetCurrentTimeSeconds();
+				return Clock::Now() - m_start;
 			}
 
-		private:
-			[[nodiscard]] double GetCurrentTimeSeconds() const
+			[[nodiscard]] uint64_t GetDeltaNanoseconds() const
+			{
+				return Clock::ToNanoseconds(GetDeltaTicks());
+			}
+
+			void Reset()
 			{
-				LARGE_INTEGER time;
-				QueryPerformanceCounter(&time);
-				return  static_cast<double>(time.QuadPart) / m_frequency;
+				m_start = Clock::Now();
 			}
-			double m_frequency;
-			double m_time;
+
+		private:
+			Clock::Ticks m_start;
 		};
 	}
 }
@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "SpinWait.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		/**
+		 * \brief Completion counter: Add the amount of pending work, every unit calls Done, Wait returns once it reaches zero
+		 */
+		class WaitGroup
+		{
+		public:
+			explicit WaitGroup(uint32_t count = 0) : m_pending(count)
+			{}
+
+			WaitGroup(const WaitGroup&) = delete;
+			WaitGroup& operator=(const WaitGroup&) = delete;
+
+			void Add(uint32_t count = 1)
+			{
+				m_pending.fetch_add(count, std::memory_order_relaxed);
+			}
+
+			void Done(uint32_t count = 1)
+			{
+				if (m_pending.fetch_sub(count, std::memory_order_acq_rel) == count)
+					m_waitPoint.Notify(m_pending);
+			}
+
+			void Wait()
+			{
+				m_waitPoint.Wait(m_pending, [this]() { return IsDone(); });
+			}
+
+			[[nodiscard]] bool IsDone() const
+			{
+				return m_pending.load(std::memory_order_acquire) == 0;
+			}
+
+		private:
+			std::atomic<uint32_t> m_pending;
+			WaitPoint m_waitPoint;
+		};
+	}
+}
@@ -1,14 +1,50 @@
 ﻿#pragma once
 
+#include "AlignedAllocator.h"
+#include "ArchetypeStorage.h"
+#include "Benchmark.h"
+#include "CacheLine.h"
+#include "ChangedDataSetView.h"
+#include "ChangeTracking.h"
+#include "Clock.h"
+#include "CommandBuffer.h"
+#include "ComponentSignatures.h"
+#include "ConcurrentDataSet.h"
 #include "ConditionVariable.h"
+#include "CpuFeatures.h"
 #include "CriticalSectionLock.h"
+#include "DoubleBufferedDataSet.h"
+#include "EntityRegistry.h"
+#include "EntityTraits.h"
+#include "EpochManager.h"
 #include "Event.h"
+#include "FixedBlockPool.h"
+#include "HugePages.h"
+#include "LatencyHistogram.h"
+#include "LazyDataSetView.h"
+#include "LinearArena.h"
+#include "MappedFile.h"
+#include "MembershipFilter.h"
+#include "MpmcQueue.h"
+#include "OwningGroup.h"
+#include "PagedSparseArray.h"
+#include "ParallelFor.h"
+#include "PerfCounters.h"
+#include "Profiler.h"
+#include "ReservedVector.h"
 #include "ScopeLock.h"
+#include "ScratchArena.h"
+#include "Snapshot.h"
+#include "SoaDataSet.h"
 #include "SparseSet.h"
 #include "SpinLock.h"
+#include "SpinWait.h"
+#include "SpscRingBuffer.h"
+#include "SystemScheduler.h"
 #include "Task.h"
 #include "ThreadPool.h"
 #include "Timer.h"
 #include "TimedScope.h"
 #include "UnnecessaryLock.h"
+#include "WaitGroup.h"
 #include "WindowsApi.h"
\ No newline at end of file
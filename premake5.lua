@@ -17,4 +17,22 @@ project "udan_utils"
         "../udan_debug/include",
         "../ThirdParties/SpdLog/include"
     }
-    
\ No newline at end of file
+    
+project "udan_utils_benchmarks"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    staticruntime "off"
+
+    files {
+        "benchmarks/**.cpp",
+        "benchmarks/**.h"
+    }
+
+    links { "udan_utils", "udan_debug" }
+
+    includedirs { 
+        "include",
+        "../udan_debug/include",
+        "../ThirdParties/SpdLog/include"
+    }
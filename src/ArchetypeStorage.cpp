@@ -0,0 +1,20 @@
+﻿#include "udan/utils/ArchetypeStorage.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace udan
+{
+	namespace utils
+	{
+		size_t NextArchetypeComponentIndex()
+		{
+			static std::atomic<size_t> s_next{ 0 };
+			const size_t index = s_next.fetch_add(1, std::memory_order_relaxed);
+			// A mask has one bit per type, a wider index would alias another type in release builds too
+			if (index >= ComponentSignatures<uint32_t>::MaxComponents)
+				throw std::length_error("More than 64 archetype component types");
+			return index;
+		}
+	}
+}
@@ -0,0 +1,167 @@
+﻿#include "udan/utils/Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "udan/debug/uLogger.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+			double Measure(const BenchmarkRunner::BenchmarkFunction& function, uint64_t iterations)
+			{
+				BenchmarkState state(iterations);
+				const Timer timer;
+				function(state);
+				const Clock::Ticks elapsed = timer.GetDeltaTicks();
+				const Clock::Ticks paused = std::min(elapsed, state.GetPausedTicks());
+				return Clock::ToSeconds(elapsed - paused);
+			}
+
+			double PercentileOf(const std::vector<double>& sorted, double percentile)
+			{
+				if (sorted.empty())
+					return 0.0;
+				const double rank = percentile / 100.0 * static_cast<double>(sorted.size() - 1);
+				const auto low = static_cast<size_t>(std::floor(rank));
+				const size_t high = std::min(low + 1, sorted.size() - 1);
+				return sorted[low] + (sorted[high] - sorted[low]) * (rank - static_cast<double>(low));
+			}
+
+			std::string EscapeJson(const std::string& value)
+			{
+				std::string escaped;
+				for (const char c : value)
+				{
+					if (c == '"' || c == '\\')
+						escaped += '\\';
+					escaped += c;
+				}
+				return escaped;
+			}
+		}
+
+		std::vector<BenchmarkResult> BenchmarkRunner::Run(std::string_view filter) const
+		{
+			std::vector<BenchmarkResult> results;
+			for (const auto& benchmark : m_benchmarks)
+			{
+				if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+					continue;
+				results.push_back(RunOne(benchmark.name, benchmark.function, benchmark.minIterations));
+				LOG_INFO("{}: {:.1f} ns/it", benchmark.name, results.back().p50);
+			}
+			return results;
+		}
+
+		BenchmarkResult BenchmarkRunner::RunOne(const std::string& name, const BenchmarkFunction& function, uint64_t minIterations) const
+		{
+			BenchmarkResult result;
+			result.name = name;
+
+			// Warmup, also gives a first estimate of the iteration cost
+			uint64_t iterations = std::max<uint64_t>(1, std::max(minIterations, m_options.minIterations));
+			const Timer warmup;
+			double sampleSeconds = Measure(function, iterations);
+			while (warmup.GetDeltaTime() < m_options.warmupSeconds || sampleSeconds < m_options.minSampleSeconds)
+			{
+				if (sampleSeconds < m_options.minSampleSeconds)
+					iterations *= 2;
+				sampleSeconds = Measure(function, iterations);
+			}
+			result.iterationsPerSample = iterations;
+
+			std::vector<double> samples;
+			samples.reserve(m_options.sampleCount);
+			uint64_t itemsPerIteration = 0;
+			for (size_t i = 0; i < m_options.sampleCount; ++i)
+			{
+				BenchmarkState state(iterations);
+				const Timer timer;
+				function(state);
+				const Clock::Ticks elapsed = timer.GetDeltaTicks();
+				const Clock::Ticks paused = std::min(elapsed, state.GetPausedTicks());
+				samples.push_back(Clock::ToSeconds(elapsed - paused) * 1e9 / static_cast<double>(iterations));
+				itemsPerIteration = state.GetItemsPerIteration();
+			}
+
+			std::sort(samples.begin(), samples.end());
+			const double q1 = PercentileOf(samples, 25.0);
+			const double q3 = PercentileOf(samples, 75.0);
+			const double low = q1 - m_options.outlierFactor * (q3 - q1);
+			const double high = q3 + m_options.outlierFactor * (q3 - q1);
+			std::vector<double> kept;
+			kept.reserve(samples.size());
+			for (const double sample : samples)
+			{
+				if (sample >= low && sample <= high)
+					kept.push_back(sample);
+			}
+			result.samples = kept.size();
+			result.outliers = samples.size() - kept.size();
+
+			double sum = 0.0;
+			for (const double sample : kept)
+				sum += sample;
+			result.mean = kept.empty() ? 0.0 : sum / static_cast<double>(kept.size());
+			double variance = 0.0;
+			for (const double sample : kept)
+				variance += (sample - result.mean) * (sample - result.mean);
+			result.stddev = kept.size() < 2 ? 0.0 : std::sqrt(variance / static_cast<double>(kept.size() - 1));
+			result.min = kept.empty() ? 0.0 : kept.front();
+			result.max = kept.empty() ? 0.0 : kept.back();
+			result.p50 = PercentileOf(kept, 50.0);
+			result.p90 = PercentileOf(kept, 90.0);
+			result.p99 = PercentileOf(kept, 99.0);
+			if (itemsPerIteration != 0 && result.p50 > 0.0)
+				result.itemsPerSecond = static_cast<double>(itemsPerIteration) * 1e9 / result.p50;
+			return result;
+		}
+
+		std::string BenchmarkRunner::ToText(const std::vector<BenchmarkResult>& results)
+		{
+			std::string text = fmt::format("{:<56} {:>12} {:>12} {:>12} {:>12} {:>8} {:>14}\n",
+				"Benchmark", "p50 (ns)", "p90 (ns)", "p99 (ns)", "stddev", "out", "items/s");
+			for (const auto& result : results)
+			{
+				text += fmt::format("{:<56} {:>12.1f} {:>12.1f} {:>12.1f} {:>12.1f} {:>8} {:>14.4g}\n",
+					result.name, result.p50, result.p90, result.p99, result.stddev, result.outliers, result.itemsPerSecond);
+			}
+			return text;
+		}
+
+		std::string BenchmarkRunner::ToJson(const std::vector<BenchmarkResult>& results)
+		{
+			std::string json = "{\n  \"benchmarks\": [\n";
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const auto& result = results[i];
+				json += fmt::format(
+					"    {{\"name\": \"{}\", \"iterations\": {}, \"samples\": {}, \"outliers\": {}, "
+					"\"mean_ns\": {}, \"stddev_ns\": {}, \"min_ns\": {}, \"p50_ns\": {}, \"p90_ns\": {}, \"p99_ns\": {}, "
+					"\"max_ns\": {}, \"items_per_second\": {}}}{}\n",
+					EscapeJson(result.name), result.iterationsPerSample, result.samples, result.outliers,
+					result.mean, result.stddev, result.min, result.p50, result.p90, result.p99,
+					result.max, result.itemsPerSecond, i + 1 < results.size() ? "," : "");
+			}
+			json += "  ]\n}\n";
+			return json;
+		}
+
+		std::string BenchmarkRunner::ToCsv(const std::vector<BenchmarkResult>& results)
+		{
+			std::string csv = "name,iterations,samples,outliers,mean_ns,stddev_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns,items_per_second\n";
+			for (const auto& result : results)
+			{
+				csv += fmt::format("\"{}\",{},{},{},{},{},{},{},{},{},{},{}\n",
+					result.name, result.iterationsPerSample, result.samples, result.outliers,
+					result.mean, result.stddev, result.min, result.p50, result.p90, result.p99,
+					result.max, result.itemsPerSecond);
+			}
+			return csv;
+		}
+	}
+}
@@ -0,0 +1,76 @@
+﻿#include "udan/utils/Clock.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		const Clock::Calibration& Clock::GetCalibration()
+		{
+			// Function local: initialized by the first caller, even one running in another static initializer
+			static const Calibration s_calibration = Calibrate();
+			return s_calibration;
+		}
+
+		Clock::Ticks Clock::ReadFallback()
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER time;
+			QueryPerformanceCounter(&time);
+			return static_cast<Ticks>(time.QuadPart);
+#else
+			timespec time;
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			return static_cast<Ticks>(time.tv_sec) * 1000000000ull + static_cast<Ticks>(time.tv_nsec);
+#endif
+		}
+
+		uint64_t Clock::FallbackFrequency()
+		{
+#if defined(_WIN32)
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			return static_cast<uint64_t>(frequency.QuadPart);
+#else
+			return 1000000000ull;
+#endif
+		}
+
+		Clock::Calibration Clock::Calibrate()
+		{
+			Calibration calibration{};
+			calibration.frequency = FallbackFrequency();
+#if UDAN_ARCH_X86
+			if (GetCpuFeatures().invariantTsc)
+			{
+				// Measure the TSC rate against the OS clock over ~10ms
+				const uint64_t fallbackFrequency = calibration.frequency;
+				const Ticks window = fallbackFrequency / 100;
+				const Ticks start = ReadFallback();
+				const uint64_t tscStart = __rdtsc();
+				Ticks end;
+				do
+				{
+					end = ReadFallback();
+				} while (end - start < window);
+				const uint64_t tscEnd = __rdtsc();
+				const double elapsed = static_cast<double>(end - start) / static_cast<double>(fallbackFrequency);
+				const auto frequency = static_cast<uint64_t>(static_cast<double>(tscEnd - tscStart) / elapsed);
+				if (frequency != 0)
+				{
+					calibration.useTsc = true;
+					calibration.frequency = frequency;
+				}
+			}
+#endif
+			calibration.secondsPerTick = 1.0 / static_cast<double>(calibration.frequency);
+			calibration.nanosecondsPerTick = 1e9 / static_cast<double>(calibration.frequency);
+			return calibration;
+		}
+	}
+}
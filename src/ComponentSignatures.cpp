@@ -0,0 +1,91 @@
+﻿#include "udan/utils/ComponentSignatures.h"
+
+#include <bit>
+
+#include "udan/utils/CpuFeatures.h"
+#include "udan/utils/MembershipFilter.h"
+
+#if UDAN_ARCH_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UDAN_TARGET(features)
+#else
+#define UDAN_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+			size_t ScanScalar(const ComponentMask* masks, size_t begin, size_t count, ComponentMask query, uint32_t* out)
+			{
+				size_t matches = 0;
+				for (size_t i = begin; i < count; ++i)
+				{
+					if ((masks[i] & query) == query)
+						out[matches++] = static_cast<uint32_t>(i);
+				}
+				return matches;
+			}
+
+#if UDAN_ARCH_X86
+			UDAN_TARGET("avx2")
+			size_t ScanAvx2(const ComponentMask* masks, size_t count, ComponentMask query, uint32_t* out)
+			{
+				const __m256i wanted = _mm256_set1_epi64x(static_cast<long long>(query));
+				size_t matches = 0;
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+					const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i + 4));
+					const uint32_t bitsLo = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(lo, wanted), wanted))));
+					const uint32_t bitsHi = static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(hi, wanted), wanted))));
+					for (uint32_t bits = bitsLo | (bitsHi << 4); bits != 0; bits &= bits - 1)
+						out[matches++] = static_cast<uint32_t>(i + std::countr_zero(bits));
+				}
+				return matches + ScanScalar(masks, i, count, query, out + matches);
+			}
+
+			UDAN_TARGET("avx512f")
+			size_t ScanAvx512(const ComponentMask* masks, size_t count, ComponentMask query, uint32_t* out)
+			{
+				const __m512i wanted = _mm512_set1_epi64(static_cast<long long>(query));
+				const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+				size_t matches = 0;
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16)
+				{
+					const __m512i lo = _mm512_loadu_si512(masks + i);
+					const __m512i hi = _mm512_loadu_si512(masks + i + 8);
+					const __mmask16 bits = static_cast<__mmask16>(
+						_mm512_cmpeq_epi64_mask(_mm512_and_si512(lo, wanted), wanted) |
+						(_mm512_cmpeq_epi64_mask(_mm512_and_si512(hi, wanted), wanted) << 8));
+					_mm512_mask_compressstoreu_epi32(out + matches, bits, _mm512_add_epi32(lanes, _mm512_set1_epi32(static_cast<int>(i))));
+					matches += std::popcount(static_cast<uint32_t>(bits));
+				}
+				return matches + ScanScalar(masks, i, count, query, out + matches);
+			}
+#endif
+		}
+
+		size_t ScanComponentMasks(const ComponentMask* masks, size_t count, ComponentMask query, uint32_t* out)
+		{
+			switch (GetMembershipKernel())
+			{
+#if UDAN_ARCH_X86
+			case MembershipKernel::AVX512:
+				return ScanAvx512(masks, count, query, out);
+			case MembershipKernel::AVX2:
+				return ScanAvx2(masks, count, query, out);
+#endif
+			default:
+				return ScanScalar(masks, 0, count, query, out);
+			}
+		}
+	}
+}
@@ -0,0 +1,86 @@
+﻿#include "udan/utils/CpuFeatures.h"
+
+#include <cstdint>
+
+#if UDAN_ARCH_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+#if UDAN_ARCH_X86
+			void Cpuid(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+			{
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+				for (int i = 0; i < 4; ++i)
+					regs[i] = static_cast<uint32_t>(info[i]);
+#else
+				__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+			}
+
+			uint64_t Xgetbv()
+			{
+#if defined(_MSC_VER)
+				return _xgetbv(0);
+#else
+				uint32_t eax, edx;
+				__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+				return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+			}
+#endif
+
+			CpuFeatures Detect()
+			{
+				CpuFeatures features;
+#if UDAN_ARCH_X86
+				uint32_t regs[4];
+				Cpuid(0, 0, regs);
+				const uint32_t maxLeaf = regs[0];
+				Cpuid(0x80000000u, 0, regs);
+				const uint32_t maxExtendedLeaf = regs[0];
+
+				if (maxExtendedLeaf >= 0x80000007u)
+				{
+					Cpuid(0x80000007u, 0, regs);
+					features.invariantTsc = (regs[3] & (1u << 8)) != 0;
+				}
+				if (maxLeaf < 1)
+					return features;
+
+				Cpuid(1, 0, regs);
+				features.sse41 = (regs[2] & (1u << 19)) != 0;
+				const bool osxsave = (regs[2] & (1u << 27)) != 0;
+				if (!osxsave || maxLeaf < 7)
+					return features;
+
+				// The OS must save the ymm (and zmm) registers on context switches
+				const uint64_t xcr0 = Xgetbv();
+				const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+				const bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+				Cpuid(7, 0, regs);
+				features.avx2 = ymmEnabled && (regs[1] & (1u << 5)) != 0;
+				features.avx512f = zmmEnabled && (regs[1] & (1u << 16)) != 0;
+#endif
+				return features;
+			}
+		}
+
+		const CpuFeatures& GetCpuFeatures()
+		{
+			static const CpuFeatures features = Detect();
+			return features;
+		}
+	}
+}
@@ -0,0 +1,157 @@
+﻿#include "udan/utils/EpochManager.h"
+#include "udan/utils/ScopeLock.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		thread_local EpochManager::LocalRecord EpochManager::s_local;
+
+		EpochManager::LocalRecord::~LocalRecord()
+		{
+			if (record != nullptr)
+				Instance().ReleaseRecord(record);
+		}
+
+		EpochManager& EpochManager::Instance()
+		{
+			static EpochManager instance;
+			return instance;
+		}
+
+		EpochManager::~EpochManager()
+		{
+			// No thread can be pinned anymore, everything is unreachable
+			ThreadRecord* record = m_records.load(std::memory_order_acquire);
+			while (record != nullptr)
+			{
+				ThreadRecord* next = record->next;
+				FreeExpired(record->retired, UINT64_MAX);
+				delete record;
+				record = next;
+			}
+			FreeExpired(m_orphans, UINT64_MAX);
+		}
+
+		void EpochManager::Enter()
+		{
+			ThreadRecord* record = Local();
+			if (record->nesting++ == 0)
+			{
+				const uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+				record->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+				// The pin must be visible before any load of a shared pointer
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+
+		void EpochManager::Exit()
+		{
+			ThreadRecord* record = Local();
+			if (--record->nesting == 0)
+			{
+				record->state.store(0, std::memory_order_release);
+				if (record->retired.size() >= CollectThreshold)
+					Collect();
+			}
+		}
+
+		void EpochManager::Retire(void* ptr, void (*deleter)(void*))
+		{
+			ThreadRecord* record = Local();
+			record->retired.push_back({ ptr, deleter, m_epoch.load(std::memory_order_acquire) });
+			if (record->nesting == 0 && record->retired.size() >= CollectThreshold)
+				Collect();
+		}
+
+		bool EpochManager::TryAdvance()
+		{
+			uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+			for (ThreadRecord* record = m_records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+			{
+				const uint64_t state = record->state.load(std::memory_order_seq_cst);
+				if ((state & 1) != 0 && (state >> 1) != epoch)
+					return false;
+			}
+			return m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+		}
+
+		void EpochManager::Collect()
+		{
+			TryAdvance();
+			const uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+			FreeExpired(Local()->retired, epoch);
+			if (m_orphansLock.TryLock())
+			{
+				FreeExpired(m_orphans, epoch);
+				m_orphansLock.Unlock();
+			}
+		}
+
+		size_t EpochManager::GetPendingCount()
+		{
+			return Local()->retired.size();
+		}
+
+		EpochManager::ThreadRecord* EpochManager::Local()
+		{
+			if (s_local.record == nullptr)
+				s_local.record = AcquireRecord();
+			return s_local.record;
+		}
+
+		EpochManager::ThreadRecord* EpochManager::AcquireRecord()
+		{
+			// Records are never unlinked so that TryAdvance can walk the list without locking
+			for (ThreadRecord* record = m_records.load(std::memory_order_acquire); record != nullptr; record = record->next)
+			{
+				bool expected = false;
+				if (!record->inUse.load(std::memory_order_relaxed) &&
+					record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				{
+					return record;
+				}
+			}
+			auto* record = new ThreadRecord();
+			record->inUse.store(true, std::memory_order_relaxed);
+			ThreadRecord* head = m_records.load(std::memory_order_relaxed);
+			do
+			{
+				record->next = head;
+			} while (!m_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+			return record;
+		}
+
+		void EpochManager::ReleaseRecord(ThreadRecord* record)
+		{
+			record->nesting = 0;
+			record->state.store(0, std::memory_order_release);
+			if (!record->retired.empty())
+			{
+				ScopeLock<decltype(m_orphansLock)> lck(m_orphansLock);
+				m_orphans.insert(m_orphans.end(), record->retired.begin(), record->retired.end());
+				record->retired.clear();
+			}
+			record->inUse.store(false, std::memory_order_release);
+		}
+
+		void EpochManager::FreeExpired(std::vector<Retired>& retired, uint64_t epoch)
+		{
+			// Deleters run once the list is consistent again since they may retire more pointers
+			std::vector<Retired> expired;
+			size_t kept = 0;
+			for (const auto& entry : retired)
+			{
+				if (entry.epoch + 2 <= epoch)
+					expired.push_back(entry);
+				else
+					retired[kept++] = entry;
+			}
+			retired.resize(kept);
+			for (const auto& entry : expired)
+			{
+				entry.deleter(entry.ptr);
+			}
+		}
+	}
+}
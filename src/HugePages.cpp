@@ -0,0 +1,133 @@
+﻿#include "udan/utils/HugePages.h"
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+			size_t RoundUp(size_t bytes, size_t granularity)
+			{
+				return (bytes + granularity - 1) / granularity * granularity;
+			}
+
+#if !defined(_WIN32)
+			// Transparent huge pages only back aligned ranges: over map by a huge page and trim both ends
+			void* MapAligned(size_t bytes, int protection)
+			{
+				void* mapping = mmap(nullptr, bytes + HugePageSize, protection, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+				if (mapping == MAP_FAILED)
+					return nullptr;
+				const auto begin = reinterpret_cast<uintptr_t>(mapping);
+				const uintptr_t aligned = RoundUp(begin, HugePageSize);
+				if (aligned != begin)
+					munmap(mapping, aligned - begin);
+				if (aligned + bytes != begin + bytes + HugePageSize)
+					munmap(reinterpret_cast<void*>(aligned + bytes), begin + HugePageSize - aligned);
+				return reinterpret_cast<void*>(aligned);
+			}
+#endif
+		}
+
+		void* AllocateHugePages(size_t bytes)
+		{
+			if (bytes == 0)
+				return nullptr;
+			bytes = RoundUp(bytes, HugePageSize);
+#if defined(_WIN32)
+			// Needs the lock pages in memory privilege, regular pages otherwise.
+			// Large pages are locked in memory, they can only be reserved and committed in the same call
+			const SIZE_T largePage = GetLargePageMinimum();
+			if (largePage != 0 && bytes % largePage == 0)
+			{
+				if (void* pointer = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+					return pointer;
+			}
+			void* pointer = ReserveAddressSpace(bytes);
+			if (pointer != nullptr && !CommitAddressSpace(pointer, bytes))
+			{
+				ReleaseAddressSpace(pointer, bytes);
+				return nullptr;
+			}
+			return pointer;
+#else
+			void* pointer = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+			// Fails unless enough huge pages were reserved, e.g. through /proc/sys/vm/nr_hugepages.
+			// Without MAP_NORESERVE: a reservation that cannot be honored would raise SIGBUS on first write instead
+			pointer = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+			if (pointer != MAP_FAILED)
+				return pointer;
+			pointer = MapAligned(bytes, PROT_READ | PROT_WRITE);
+#if defined(MADV_HUGEPAGE)
+			if (pointer != nullptr)
+				madvise(pointer, bytes, MADV_HUGEPAGE);
+#endif
+			return pointer;
+#endif
+		}
+
+		void FreeHugePages(void* pointer, size_t bytes)
+		{
+			if (pointer == nullptr)
+				return;
+#if defined(_WIN32)
+			(void)bytes;
+			VirtualFree(pointer, 0, MEM_RELEASE);
+#else
+			munmap(pointer, RoundUp(bytes, HugePageSize));
+#endif
+		}
+
+		void* ReserveAddressSpace(size_t bytes)
+		{
+			if (bytes == 0)
+				return nullptr;
+			bytes = RoundUp(bytes, HugePageSize);
+#if defined(_WIN32)
+			// Reservations are aligned on the 64 KiB allocation granularity: over reserve and keep the aligned part
+			void* reservation = VirtualAlloc(nullptr, bytes + HugePageSize, MEM_RESERVE, PAGE_NOACCESS);
+			if (reservation == nullptr)
+				return nullptr;
+			const uintptr_t aligned = RoundUp(reinterpret_cast<uintptr_t>(reservation), HugePageSize);
+			VirtualFree(reservation, 0, MEM_RELEASE);
+			// Another thread may take the range in between, fall back to the unaligned reservation
+			if (void* pointer = VirtualAlloc(reinterpret_cast<void*>(aligned), bytes, MEM_RESERVE, PAGE_NOACCESS))
+				return pointer;
+			return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+			return MapAligned(bytes, PROT_NONE);
+#endif
+		}
+
+		bool CommitAddressSpace(void* pointer, size_t bytes)
+		{
+			if (bytes == 0)
+				return true;
+#if defined(_WIN32)
+			return VirtualAlloc(pointer, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+			if (mprotect(pointer, bytes, PROT_READ | PROT_WRITE) != 0)
+				return false;
+#if defined(MADV_HUGEPAGE)
+			madvise(pointer, bytes, MADV_HUGEPAGE);
+#endif
+			return true;
+#endif
+		}
+
+		void ReleaseAddressSpace(void* pointer, size_t bytes)
+		{
+			FreeHugePages(pointer, bytes);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+﻿#include "udan/utils/MappedFile.h"
+
+#include <utility>
+
+#include "udan/debug/uLogger.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include "udan/utils/WindowsApi.h"
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		MappedFile::~MappedFile()
+		{
+			Close();
+		}
+
+		MappedFile::MappedFile(MappedFile&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+		{
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+#if defined(_WIN32)
+			std::swap(m_file, other.m_file);
+			std::swap(m_mapping, other.m_mapping);
+#endif
+			return *this;
+		}
+
+		bool MappedFile::Open(const std::string& path)
+		{
+			Close();
+#if defined(_WIN32)
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+			{
+				m_file = nullptr;
+				LOG_ERR("Cannot open {}: {}", path, GetErrorString());
+				return false;
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping != nullptr)
+				m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (m_data == nullptr)
+			{
+				LOG_ERR("Cannot map {}: {}", path, GetErrorString());
+				Close();
+				return false;
+			}
+			m_size = static_cast<size_t>(size.QuadPart);
+#else
+			const int file = open(path.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				LOG_ERR("Cannot open {}: {}", path, std::strerror(errno));
+				return false;
+			}
+			struct stat status;
+			if (fstat(file, &status) != 0 || status.st_size == 0)
+			{
+				close(file);
+				return false;
+			}
+			void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			// The mapping keeps its own reference to the file
+			close(file);
+			if (data == MAP_FAILED)
+			{
+				LOG_ERR("Cannot map {}: {}", path, std::strerror(errno));
+				return false;
+			}
+			m_data = static_cast<const std::byte*>(data);
+			m_size = static_cast<size_t>(status.st_size);
+#endif
+			return true;
+		}
+
+		void MappedFile::Close()
+		{
+#if defined(_WIN32)
+			if (m_data != nullptr)
+				UnmapViewOfFile(m_data);
+			if (m_mapping != nullptr)
+				CloseHandle(m_mapping);
+			if (m_file != nullptr)
+				CloseHandle(m_file);
+			m_mapping = nullptr;
+			m_file = nullptr;
+#else
+			if (m_data != nullptr)
+				munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+	}
+}
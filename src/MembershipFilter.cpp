@@ -0,0 +1,205 @@
+﻿#include "udan/utils/MembershipFilter.h"
+
+#include <bit>
+
+#include "udan/utils/CpuFeatures.h"
+
+#if UDAN_ARCH_X64
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UDAN_TARGET(features)
+#else
+#define UDAN_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+			inline bool Contains(const MembershipProbe& probe, uint32_t entity)
+			{
+				const uint32_t index = entity & probe.indexMask;
+				const uint32_t page = index >> probe.pageShift;
+				if (page >= probe.pageCount)
+					return false;
+				const uint32_t pos = probe.pages[page][index & ((1u << probe.pageShift) - 1)];
+				return pos < probe.denseSize && probe.dense[pos] == entity;
+			}
+
+			size_t FilterScalar(const uint32_t* candidates, size_t begin, size_t count,
+				const MembershipProbe* probes, size_t probeCount, uint32_t* out)
+			{
+				size_t matches = 0;
+				for (size_t i = begin; i < count; ++i)
+				{
+					bool match = true;
+					for (size_t p = 0; p < probeCount && match; ++p)
+						match = Contains(probes[p], candidates[i]);
+					if (match)
+						out[matches++] = static_cast<uint32_t>(i);
+				}
+				return matches;
+			}
+
+#if UDAN_ARCH_X64
+			UDAN_TARGET("avx2")
+			size_t FilterAvx2(const uint32_t* candidates, size_t count,
+				const MembershipProbe* probes, size_t probeCount, uint32_t* out)
+			{
+				const __m256i ones = _mm256_set1_epi32(-1);
+				size_t matches = 0;
+				size_t i = 0;
+				for (; i + 8 <= count; i += 8)
+				{
+					const __m256i entities = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates + i));
+					__m256i alive = ones;
+					for (size_t p = 0; p < probeCount; ++p)
+					{
+						const MembershipProbe& probe = probes[p];
+						const __m256i index = _mm256_and_si256(entities, _mm256_set1_epi32(static_cast<int>(probe.indexMask)));
+						const __m256i page = _mm256_srl_epi32(index, _mm_cvtsi32_si128(static_cast<int>(probe.pageShift)));
+						const __m256i offset = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(static_cast<int>((1u << probe.pageShift) - 1))), 2);
+						// Page indexes are below 2^(32 - pageShift), signed compare is fine
+						alive = _mm256_and_si256(alive, _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(probe.pageCount)), page));
+
+						__m256i pos;
+						const uint32_t firstPage = static_cast<uint32_t>(_mm256_cvtsi256_si32(page));
+						if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(page, _mm256_set1_epi32(static_cast<int>(firstPage)))) == -1 && firstPage < probe.pageCount)
+						{
+							// Clustered candidates: every lane reads the same page, one gather
+							pos = _mm256_mask_i32gather_epi32(_mm256_set1_epi32(-1), reinterpret_cast<const int*>(probe.pages[firstPage]), offset, alive, 1);
+						}
+						else
+						{
+							// Page pointers then entries, 4 lanes of 64 bit addresses at a time
+							const __m128i aliveLo = _mm256_castsi256_si128(alive);
+							const __m128i aliveHi = _mm256_extracti128_si256(alive, 1);
+							const __m256i pagesLo = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), reinterpret_cast<const long long*>(probe.pages),
+								_mm256_castsi256_si128(page), _mm256_cvtepi32_epi64(aliveLo), 8);
+							const __m256i pagesHi = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), reinterpret_cast<const long long*>(probe.pages),
+								_mm256_extracti128_si256(page, 1), _mm256_cvtepi32_epi64(aliveHi), 8);
+							const __m256i addressLo = _mm256_add_epi64(pagesLo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(offset)));
+							const __m256i addressHi = _mm256_add_epi64(pagesHi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(offset, 1)));
+							const __m128i posLo = _mm256_mask_i64gather_epi32(_mm_set1_epi32(-1), nullptr, addressLo, aliveLo, 1);
+							const __m128i posHi = _mm256_mask_i64gather_epi32(_mm_set1_epi32(-1), nullptr, addressHi, aliveHi, 1);
+							pos = _mm256_set_m128i(posHi, posLo);
+						}
+
+						// pos < denseSize as unsigned, Null never passes
+						const __m256i lastPos = _mm256_set1_epi32(static_cast<int>(probe.denseSize - 1));
+						alive = _mm256_and_si256(alive, _mm256_cmpeq_epi32(_mm256_min_epu32(pos, lastPos), pos));
+						const __m256i dense = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(probe.dense), pos, alive, 4);
+						alive = _mm256_and_si256(alive, _mm256_cmpeq_epi32(dense, entities));
+						if (_mm256_testz_si256(alive, alive))
+							break;
+					}
+					for (uint32_t bits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(alive))); bits != 0; bits &= bits - 1)
+						out[matches++] = static_cast<uint32_t>(i + std::countr_zero(bits));
+				}
+				return matches + FilterScalar(candidates, i, count, probes, probeCount, out + matches);
+			}
+
+			// Zero masked forms throughout: the unmasked ones start from _mm512_undefined, which GCC reports as maybe uninitialized
+			UDAN_TARGET("avx512f")
+			size_t FilterAvx512(const uint32_t* candidates, size_t count,
+				const MembershipProbe* probes, size_t probeCount, uint32_t* out)
+			{
+				constexpr __mmask16 all32 = 0xFFFF;
+				constexpr __mmask8 all64 = 0xFF;
+				const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+				size_t matches = 0;
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16)
+				{
+					const __m512i entities = _mm512_loadu_si512(candidates + i);
+					__mmask16 alive = 0xFFFF;
+					for (size_t p = 0; p < probeCount && alive != 0; ++p)
+					{
+						const MembershipProbe& probe = probes[p];
+						const __m512i index = _mm512_and_si512(entities, _mm512_set1_epi32(static_cast<int>(probe.indexMask)));
+						const __m512i page = _mm512_maskz_srl_epi32(all32, index, _mm_cvtsi32_si128(static_cast<int>(probe.pageShift)));
+						const __m512i offset = _mm512_maskz_slli_epi32(all32, _mm512_and_si512(index, _mm512_set1_epi32(static_cast<int>((1u << probe.pageShift) - 1))), 2);
+						alive = _mm512_mask_cmplt_epu32_mask(alive, page, _mm512_set1_epi32(static_cast<int>(probe.pageCount)));
+
+						__m512i pos;
+						const uint32_t firstPage = (candidates[i] & probe.indexMask) >> probe.pageShift;
+						if (_mm512_cmpneq_epi32_mask(page, _mm512_set1_epi32(static_cast<int>(firstPage))) == 0 && firstPage < probe.pageCount)
+						{
+							// Clustered candidates: every lane reads the same page, one gather
+							pos = _mm512_mask_i32gather_epi32(_mm512_set1_epi32(-1), alive, offset, probe.pages[firstPage], 1);
+						}
+						else
+						{
+							// Page pointers then entries, 8 lanes of 64 bit addresses at a time
+							const __mmask8 aliveLo = static_cast<__mmask8>(alive);
+							const __mmask8 aliveHi = static_cast<__mmask8>(alive >> 8);
+							const __m512i pagesLo = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), aliveLo, _mm512_maskz_extracti64x4_epi64(all64, page, 0), probe.pages, 8);
+							const __m512i pagesHi = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), aliveHi, _mm512_maskz_extracti64x4_epi64(all64, page, 1), probe.pages, 8);
+							const __m512i addressLo = _mm512_add_epi64(pagesLo, _mm512_maskz_cvtepu32_epi64(all64, _mm512_maskz_extracti64x4_epi64(all64, offset, 0)));
+							const __m512i addressHi = _mm512_add_epi64(pagesHi, _mm512_maskz_cvtepu32_epi64(all64, _mm512_maskz_extracti64x4_epi64(all64, offset, 1)));
+							const __m256i posLo = _mm512_mask_i64gather_epi32(_mm256_set1_epi32(-1), aliveLo, addressLo, nullptr, 1);
+							const __m256i posHi = _mm512_mask_i64gather_epi32(_mm256_set1_epi32(-1), aliveHi, addressHi, nullptr, 1);
+							pos = _mm512_maskz_inserti64x4(all64, _mm512_maskz_inserti64x4(all64, _mm512_setzero_si512(), posLo, 0), posHi, 1);
+						}
+
+						alive = _mm512_mask_cmplt_epu32_mask(alive, pos, _mm512_set1_epi32(static_cast<int>(probe.denseSize)));
+						const __m512i dense = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), alive, pos, probe.dense, 4);
+						alive = _mm512_mask_cmpeq_epi32_mask(alive, dense, entities);
+					}
+					_mm512_mask_compressstoreu_epi32(out + matches, alive, _mm512_add_epi32(lanes, _mm512_set1_epi32(static_cast<int>(i))));
+					matches += std::popcount(static_cast<uint32_t>(alive));
+				}
+				return matches + FilterScalar(candidates, i, count, probes, probeCount, out + matches);
+			}
+#endif
+
+			MembershipKernel SelectKernel()
+			{
+#if UDAN_ARCH_X64
+				const CpuFeatures& features = GetCpuFeatures();
+				if (features.avx512f)
+					return MembershipKernel::AVX512;
+				if (features.avx2)
+					return MembershipKernel::AVX2;
+#endif
+				return MembershipKernel::SCALAR;
+			}
+		}
+
+		MembershipKernel GetMembershipKernel()
+		{
+			static const MembershipKernel s_kernel = SelectKernel();
+			return s_kernel;
+		}
+
+		size_t FilterMembers(const uint32_t* candidates, size_t count, const MembershipProbe* probes, size_t probeCount, uint32_t* out)
+		{
+			return FilterMembers(GetMembershipKernel(), candidates, count, probes, probeCount, out);
+		}
+
+		size_t FilterMembers(MembershipKernel kernel, const uint32_t* candidates, size_t count,
+			const MembershipProbe* probes, size_t probeCount, uint32_t* out)
+		{
+			for (size_t p = 0; p < probeCount; ++p)
+			{
+				if (probes[p].denseSize == 0)
+					return 0;
+			}
+			switch (kernel)
+			{
+#if UDAN_ARCH_X64
+			case MembershipKernel::AVX512:
+				return FilterAvx512(candidates, count, probes, probeCount, out);
+			case MembershipKernel::AVX2:
+				return FilterAvx2(candidates, count, probes, probeCount, out);
+#endif
+			default:
+				return FilterScalar(candidates, 0, count, probes, probeCount, out);
+			}
+		}
+	}
+}
@@ -0,0 +1,165 @@
+﻿#include "udan/utils/PerfCounters.h"
+
+#include "udan/debug/uLogger.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace udan
+{
+	namespace utils
+	{
+		std::atomic<bool> PerfCounters::s_enabled{ false };
+
+#if defined(__linux__)
+		namespace
+		{
+			struct CounterConfig
+			{
+				uint32_t type;
+				uint64_t config;
+			};
+
+			constexpr std::array<CounterConfig, PerfCounterCount> Configs = { {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			} };
+
+			/**
+			 * \brief One group per thread, the first counter that opens becomes the leader
+			 */
+			class ThreadCounterGroup
+			{
+			public:
+				ThreadCounterGroup()
+				{
+					m_fds.fill(-1);
+					for (size_t i = 0; i < PerfCounterCount; ++i)
+					{
+						perf_event_attr attr;
+						std::memset(&attr, 0, sizeof(attr));
+						attr.size = sizeof(attr);
+						attr.type = Configs[i].type;
+						attr.config = Configs[i].config;
+						attr.exclude_kernel = 1;
+						attr.exclude_hv = 1;
+						attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+						attr.disabled = m_leader == -1 ? 1 : 0;
+						const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, m_leader, 0));
+						if (fd == -1)
+						{
+							LogFailure(i, errno);
+							continue;
+						}
+						if (m_leader == -1)
+							m_leader = fd;
+						m_fds[i] = fd;
+						ioctl(fd, PERF_EVENT_IOC_ID, &m_ids[i]);
+						m_validMask |= 1u << i;
+					}
+					if (m_leader != -1)
+					{
+						ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+						ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+					}
+				}
+
+				~ThreadCounterGroup()
+				{
+					for (const int fd : m_fds)
+					{
+						if (fd != -1)
+							close(fd);
+					}
+				}
+
+				[[nodiscard]] bool Available() const
+				{
+					return m_leader != -1;
+				}
+
+				PerfCounterValues Read() const
+				{
+					PerfCounterValues result;
+					if (m_leader == -1)
+						return result;
+					// nr, time_enabled, time_running, then { value, id } per counter
+					uint64_t buffer[3 + 2 * PerfCounterCount];
+					if (read(m_leader, buffer, sizeof(buffer)) <= 0)
+						return result;
+					const uint64_t count = buffer[0];
+					const uint64_t enabled = buffer[1];
+					const uint64_t running = buffer[2];
+					// The kernel multiplexes groups that do not fit the PMU, extrapolate to the enabled time
+					const double scale = running == 0 ? 0.0 : static_cast<double>(enabled) / static_cast<double>(running);
+					for (uint64_t n = 0; n < count && n < PerfCounterCount; ++n)
+					{
+						const uint64_t value = buffer[3 + 2 * n];
+						const uint64_t id = buffer[4 + 2 * n];
+						for (size_t i = 0; i < PerfCounterCount; ++i)
+						{
+							if (m_fds[i] != -1 && m_ids[i] == id)
+							{
+								result.values[i] = static_cast<uint64_t>(static_cast<double>(value) * scale);
+								break;
+							}
+						}
+					}
+					result.validMask = running == 0 ? 0 : m_validMask;
+					return result;
+				}
+
+			private:
+				static void LogFailure(size_t counter, int error)
+				{
+					static std::atomic<bool> s_logged{ false };
+					if (!s_logged.exchange(true, std::memory_order_relaxed))
+						LOG_ERR("perf_event_open failed for counter {}: {}, hardware counters are partially or not available", counter, std::strerror(error));
+				}
+
+				int m_leader = -1;
+				std::array<int, PerfCounterCount> m_fds{};
+				std::array<uint64_t, PerfCounterCount> m_ids{};
+				uint32_t m_validMask = 0;
+			};
+
+			ThreadCounterGroup& LocalGroup()
+			{
+				thread_local ThreadCounterGroup group;
+				return group;
+			}
+		}
+
+		PerfCounterValues PerfCounters::Read()
+		{
+			if (!IsEnabled())
+				return {};
+			return LocalGroup().Read();
+		}
+
+		bool PerfCounters::Available()
+		{
+			return LocalGroup().Available();
+		}
+#else
+		PerfCounterValues PerfCounters::Read()
+		{
+			return {};
+		}
+
+		bool PerfCounters::Available()
+		{
+			return false;
+		}
+#endif
+	}
+}
@@ -0,0 +1,185 @@
+﻿#include "udan/utils/Profiler.h"
+#include "udan/utils/ScopeLock.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "udan/debug/uLogger.h"
+
+namespace udan
+{
+	namespace utils
+	{
+		thread_local Profiler::LocalThreadBuffer Profiler::s_local;
+
+		Profiler::LocalThreadBuffer::~LocalThreadBuffer()
+		{
+			// The buffer stays registered until its last records have been drained
+			if (buffer != nullptr)
+				buffer->inUse.store(false, std::memory_order_release);
+		}
+
+		const ProfileNode* ProfileFrame::Find(std::string_view path) const
+		{
+			const std::vector<uint32_t>* candidates = &m_roots;
+			const ProfileNode* node = nullptr;
+			while (!path.empty())
+			{
+				const size_t separator = path.find('/');
+				const std::string_view name = path.substr(0, separator);
+				path = separator == std::string_view::npos ? std::string_view() : path.substr(separator + 1);
+				node = nullptr;
+				for (const uint32_t index : *candidates)
+				{
+					if (m_nodes[index].name == name)
+					{
+						node = &m_nodes[index];
+						break;
+					}
+				}
+				if (node == nullptr)
+					return nullptr;
+				candidates = &node->children;
+			}
+			return node;
+		}
+
+		std::string ProfileFrame::Report() const
+		{
+			bool hasCounters = false;
+			for (const auto& node : m_nodes)
+				hasCounters |= node.counters.validMask != 0;
+
+			std::string report = fmt::format("Frame {} ({} dropped)\n{:<40} {:>8} {:>12} {:>12} {:>10} {:>10} {:>10}",
+				m_frameIndex, m_dropped, "Zone", "Calls", "Incl (ms)", "Excl (ms)", "Min (us)", "Avg (us)", "Max (us)");
+			if (hasCounters)
+				report += fmt::format(" {:>6} {:>12} {:>12} {:>12}", "IPC", "L1D miss", "LLC miss", "Br miss");
+			report += "\n";
+			std::vector<uint32_t> stack(m_roots.rbegin(), m_roots.rend());
+			while (!stack.empty())
+			{
+				const ProfileNode& node = m_nodes[stack.back()];
+				stack.pop_back();
+				const std::string label = std::string(node.depth * 2, ' ') + node.name;
+				report += fmt::format("{:<40} {:>8} {:>12.3f} {:>12.3f} {:>10.2f} {:>10.2f} {:>10.2f}\n",
+					label, node.calls,
+					Clock::ToSeconds(node.inclusive) * 1e3, Clock::ToSeconds(node.exclusive) * 1e3,
+					Clock::ToSeconds(node.min) * 1e6, Clock::ToSeconds(node.Average()) * 1e6, Clock::ToSeconds(node.max) * 1e6);
+				if (hasCounters)
+				{
+					report.pop_back();
+					report += fmt::format(" {:>6.2f} {:>12} {:>12} {:>12}\n",
+						node.counters.InstructionsPerCycle(),
+						node.counters.Get(PerfCounter::L1D_MISSES),
+						node.counters.Get(PerfCounter::LLC_MISSES),
+						node.counters.Get(PerfCounter::BRANCH_MISSES));
+				}
+				stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+			}
+			return report;
+		}
+
+		uint32_t ProfileFrame::GetOrAddNode(uint32_t parent, const char* name)
+		{
+			const std::vector<uint32_t>& siblings = parent == ProfileNode::NoParent ? m_roots : m_nodes[parent].children;
+			for (const uint32_t index : siblings)
+			{
+				if (m_nodes[index].name == name)
+					return index;
+			}
+			const auto index = static_cast<uint32_t>(m_nodes.size());
+			ProfileNode node;
+			node.name = name;
+			node.parent = parent;
+			node.depth = parent == ProfileNode::NoParent ? 0 : m_nodes[parent].depth + 1;
+			m_nodes.push_back(std::move(node));
+			if (parent == ProfileNode::NoParent)
+				m_roots.push_back(index);
+			else
+				m_nodes[parent].children.push_back(index);
+			return index;
+		}
+
+		Profiler& Profiler::Instance()
+		{
+			static Profiler instance;
+			return instance;
+		}
+
+		Profiler::ThreadBuffer* Profiler::AcquireBuffer()
+		{
+			ScopeLock<decltype(m_buffersLock)> lck(m_buffersLock);
+			m_buffers.push_back(std::make_unique<ThreadBuffer>(DefaultBufferCapacity));
+			return m_buffers.back().get();
+		}
+
+		const ProfileFrame& Profiler::EndFrame()
+		{
+			ProfileFrame frame;
+			frame.m_frameIndex = m_frameIndex++;
+
+			ScopeLock<decltype(m_buffersLock)> lck(m_buffersLock);
+			for (auto it = m_buffers.begin(); it != m_buffers.end();)
+			{
+				ThreadBuffer& buffer = **it;
+				const bool inUse = buffer.inUse.load(std::memory_order_acquire);
+				m_scratch.clear();
+				while (buffer.records.TryPopBatch(std::back_inserter(m_scratch), 1024) != 0)
+				{
+				}
+				frame.m_dropped += buffer.dropped.exchange(0, std::memory_order_relaxed);
+
+				// Records are pushed when zones end: sort them back to call order, parents first
+				std::sort(m_scratch.begin(), m_scratch.end(), [](const ProfileZoneRecord& lhs, const ProfileZoneRecord& rhs)
+					{
+						return lhs.start != rhs.start ? lhs.start < rhs.start : lhs.depth < rhs.depth;
+					});
+				struct Open
+				{
+					const ProfileZoneRecord* record;
+					uint32_t node;
+					Clock::Ticks childTime;
+				};
+				std::vector<Open> open;
+				auto close = [&frame](const Open& entry)
+				{
+					ProfileNode& node = frame.m_nodes[entry.node];
+					const Clock::Ticks duration = entry.record->end - entry.record->start;
+					node.calls++;
+					node.inclusive += duration;
+					node.exclusive += duration > entry.childTime ? duration - entry.childTime : 0;
+					node.min = std::min(node.min, duration);
+					node.max = std::max(node.max, duration);
+					if (entry.record->counters.validMask != 0)
+						node.counters += entry.record->counters;
+				};
+				for (const auto& record : m_scratch)
+				{
+					// Zones whose parent ended in a previous frame (or was dropped) become roots
+					while (!open.empty() &&
+						(open.back().record->depth >= record.depth || open.back().record->end < record.end))
+					{
+						close(open.back());
+						open.pop_back();
+					}
+					const uint32_t parent = open.empty() ? ProfileNode::NoParent : open.back().node;
+					if (!open.empty())
+						open.back().childTime += record.end - record.start;
+					open.push_back({ &record, frame.GetOrAddNode(parent, record.name), 0 });
+				}
+				while (!open.empty())
+				{
+					close(open.back());
+					open.pop_back();
+				}
+
+				if (!inUse && buffer.records.Empty())
+					it = m_buffers.erase(it);
+				else
+					++it;
+			}
+			m_lastFrame = std::move(frame);
+			return m_lastFrame;
+		}
+	}
+}
@@ -0,0 +1,275 @@
+﻿#include "udan/utils/SystemScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory_resource>
+#include <unordered_map>
+
+namespace udan
+{
+	namespace utils
+	{
+		namespace
+		{
+			constexpr SystemScheduler::SystemId NoSystem = SIZE_MAX;
+
+			bool Intersects(const std::vector<size_t>& a, const std::vector<size_t>& b)
+			{
+				for (const size_t resource : a)
+				{
+					if (std::find(b.begin(), b.end(), resource) != b.end())
+						return true;
+				}
+				return false;
+			}
+		}
+
+		size_t NextSystemResourceIndex()
+		{
+			static std::atomic<size_t> s_next{ 0 };
+			return s_next.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		bool SystemAccess::ConflictsWith(const SystemAccess& other) const
+		{
+			return m_exclusive || other.m_exclusive
+				|| Intersects(m_writes, other.m_writes)
+				|| Intersects(m_writes, other.m_reads)
+				|| Intersects(m_reads, other.m_writes);
+		}
+
+		SystemScheduler::SystemScheduler() = default;
+
+		SystemScheduler::~SystemScheduler() = default;
+
+		SystemScheduler::SystemId SystemScheduler::Add(std::string name, SystemAccess access, std::function<void()> system,
+			TaskPriority priority)
+		{
+			auto entry = std::make_unique<System>();
+			entry->name = std::move(name);
+			entry->access = std::move(access);
+			entry->func = std::move(system);
+			entry->priority = priority;
+			m_systems.push_back(std::move(entry));
+			++m_systemCount;
+			m_dirty = true;
+			return m_systems.size() - 1;
+		}
+
+		void SystemScheduler::Remove(SystemId id)
+		{
+			if (id >= m_systems.size() || m_systems[id] == nullptr)
+				return;
+			m_systems[id].reset();
+			--m_systemCount;
+			m_dirty = true;
+		}
+
+		void SystemScheduler::Run(ThreadPool& pool)
+		{
+			if (pool.GetThreadCount() == 0)
+			{
+				RunSerial();
+				return;
+			}
+			if (m_dirty)
+				Build();
+			const Clock::Ticks start = Clock::Now();
+			if (m_systemCount > 0)
+			{
+				for (const auto& system : m_systems)
+				{
+					if (system != nullptr)
+						system->pending.store(static_cast<uint32_t>(system->dependencies.size()), std::memory_order_relaxed);
+				}
+				// Shared with the tasks, the last one may still be inside Done when Wait returns
+				auto done = std::make_shared<WaitGroup>(static_cast<uint32_t>(m_systemCount));
+				ScratchScope scratch(ThreadPool::GetScratch());
+				std::pmr::vector<std::shared_ptr<ATask>> tasks(scratch.GetResource());
+				tasks.reserve(m_roots.size());
+				for (const SystemId root : m_roots)
+				{
+					tasks.push_back(std::make_shared<Task>([this, &pool, root, done]() { RunChain(pool, root, done); },
+						m_systems[root]->priority));
+				}
+				pool.BulkSchedule(tasks);
+				done->Wait();
+			}
+			m_lastFrameTicks = Clock::Now() - start;
+		}
+
+		void SystemScheduler::RunSerial()
+		{
+			const Clock::Ticks start = Clock::Now();
+			for (SystemId id = 0; id < m_systems.size(); ++id)
+			{
+				if (m_systems[id] != nullptr)
+					Execute(id);
+			}
+			m_lastFrameTicks = Clock::Now() - start;
+		}
+
+		std::vector<SystemScheduler::SystemId> SystemScheduler::GetDependencies(SystemId id)
+		{
+			if (m_dirty)
+				Build();
+			assert(id < m_systems.size() && m_systems[id] != nullptr);
+			return m_systems[id]->dependencies;
+		}
+
+		std::vector<SystemTiming> SystemScheduler::GetTimings() const
+		{
+			std::vector<SystemTiming> timings;
+			timings.reserve(m_systemCount);
+			for (const auto& system : m_systems)
+			{
+				if (system == nullptr)
+					continue;
+				timings.push_back({
+					system->name,
+					Clock::ToNanoseconds(system->lastTicks),
+					system->runCount == 0 ? 0 : Clock::ToNanoseconds(system->totalTicks / system->runCount),
+					Clock::ToNanoseconds(system->maxTicks),
+					system->runCount
+				});
+			}
+			return timings;
+		}
+
+		uint64_t SystemScheduler::GetLastFrameNanoseconds() const
+		{
+			return Clock::ToNanoseconds(m_lastFrameTicks);
+		}
+
+		void SystemScheduler::ResetTimings()
+		{
+			for (const auto& system : m_systems)
+			{
+				if (system == nullptr)
+					continue;
+				system->lastTicks = 0;
+				system->totalTicks = 0;
+				system->maxTicks = 0;
+				system->runCount = 0;
+			}
+			m_lastFrameTicks = 0;
+		}
+
+		size_t SystemScheduler::GetSystemCount() const
+		{
+			return m_systemCount;
+		}
+
+		void SystemScheduler::Build()
+		{
+			struct ResourceState
+			{
+				SystemId writer = NoSystem;
+				// Readers since the last write
+				std::vector<SystemId> readers;
+			};
+			std::unordered_map<size_t, ResourceState> resources;
+			SystemId lastExclusive = NoSystem;
+			// Systems added since the last exclusive one, an exclusive system waits for all of them
+			std::vector<SystemId> sinceExclusive;
+
+			m_roots.clear();
+			for (SystemId id = 0; id < m_systems.size(); ++id)
+			{
+				if (m_systems[id] == nullptr)
+					continue;
+				System& system = *m_systems[id];
+				std::vector<SystemId>& dependencies = system.dependencies;
+				dependencies.clear();
+				system.dependents.clear();
+
+				if (system.access.IsExclusive())
+				{
+					dependencies = sinceExclusive;
+					if (dependencies.empty() && lastExclusive != NoSystem)
+						dependencies.push_back(lastExclusive);
+					// Every later system waits for this one, which waits for everything before
+					resources.clear();
+					sinceExclusive.clear();
+					lastExclusive = id;
+				}
+				else
+				{
+					if (lastExclusive != NoSystem)
+						dependencies.push_back(lastExclusive);
+					for (const size_t resource : system.access.GetReads())
+					{
+						const ResourceState& state = resources[resource];
+						if (state.writer != NoSystem)
+							dependencies.push_back(state.writer);
+					}
+					for (const size_t resource : system.access.GetWrites())
+					{
+						const ResourceState& state = resources[resource];
+						// The readers already wait for the writer
+						if (state.readers.empty() && state.writer != NoSystem)
+							dependencies.push_back(state.writer);
+						dependencies.insert(dependencies.end(), state.readers.begin(), state.readers.end());
+					}
+					for (const size_t resource : system.access.GetReads())
+						resources[resource].readers.push_back(id);
+					for (const size_t resource : system.access.GetWrites())
+					{
+						ResourceState& state = resources[resource];
+						state.writer = id;
+						state.readers.clear();
+					}
+					sinceExclusive.push_back(id);
+				}
+
+				std::sort(dependencies.begin(), dependencies.end());
+				dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+				for (const SystemId dependency : dependencies)
+					m_systems[dependency]->dependents.push_back(id);
+				if (dependencies.empty())
+					m_roots.push_back(id);
+			}
+			m_dirty = false;
+		}
+
+		void SystemScheduler::Execute(SystemId id)
+		{
+			System& system = *m_systems[id];
+			const Clock::Ticks start = Clock::Now();
+			system.func();
+			const Clock::Ticks elapsed = Clock::Now() - start;
+			system.lastTicks = elapsed;
+			system.totalTicks += elapsed;
+			system.maxTicks = std::max(system.maxTicks, elapsed);
+			++system.runCount;
+		}
+
+		void SystemScheduler::RunChain(ThreadPool& pool, SystemId id, const std::shared_ptr<WaitGroup>& done)
+		{
+			while (id != NoSystem)
+			{
+				Execute(id);
+				// The first dependent made ready runs on this thread, skipping a trip through the queue
+				SystemId next = NoSystem;
+				for (const SystemId dependent : m_systems[id]->dependents)
+				{
+					if (m_systems[dependent]->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+						continue;
+					if (next == NoSystem)
+						next = dependent;
+					else
+						ScheduleSystem(pool, dependent, done);
+				}
+				// Once the last system is done the scheduler may be gone, nothing of it is touched afterwards
+				done->Done();
+				id = next;
+			}
+		}
+
+		void SystemScheduler::ScheduleSystem(ThreadPool& pool, SystemId id, const std::shared_ptr<WaitGroup>& done)
+		{
+			pool.Schedule(std::make_shared<Task>([this, &pool, id, done]() { RunChain(pool, id, done); },
+				m_systems[id]->priority));
+		}
+	}
+}
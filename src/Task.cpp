@@ -6,11 +6,12 @@ namespace udan
 {
 	namespace utils
 	{
-		uint64_t ATask::m_taskId = 1;
+		std::atomic<uint64_t> ATask::m_taskId{ 1 };
 		ATask::ATask(TaskPriority priority, size_t task_id) :
 			m_priority(priority),
-			m_id(task_id == 0 ? m_taskId++ : task_id),
-			m_completed(false)
+			m_id(task_id == 0 ? m_taskId.fetch_add(1, std::memory_order_relaxed) : task_id),
+			m_completed(false),
+			m_scheduledTicks(0)
 		{
 		}
 
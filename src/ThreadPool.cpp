@@ -1,6 +1,7 @@
 ﻿#include "udan/utils/ThreadPool.h"
 
 
+#include "udan/utils/EpochManager.h"
 #include "udan/utils/ScopeLock.h"
 #include "udan/debug/uLogger.h"
 
@@ -10,13 +11,22 @@ namespace udan
 {
 	namespace utils
 	{
-		ThreadPool::ThreadPool(size_t capacity) : m_cv(INFINITE), m_queueEmpty(INFINITE)
+		thread_local size_t ThreadPool::s_workerIndex = ThreadPool::NoWorker;
+		thread_local ScratchArena* ThreadPool::s_scratch = nullptr;
+
+		ThreadPool::ThreadPool(size_t capacity) :
+			m_cv(INFINITE),
+			m_queueEmpty(INFINITE),
+			m_latencies(std::make_unique<Latencies>(capacity))
 		{
 			m_shouldRun = true;
+			m_scratch.reserve(capacity);
+			for (size_t i = 0; i < capacity; ++i)
+				m_scratch.push_back(std::make_unique<ScratchArena>());
 			m_threads.reserve(capacity);
 			for (size_t i = 0; i < capacity; ++i)
 			{
-				m_threads.emplace_back([this] { Run(); });
+				m_threads.emplace_back([this, i] { Run(i); });
 			}
 			LOG_INFO("Threadpool launching {} threads...", capacity);
 		}
@@ -44,8 +54,6 @@ namespace udan
 		{
 			ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 			m_queueEmpty.Wait(m_mtx_remaining, [this]() { return m_remainingTasks.empty(); });
-			LOG_INFO("Exit wait");
-
 		}
 #if DEBUG
 		void ThreadPool::Interrupt()
@@ -70,7 +78,7 @@ namespace udan
 			}
 		}*/
 
-		void ThreadPool::BulkSchedule(const std::vector<std::shared_ptr<ATask>>& tasks)
+		void ThreadPool::BulkSchedule(std::span<const std::shared_ptr<ATask>> tasks)
 		{
 			ScopeLock<decltype(m_mtx)> lck(m_mtx);
 			for (const auto& task : tasks)
@@ -94,18 +102,18 @@ namespace udan
 #if DEBUG
 				//LOG_DEBUG("Schedule task {}: ", task->GetId());
 				auto debugTask = std::make_shared<DebugTaskDecorator>(task);
+				debugTask->MarkScheduled();
 				m_tasks.push(debugTask);
 				{
 					ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 					m_remainingTasks.insert(debugTask->GetId());
-					LOG_INFO("Remnaining size: {}", m_remainingTasks.size());
 				}
 #else
+				task->MarkScheduled();
 				m_tasks.push(task);
 				{
 					ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 					m_remainingTasks.insert(task->GetId());
-					LOG_INFO("Remnaining size: {}", m_remainingTasks.size());
 				}
 #endif
 			}
@@ -152,11 +160,53 @@ namespace udan
 			return m_threads.size();
 		}
 
+		size_t ThreadPool::GetWorkerIndex()
+		{
+			return s_workerIndex;
+		}
+
+		ScratchArena& ThreadPool::GetScratch()
+		{
+			if (s_scratch == nullptr)
+			{
+				static thread_local ScratchArena s_threadScratch;
+				s_scratch = &s_threadScratch;
+			}
+			return *s_scratch;
+		}
+
+		void ThreadPool::ResetScratch()
+		{
+			for (const auto& scratch : m_scratch)
+				scratch->Reset();
+			GetScratch().Reset();
+		}
+
+		LatencyHistogram ThreadPool::GetScheduleLatency(TaskPriority priority) const
+		{
+			return m_latencies->schedule[static_cast<size_t>(priority)].Snapshot();
+		}
+
+		LatencyHistogram ThreadPool::GetExecutionLatency(TaskPriority priority) const
+		{
+			return m_latencies->execution[static_cast<size_t>(priority)].Snapshot();
+		}
+
+		void ThreadPool::ResetLatencies()
+		{
+			for (size_t i = 0; i < TaskPriorityCount; ++i)
+			{
+				m_latencies->schedule[i].Reset();
+				m_latencies->execution[i].Reset();
+			}
+		}
+
 		void ThreadPool::ScheduleCompletedDependency(const std::shared_ptr<ATask>& task)
 		{
 #if DEBUG
 			//LOG_DEBUG("Schedule task {}: ", task->GetId());
 			auto debugTask = std::make_shared<DebugTaskDecorator>(task);
+			debugTask->MarkScheduled();
 			{
 				ScopeLock<decltype(m_mtx)> lck(m_mtx);
 				m_tasks.push(debugTask);
@@ -165,9 +215,9 @@ namespace udan
 			{
 				ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 				m_remainingTasks.insert(debugTask->GetId());
-				LOG_INFO("Remnaining size: {}", m_remainingTasks.size());
 			}
 #else
+			task->MarkScheduled();
 			{
 				ScopeLock<decltype(m_mtx)> lck(m_mtx);
 				m_tasks.push(task);
@@ -176,14 +226,16 @@ namespace udan
 			{
 				ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 				m_remainingTasks.insert(task->GetId());
-				LOG_INFO("Remnaining size: {}", m_remainingTasks.size());
 			}
 #endif	
 		}
 
-		void ThreadPool::Run()
+		void ThreadPool::Run(size_t workerIndex)
 		{
+			s_workerIndex = workerIndex;
+			s_scratch = m_scratch[workerIndex].get();
 			LOG_INFO("Start thread {}", GetCurrentThreadId());
+			EpochManager& epochs = EpochManager::Instance();
 			while (m_shouldRun)
 			{
 				bool notify = false;
@@ -200,16 +252,21 @@ namespace udan
 						task = m_tasks.top();
 						m_tasks.pop();
 					}
-					task->Exec();
+					{
+						// Not pinned: a task may block or run long, readers of lock free structures pin around the read, e.g. Event::Invoke
+						const auto priority = static_cast<size_t>(task->GetPriority());
+						const Clock::Ticks start = Clock::Now();
+						m_latencies->schedule[priority].Record(start - task->GetScheduledTicks(), workerIndex);
+						task->Exec();
+						m_latencies->execution[priority].Record(Clock::Now() - start, workerIndex);
+					}
+					// Between two tasks the worker holds no pointer into a lock free structure, a good time to reclaim
+					if (epochs.GetPendingCount() != 0)
+						epochs.Collect();
 					{
 						ScopeLock<decltype(m_mtx_remaining)> lck(m_mtx_remaining);
 						m_remainingTasks.erase(task->GetId());
-						LOG_INFO("Check if empty");
-						if (m_remainingTasks.empty())
-						{
-							LOG_INFO("No remaining tasks {}", GetCurrentThreadId());
-							notify = true;
-						}
+						notify = m_remainingTasks.empty();
 					}
 				}
 				if (notify)